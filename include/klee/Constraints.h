@@ -13,6 +13,7 @@
 #include "klee/Expr.h"
 #include "klee/util/ExprTimer.h"
 #include "klee/IndependentElementSet.h"
+#include <memory>
 
 // FIXME: Currently we use ConstraintManager for two things: to pass
 // sets of constraints around, and to optimize constraints. We should
@@ -52,6 +53,7 @@ public:
 	ConstraintManager(const ConstraintManager &cs)
 	: constraints(cs.constraints)
 	, readsets(cs.readsets)
+	, partition(cs.partition)
 	, simplifier(NULL) {}
 
 	ConstraintManager& operator=(const ConstraintManager &cs)
@@ -61,6 +63,7 @@ public:
 
 		constraints = cs.constraints;
 		readsets = cs.readsets;
+		partition = cs.partition;
 		invalidateSimplifier();
 		return *this;
 	}
@@ -82,6 +85,9 @@ public:
 	ref<Expr> getConstraint(unsigned i) const { return constraints[i]; }
 	ref<Expr> getConjunction(void) const;
 
+	/* constraints transitively sharing reads with e, in order */
+	void getDependent(const ref<Expr>& e, ConstraintManager& cs) const;
+
 	bool operator==(const ConstraintManager &other) const
 	{ return constraints == other.constraints; }
 
@@ -99,6 +105,9 @@ public:
 private:
 	constraints_t constraints;
 	readsets_t readsets;
+	/* independence groups for a prefix of constraints; caught up on
+	 * demand and shared between copies until one of them extends it */
+	mutable std::shared_ptr<ConstraintPartition> partition;
 	mutable ExprTimer<ExprReplaceVisitor2>* simplifier;
 
 	// returns true iff the constraints were modified
@@ -106,6 +115,7 @@ private:
 
 	bool addConstraintInternal(ref<Expr> e);
 	void invalidateSimplifier(void) const;
+	void syncPartition(void) const;
 	void setupSimplifier(void) const;
 
 	static unsigned simplify_c;	/* number of simplify calls */
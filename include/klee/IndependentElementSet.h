@@ -5,6 +5,8 @@
 #include "klee/util/ExprUtil.h"
 #include <unordered_set>
 #include <unordered_map>
+#include <vector>
+#include <memory>
 
 namespace std {
 template <> struct hash<klee::ref<klee::ReadExpr>>
@@ -145,5 +147,78 @@ private:
 	std::unordered_set<const Array*>	wholeObjects;
 };
 
+/* Union-find over constraint indices; two constraints share a group
+ * iff they are transitively linked by reading the same array byte, or
+ * by one of them reading the array at a symbolic index. Same relation
+ * as the IndependentElementSet closure, but built one constraint at a
+ * time so a query only has to look up the groups its reads touch.
+ *
+ * A partition built on a base is a delta: it records only the parent
+ * links, members and array owners that changed since the base, and
+ * looks everything else up in the base, which it never modifies. A
+ * fork therefore costs one empty layer instead of a copy. Lookups walk
+ * the chain of bases, so chains are kept short (see getDepth). */
+class ConstraintPartition
+{
+public:
+	ConstraintPartition() {}
+	explicit ConstraintPartition(
+		std::shared_ptr<const ConstraintPartition> _base);
+	virtual ~ConstraintPartition() {}
+
+	/* constraints must be added in order, idx == size() */
+	void add(unsigned idx, const ReadSet& rs);
+	unsigned size(void) const { return base_n + parent.size(); }
+	unsigned getNumGroups(void) const { return num_groups; }
+	/* number of bases below this one */
+	unsigned getDepth(void) const { return depth; }
+
+	/* ascending indices of constraints that rs depends on */
+	void getDependent(const ReadSet& rs, std::vector<unsigned>& ret) const;
+
+private:
+	typedef std::pair<const Array*, unsigned> elem_ty;
+	struct elem_hash {
+		size_t operator()(const elem_ty& e) const
+		{ return ((size_t)e.first) * 31 + e.second; }
+	};
+
+	/* no path compression; the base is shared read-only */
+	unsigned find(unsigned i) const
+	{ unsigned p; while ((p = getParent(i)) != i) i = p; return i; }
+	unsigned getParent(unsigned i) const;
+	void setParent(unsigned i, unsigned p);
+	unsigned getGroupSize(unsigned root) const;
+	void getMembers(unsigned root, std::vector<unsigned>& ret) const;
+	bool getElemOwner(const elem_ty& e, unsigned& owner) const;
+	bool getWholeOwner(const Array* arr, unsigned& owner) const;
+	bool getUsers(const Array* arr, std::vector<unsigned>& ret) const;
+
+	void unite(unsigned a, unsigned b);
+	void touchWhole(const Array* arr, unsigned idx);
+	void touchElem(const Array* arr, unsigned off, unsigned idx);
+	void addRoots(
+		const ReadSet& rs,
+		std::unordered_set<unsigned>& roots) const;
+
+	std::shared_ptr<const ConstraintPartition>	base;
+	unsigned					base_n = 0;
+	unsigned					depth = 0;
+
+	/* parents of constraints base_n and up */
+	std::vector<unsigned>				parent;
+	/* re-parented constraints from the base */
+	std::unordered_map<unsigned, unsigned>		parent_delta;
+	/* members joined to each root here; the base has the rest */
+	std::unordered_map<unsigned, std::vector<unsigned> >	members;
+	unsigned					num_groups = 0;
+
+	std::unordered_map<elem_ty, unsigned, elem_hash>	elem_owner;
+	/* constraints reading an array at concrete offsets, until some
+	 * constraint reads it symbolically and the group is arr_whole */
+	std::unordered_map<const Array*, std::vector<unsigned> > arr_users;
+	std::unordered_map<const Array*, unsigned>		arr_whole;
+};
+
 }
 #endif
@@ -0,0 +1,292 @@
+#ifndef KLEE_SETINDEX_H
+#define KLEE_SETINDEX_H
+
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include <set>
+#include <stdint.h>
+
+namespace klee
+{
+/* Set => value map with subset/superset queries.
+ *
+ * Drop-in for MapOfSets lookups. Set elements are interned to dense
+ * ids; each stored set is a sorted id run in one shared pool with a
+ * 64-bit signature (bit id%64 per element). Entries are kept as
+ * parallel arrays so that subset scans are a linear pass over the
+ * signatures and superset scans only walk the posting list of the
+ * rarest element of the query. Matches are returned in insertion
+ * order. */
+template<class K, class V, class H = std::hash<K>, class E = std::equal_to<K> >
+class SetIndex
+{
+public:
+	typedef std::vector<uint32_t>	idset_ty;
+
+	SetIndex() {}
+
+	void clear(void);
+	void insert(const std::set<K>& s, const V& v);
+	V* lookup(const std::set<K>& s);
+
+	template<class Predicate>
+	V* findSuperset(const std::set<K>& s, const Predicate& p);
+	template<class Predicate>
+	V* findSubset(const std::set<K>& s, const Predicate& p);
+
+	/* drop every entry whose value matches; compacts the ids */
+	template<class Predicate>
+	void eraseIf(const Predicate& p);
+
+	unsigned size(void) const { return values.size(); }
+	unsigned getNumElements(void) const { return keys.size(); }
+
+private:
+	/* false if some element was never interned */
+	bool getIds(const std::set<K>& s, idset_ty& ret) const;
+	uint32_t intern(const K& k);
+	static uint64_t getSig(const idset_ty& ids);
+	static uint64_t hashIds(const idset_ty& ids);
+	void addEntry(const idset_ty& ids, const V& v);
+	int findExact(const idset_ty& ids) const;
+
+	const uint32_t* entryBegin(unsigned i) const
+	{ return pool.data() + offs[i]; }
+	const uint32_t* entryEnd(unsigned i) const
+	{ return pool.data() + offs[i] + lens[i]; }
+
+	std::unordered_map<K, uint32_t, H, E>	idmap;
+	std::vector<K>				keys;	/* id => element */
+
+	std::vector<uint64_t>	sigs;
+	std::vector<uint32_t>	offs;
+	std::vector<uint32_t>	lens;
+	std::vector<V>		values;
+	std::vector<uint32_t>	pool;
+
+	/* id => entries holding it, ascending */
+	std::vector<std::vector<uint32_t> >		postings;
+	std::unordered_multimap<uint64_t, uint32_t>	exact;
+};
+
+template<class K, class V, class H, class E>
+void SetIndex<K,V,H,E>::clear(void)
+{
+	idmap.clear();
+	keys.clear();
+	sigs.clear();
+	offs.clear();
+	lens.clear();
+	values.clear();
+	pool.clear();
+	postings.clear();
+	exact.clear();
+}
+
+template<class K, class V, class H, class E>
+uint32_t SetIndex<K,V,H,E>::intern(const K& k)
+{
+	auto	res(idmap.insert(std::make_pair(k, (uint32_t)keys.size())));
+
+	if (res.second) {
+		keys.push_back(k);
+		postings.push_back(std::vector<uint32_t>());
+	}
+
+	return res.first->second;
+}
+
+template<class K, class V, class H, class E>
+bool SetIndex<K,V,H,E>::getIds(const std::set<K>& s, idset_ty& ret) const
+{
+	bool	all_found = true;
+
+	ret.clear();
+	for (const auto& k : s) {
+		auto	it(idmap.find(k));
+		if (it == idmap.end()) {
+			all_found = false;
+			continue;
+		}
+		ret.push_back(it->second);
+	}
+
+	std::sort(ret.begin(), ret.end());
+	return all_found;
+}
+
+template<class K, class V, class H, class E>
+uint64_t SetIndex<K,V,H,E>::getSig(const idset_ty& ids)
+{
+	uint64_t	sig = 0;
+	for (auto id : ids)
+		sig |= 1ULL << (id % 64);
+	return sig;
+}
+
+template<class K, class V, class H, class E>
+uint64_t SetIndex<K,V,H,E>::hashIds(const idset_ty& ids)
+{
+	uint64_t	h = 14695981039346656037ULL;
+	for (auto id : ids)
+		h = (h ^ id) * 1099511628211ULL;
+	return h;
+}
+
+template<class K, class V, class H, class E>
+int SetIndex<K,V,H,E>::findExact(const idset_ty& ids) const
+{
+	auto	r(exact.equal_range(hashIds(ids)));
+
+	for (auto it = r.first; it != r.second; ++it) {
+		unsigned	i = it->second;
+		if (	lens[i] == ids.size() &&
+			std::equal(ids.begin(), ids.end(), entryBegin(i)))
+			return i;
+	}
+
+	return -1;
+}
+
+template<class K, class V, class H, class E>
+void SetIndex<K,V,H,E>::addEntry(const idset_ty& ids, const V& v)
+{
+	uint32_t	i = values.size();
+
+	sigs.push_back(getSig(ids));
+	offs.push_back(pool.size());
+	lens.push_back(ids.size());
+	values.push_back(v);
+	pool.insert(pool.end(), ids.begin(), ids.end());
+	for (auto id : ids)
+		postings[id].push_back(i);
+	exact.insert(std::make_pair(hashIds(ids), i));
+}
+
+template<class K, class V, class H, class E>
+void SetIndex<K,V,H,E>::insert(const std::set<K>& s, const V& v)
+{
+	idset_ty	ids;
+	int		i;
+
+	for (const auto& k : s)
+		ids.push_back(intern(k));
+	std::sort(ids.begin(), ids.end());
+
+	i = findExact(ids);
+	if (i >= 0) {
+		values[i] = v;
+		return;
+	}
+
+	addEntry(ids, v);
+}
+
+template<class K, class V, class H, class E>
+V* SetIndex<K,V,H,E>::lookup(const std::set<K>& s)
+{
+	idset_ty	ids;
+	int		i;
+
+	if (!getIds(s, ids))
+		return NULL;
+
+	i = findExact(ids);
+	return (i < 0) ? NULL : &values[i];
+}
+
+template<class K, class V, class H, class E>
+template<class Predicate>
+V* SetIndex<K,V,H,E>::findSuperset(const std::set<K>& s, const Predicate& p)
+{
+	const std::vector<uint32_t>	*cands = NULL;
+	idset_ty			ids;
+	uint64_t			sig;
+
+	/* nothing holds an unseen element */
+	if (!getIds(s, ids))
+		return NULL;
+
+	if (ids.empty()) {
+		for (unsigned i = 0; i < values.size(); i++)
+			if (p(values[i]))
+				return &values[i];
+		return NULL;
+	}
+
+	for (auto id : ids)
+		if (cands == NULL || postings[id].size() < cands->size())
+			cands = &postings[id];
+
+	sig = getSig(ids);
+	for (auto i : *cands) {
+		if ((sigs[i] & sig) != sig || lens[i] < ids.size())
+			continue;
+		if (!std::includes(
+			entryBegin(i), entryEnd(i), ids.begin(), ids.end()))
+			continue;
+		if (p(values[i]))
+			return &values[i];
+	}
+
+	return NULL;
+}
+
+template<class K, class V, class H, class E>
+template<class Predicate>
+V* SetIndex<K,V,H,E>::findSubset(const std::set<K>& s, const Predicate& p)
+{
+	idset_ty	ids;
+	uint64_t	nsig;
+	unsigned	n = values.size();
+
+	/* unseen elements can't be in any entry; ignore them */
+	getIds(s, ids);
+	nsig = ~getSig(ids);
+
+	for (unsigned i = 0; i < n; i++) {
+		if ((sigs[i] & nsig) != 0)
+			continue;
+		if (lens[i] > ids.size())
+			continue;
+		if (!std::includes(
+			ids.begin(), ids.end(), entryBegin(i), entryEnd(i)))
+			continue;
+		if (p(values[i]))
+			return &values[i];
+	}
+
+	return NULL;
+}
+
+template<class K, class V, class H, class E>
+template<class Predicate>
+void SetIndex<K,V,H,E>::eraseIf(const Predicate& p)
+{
+	std::vector<std::pair<std::vector<K>, V> >	kept;
+
+	for (unsigned i = 0; i < values.size(); i++) {
+		if (p(values[i]))
+			continue;
+
+		kept.push_back(std::make_pair(std::vector<K>(), values[i]));
+		for (auto it = entryBegin(i); it != entryEnd(i); ++it)
+			kept.back().first.push_back(keys[*it]);
+	}
+
+	clear();
+
+	for (const auto& kv : kept) {
+		idset_ty	ids;
+		for (const auto& k : kv.first)
+			ids.push_back(intern(k));
+		std::sort(ids.begin(), ids.end());
+		addEntry(ids, kv.second);
+	}
+}
+
+}
+
+#endif
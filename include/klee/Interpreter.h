@@ -53,6 +53,12 @@ public:
 		const ExecutionState &state,
 		const char *err, const char *suffix) = 0;
 
+	/* the process became worker 'id' of 'count' forked workers */
+	virtual void setWorker(unsigned id, unsigned count) {}
+	/* a finished worker wrote these past the split */
+	virtual void addWorkerCounts(
+		unsigned tests, unsigned paths, unsigned errors) {}
+
 	virtual bool isWriteOutput(void) const { return writeOutput; }
 	virtual void setWriteOutput(bool v) { writeOutput = v; }
 
@@ -27,6 +27,13 @@ private:
 	unsigned	m_pathsExplored; // # paths explored
 	unsigned	m_errorsFound;
 
+	// test ids are interleaved with other workers past m_workerBase
+	unsigned	m_workerId;
+	unsigned	m_workerCount;
+	unsigned	m_workerBase;
+	// tests written by finished workers
+	unsigned	m_workerTests;
+
 	// used for writing .ktest files
 	const CmdArgs			*cmdargs;
 
@@ -40,11 +47,15 @@ public:
 	std::unique_ptr<std::ostream>
 		openOutputFile(const std::string &filename) override;
 
-	unsigned getNumTestCases() const override { return m_testIndex; }
+	unsigned getNumTestCases() const override
+	{ return m_testIndex + m_workerTests; }
 	unsigned getNumPathsExplored() const override {return m_pathsExplored;}
 	unsigned getNumErrors(void) const override { return m_errorsFound; }
 	void incPathsExplored() override { m_pathsExplored++; }
 	void incErrorsFound(void) override { m_errorsFound++; }
+	void setWorker(unsigned id, unsigned count) override;
+	void addWorkerCounts(
+		unsigned tests, unsigned paths, unsigned errors) override;
 
 	unsigned processTestCase(
 		const ExecutionState  &state,
@@ -116,6 +127,7 @@ private:
 	std::string setupOutputDir(void);
 	bool scanForOutputDir(const std::string& path, std::string& theDir);
 	void dumpPCs(const ExecutionState& state, unsigned id);
+	unsigned nextTestId(void);
 
 	time_t t[2];
 	clock_t tm[2];
@@ -208,7 +208,12 @@ public:
     ///
     /// \param useForkedSTP - Whether STP should be run in a separate process
     /// (required for using timeouts).
-    STPSolver(bool useForkedSTP, sockaddr_in_opt stpServer = sockaddr_in_opt());
+    /// \param stpServerShm - Name of a shared memory ring served by a
+    /// solverd on the same host; used instead of stpServer if set.
+    STPSolver(
+      bool useForkedSTP,
+      sockaddr_in_opt stpServer = sockaddr_in_opt(),
+      const char* stpServerShm = NULL);
 
     /// setTimeout - Set constraint solver timeout delay to the given value; 0
     /// is off.
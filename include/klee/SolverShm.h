@@ -0,0 +1,198 @@
+//===-- SolverShm.h ---------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SOLVER_SHM_H
+#define KLEE_SOLVER_SHM_H
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "klee/SolverFormat.h"
+
+/* Shared-memory transport between the -stp-server-shm client and a
+ * solverd on the same host. The segment is a fixed array of slots.
+ * A client claims a free slot, writes STPReqHdr + query into it in
+ * place, and rings the doorbell; solverd writes the STPResHdr +
+ * CexItem response back into the same slot. Both sides spin briefly
+ * before sleeping on a futex, so a fast answer costs no syscalls.
+ * A client that times out hands its slot back: straight to FREE if
+ * solverd never picked it up, else to ABANDONED, which solverd turns
+ * into FREE instead of posting the answer.
+ *
+ * The query is still the CVC text from vc_printQueryStateToBuffer, the
+ * same bytes sent over TCP, because solverd feeds it to a forked STP
+ * binary. Serialization costs the same as with -stp-server; the ring
+ * only saves the connect, the socket copies and the wakeup latency. */
+
+#define SOLVER_SHM_MAGIC	0x564c4f53	/* 'SOLV' */
+#define SOLVER_SHM_SLOTS	16
+#define SOLVER_SHM_SLOT_BYTES	(1 << 20)
+#define SOLVER_SHM_SPINS	4096
+
+namespace klee {
+
+enum SolverShmState {
+  SHM_SLOT_FREE = 0,
+  SHM_SLOT_CLAIMED,	/* client is writing the request */
+  SHM_SLOT_REQ,		/* request ready for solverd */
+  SHM_SLOT_BUSY,	/* solverd is working on it */
+  SHM_SLOT_RES,		/* response ready for client */
+  SHM_SLOT_ERR,		/* solverd gave up */
+  SHM_SLOT_ABANDONED	/* client gave up; solverd frees it when done */
+};
+
+struct SolverShmSlot {
+  volatile uint32_t state;
+  uint32_t len;		/* bytes used in data */
+  char data[SOLVER_SHM_SLOT_BYTES - 2*sizeof(uint32_t)];
+};
+
+struct SolverShmRing {
+  uint32_t magic;
+  uint32_t nslots;
+  volatile uint32_t doorbell;	/* bumped on every posted request */
+  uint32_t pad;
+  SolverShmSlot slots[SOLVER_SHM_SLOTS];
+};
+
+static inline void solverShmWake(volatile uint32_t* addr)
+{ syscall(SYS_futex, addr, FUTEX_WAKE, INT32_MAX, NULL, NULL, 0); }
+
+/* waits until *addr != old; returns false on timeout (ms=0 => forever) */
+static inline bool solverShmWait(
+  volatile uint32_t* addr, uint32_t old, unsigned ms)
+{
+  struct timespec ts, *tsp = NULL;
+
+  for (unsigned i = 0; i < SOLVER_SHM_SPINS; i++) {
+    if (*addr != old)
+      return true;
+    __sync_synchronize();
+  }
+
+  if (ms) {
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (ms % 1000) * 1000000;
+    tsp = &ts;
+  }
+
+  while (*addr == old) {
+    if (syscall(SYS_futex, addr, FUTEX_WAIT, old, tsp, NULL, 0) < 0 &&
+        errno == ETIMEDOUT)
+      return *addr != old;
+  }
+
+  return true;
+}
+
+static inline SolverShmRing* solverShmOpen(const char* name, bool create)
+{
+  SolverShmRing *ring;
+  void *p;
+  int fd;
+
+  fd = shm_open(name, create ? (O_RDWR | O_CREAT) : O_RDWR, 0600);
+  if (fd < 0)
+    return NULL;
+
+  if (create && ftruncate(fd, sizeof(SolverShmRing)) < 0) {
+    close(fd);
+    return NULL;
+  }
+
+  p = mmap(NULL, sizeof(SolverShmRing),
+    PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED)
+    return NULL;
+
+  ring = static_cast<SolverShmRing*>(p);
+  if (create) {
+    memset(ring, 0, sizeof(*ring));
+    ring->nslots = SOLVER_SHM_SLOTS;
+    __sync_synchronize();
+    ring->magic = SOLVER_SHM_MAGIC;
+  } else if (ring->magic != SOLVER_SHM_MAGIC) {
+    munmap(p, sizeof(SolverShmRing));
+    return NULL;
+  }
+
+  return ring;
+}
+
+static inline void solverShmClose(SolverShmRing* ring)
+{ munmap(ring, sizeof(SolverShmRing)); }
+
+/* returns claimed slot or NULL if all are in use */
+static inline SolverShmSlot* solverShmClaim(SolverShmRing* ring)
+{
+  for (unsigned i = 0; i < ring->nslots; i++) {
+    SolverShmSlot *s = &ring->slots[i];
+    if (__sync_bool_compare_and_swap(
+        &s->state, SHM_SLOT_FREE, SHM_SLOT_CLAIMED))
+      return s;
+  }
+  return NULL;
+}
+
+static inline void solverShmPost(SolverShmRing* ring, SolverShmSlot* s)
+{
+  __sync_synchronize();
+  s->state = SHM_SLOT_REQ;
+  __sync_fetch_and_add(&ring->doorbell, 1);
+  solverShmWake(&ring->doorbell);
+}
+
+/* daemon side; publish response (or failure) in slot */
+static inline void solverShmFinish(SolverShmSlot* s, bool ok)
+{
+  __sync_synchronize();
+  /* only fails if the client abandoned the slot; nobody will read it */
+  if (!__sync_bool_compare_and_swap(
+      &s->state, SHM_SLOT_BUSY, ok ? SHM_SLOT_RES : SHM_SLOT_ERR))
+    s->state = SHM_SLOT_FREE;
+  solverShmWake(&s->state);
+}
+
+/* client side; give up on a posted request without leaking the slot */
+static inline void solverShmAbandon(SolverShmSlot* s)
+{
+  while (true) {
+    uint32_t st = s->state;
+
+    /* solverd hasn't seen it; take it back */
+    if (st == SHM_SLOT_REQ) {
+      if (__sync_bool_compare_and_swap(&s->state, st, SHM_SLOT_FREE))
+        return;
+      continue;
+    }
+
+    /* solverd is on it; it frees the slot when it finishes */
+    if (st == SHM_SLOT_BUSY) {
+      if (__sync_bool_compare_and_swap(&s->state, st, SHM_SLOT_ABANDONED))
+        return;
+      continue;
+    }
+
+    /* answered after all */
+    s->state = SHM_SLOT_FREE;
+    return;
+  }
+}
+
+} // End klee namespace
+
+#endif
@@ -23,6 +23,9 @@ namespace stats {
   extern Statistic queriesInvalid;
   extern Statistic queriesValid;
   extern Statistic queriesFailed;
+  extern Statistic queriesRaced;
+  extern Statistic queriesAsync;
+  extern Statistic queriesAsyncHits;
   extern Statistic queryCacheHits;
   extern Statistic queryCacheMisses;
   extern Statistic queryConstructTime;
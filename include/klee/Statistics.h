@@ -59,6 +59,9 @@ namespace klee {
 
     void registerStatistic(Statistic &s);
     void incrementStatistic(Statistic &s, uint64_t addend);
+    /* no per-instruction or context update; for merging totals */
+    void incrementGlobalValue(const Statistic &s, uint64_t addend)
+    { globalStats[s.id] += addend; }
     uint64_t getValue(const Statistic &s) const;
     void incrementIndexedValue(Statistic &s, unsigned index,  uint64_t addend);
     uint64_t getIndexedValue(const Statistic &s, unsigned index) const;
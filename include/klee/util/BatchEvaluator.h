@@ -0,0 +1,87 @@
+//===-- BatchEvaluator.h ----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_BATCHEVALUATOR_H
+#define KLEE_BATCHEVALUATOR_H
+
+#include "klee/util/ExprStore.h"
+#include "klee/util/TapeJIT.h"
+#include <vector>
+
+namespace klee {
+class Assignment;
+
+/* Checks one constraint set against many assignments.
+ *
+ * The constraints are compiled once into an ExprStore the first time a
+ * check needs it. Its id order is the instruction tape. Assignments are
+ * then run BATCH_LANES at a time, with each node's values for all lanes
+ * stored next to each other, so every tape step is a short loop the
+ * compiler can vectorize.
+ *
+ * A lane that the flat evaluator can't decide (zero divisor, free read)
+ * is rechecked with the ordinary ExprEvaluator. A store wider than 64
+ * bits skips batching and uses that path for every assignment.
+ *
+ * If a TapeJIT backend is installed and has compiled this constraint
+ * set, its native checker is used instead and the store is never
+ * built. */
+#define BATCH_LANES	8
+
+class BatchEvaluator
+{
+public:
+	template<typename InputIterator>
+	BatchEvaluator(InputIterator begin, InputIterator end)
+	: exprs(begin, end)
+	, built(false)
+	{}
+
+	virtual ~BatchEvaluator() {}
+
+	/* sat[i] is set iff as[i] satisfies every constraint */
+	void check(
+		const std::vector<const Assignment*>& as,
+		std::vector<bool>& sat);
+
+	/* index of the first satisfying assignment, or -1 */
+	int findSatisfying(const std::vector<const Assignment*>& as);
+
+	unsigned getTapeLength(void) { buildTape(); return store.size(); }
+
+	static uint64_t getNumBatches(void) { return batch_c; }
+	static uint64_t getNumSlowLanes(void) { return slow_c; }
+private:
+	/* fills sat[0..n) for as[0..n), n <= BATCH_LANES */
+	void runBatch(const Assignment* const* as, unsigned n, bool* sat);
+	/* fills the store on first use */
+	void buildTape(void);
+	bool checkSlow(const Assignment* a) const;
+	const TapeJIT::Checker* lookupJIT(void);
+	bool checkJIT(const TapeJIT::Checker* jc, const Assignment* a) const;
+	void evalReads(ExprStore::id_ty i, unsigned n, uint8_t* bad);
+
+	ExprStore			store;
+	std::vector<ExprStore::id_ty>	roots;
+	std::vector<ref<Expr> >		exprs;
+	bool				built;
+
+	/* per batch: node values, then per array slot the lane bindings */
+	std::vector<uint64_t>		vals;
+	std::vector<const std::vector<unsigned char>*>	binds;
+	std::vector<uint8_t>		frees;
+	/* single-lane values for nodes with no lane-wise case */
+	std::vector<uint64_t>		scratch;
+
+	static uint64_t	batch_c;
+	static uint64_t	slow_c;
+};
+}
+
+#endif
@@ -37,6 +37,37 @@ public:
   void set(unsigned idx) { bits[idx/32] |= 1<<(idx&0x1F); }
   void unset(unsigned idx) { bits[idx/32] &= ~(1<<(idx&0x1F)); }
   void set(unsigned idx, bool value) { if (value) set(idx); else unset(idx); }
+
+  /* word-at-a-time range ops over bits [off, off+len) */
+  bool isRangeSet(unsigned off, unsigned len) const
+  { return findFirstUnset(off, len) == off + len; }
+
+  /* first clear bit in the range, or off+len if all are set */
+  unsigned findFirstUnset(unsigned off, unsigned len) const {
+	unsigned end = off + len;
+	while (off < end) {
+		unsigned sh = off & 0x1F, n = 32 - sh;
+		uint32_t m, w;
+		if (n > end - off) n = end - off;
+		m = ((n == 32) ? ~((uint32_t)0) : ((1u << n) - 1)) << sh;
+		w = ~bits[off/32] & m;
+		if (w) return (off & ~0x1Fu) + __builtin_ctz(w);
+		off += n;
+	}
+	return end;
+  }
+
+  void setRange(unsigned off, unsigned len) {
+	unsigned end = off + len;
+	while (off < end) {
+		unsigned sh = off & 0x1F, n = 32 - sh;
+		if (n > end - off) n = end - off;
+		bits[off/32] |=
+			((n == 32) ? ~((uint32_t)0) : ((1u << n) - 1)) << sh;
+		off += n;
+	}
+  }
+
   bool iszero(unsigned len) const {
   	for (unsigned i = 0; i < length(len); i++)
 		if (bits[i] != 0) return false;
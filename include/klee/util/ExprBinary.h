@@ -0,0 +1,77 @@
+#ifndef KLEE_EXPRBINARY_H
+#define KLEE_EXPRBINARY_H
+
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <map>
+#include "klee/Expr.h"
+#include "klee/util/ExprHashMap.h"
+
+namespace klee
+{
+class ConstraintManager;
+
+/* Compact binary query stream.
+ *
+ * Every expression node, array, and update node goes out once as a
+ * record and is referred to by its index afterwards, so nodes shared
+ * between constraints (or between queries in the same stream) cost a
+ * varint. A query record lists constraint and query expr ids. A reset
+ * record drops both sides' tables so long logs don't pin every expr.
+ * Streams open with EXPR_BIN_MAGIC. */
+#define EXPR_BIN_MAGIC	"KQB1"
+
+class ExprBinWriter
+{
+public:
+	ExprBinWriter(std::ostream& _os);
+	virtual ~ExprBinWriter() {}
+
+	void writeQuery(const ConstraintManager& cs, const ref<Expr>& e);
+	void writeQuery(const std::vector<ref<Expr> >& cs, const ref<Expr>& e);
+	void reset(void);
+
+	unsigned getNumNodes(void) const { return expr_ids.size(); }
+private:
+	unsigned writeExpr(const ref<Expr>& e);
+	unsigned writeArray(const Array* arr);
+	unsigned writeUpdate(const Array* root, const UpdateNode* un);
+	void writeVarint(uint64_t v);
+
+	std::ostream				&os;
+	ExprHashMap<unsigned>			expr_ids;
+	std::map<const Array*, unsigned>	arr_ids;
+	std::map<const UpdateNode*, unsigned>	un_ids;
+	/* keep arrays alive while their ids are live */
+	std::vector<ref<Array> >		arrs;
+};
+
+/* streaming reader; pulls records until the next query */
+class ExprBinReader
+{
+public:
+	ExprBinReader(std::istream& _is);
+	virtual ~ExprBinReader() {}
+
+	/* false on end of stream or malformed input */
+	bool readQuery(std::vector<ref<Expr> >& cs, ref<Expr>& e);
+	bool hasError(void) const { return error; }
+private:
+	bool readExpr(void);
+	bool readArray(void);
+	bool readUpdate(void);
+	bool readVarint(uint64_t& v);
+	bool getExpr(uint64_t id, ref<Expr>& e) const;
+	void reset(void);
+
+	std::istream					&is;
+	std::vector<ref<Expr> >				exprs;
+	std::vector<ref<Array> >			arrs;
+	std::vector<std::unique_ptr<UpdateList> >	uls;
+	bool						error;
+	bool						got_magic;
+};
+}
+
+#endif
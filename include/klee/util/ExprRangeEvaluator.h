@@ -125,10 +125,24 @@ T ExprRangeEvaluator<T>::evaluate(const ref<Expr> &e) {
     const Expr *ep = e.get();
     T res(0);
     for (unsigned i=0; i<ep->getNumKids(); i++)
-      res = res.concat(evaluate(ep->getKid(i)),8);
+      res = res.concat(evaluate(ep->getKid(i)),ep->getKid(i)->getWidth());
     return res;
   }
 
+  case Expr::ZExt: {
+    const CastExpr *ce = cast<CastExpr>(e);
+    if (ce->src->getWidth() > 64)
+      break;
+    return evaluate(ce->src);
+  }
+
+  case Expr::Extract: {
+    const ExtractExpr *ee = cast<ExtractExpr>(e);
+    if (ee->expr->getWidth() > 64)
+      break;
+    return evaluate(ee->expr).extract(ee->offset, ee->offset + ee->width);
+  }
+
     // Arithmetic
 
   case Expr::Add: {
@@ -0,0 +1,116 @@
+//===-- ExprStore.h ---------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_EXPRSTORE_H
+#define KLEE_EXPRSTORE_H
+
+#include "klee/Expr.h"
+#include <unordered_map>
+#include <vector>
+
+namespace klee {
+class Assignment;
+
+/* Struct-of-arrays copy of an expression DAG.
+ *
+ * Each node gets a 32-bit id. Kind, width, hash, aux word and kid range
+ * are held in parallel arrays, and kids are ids into the same store.
+ * Nodes are hash-consed on (kind, width, aux, kids), so structurally
+ * equal subterms share an id even when their Exprs are different
+ * objects. A kid always has a lower id than its parent, so a walk in id
+ * order is a bottom-up walk with no recursion and no visitor.
+ *
+ * The aux word holds:
+ *   Constant	the value (widths <= 64 only)
+ *   Extract	the bit offset
+ *   Read	the array slot; kids are the index, then each update's
+ *		(index, value) pair from newest to oldest
+ *
+ * Roots passed to add() are kept alive, so the Expr-pointer cache in front
+ * of the structural lookup never sees a recycled address. */
+class ExprStore
+{
+public:
+	typedef uint32_t id_ty;
+
+	ExprStore() : wide(false) { kid_off.push_back(0); }
+	virtual ~ExprStore() {}
+
+	/* intern e and every subterm; returns e's id */
+	id_ty add(const ref<Expr>& e);
+
+	unsigned size(void) const { return kinds.size(); }
+	Expr::Kind getKind(id_ty i) const { return (Expr::Kind)kinds[i]; }
+	Expr::Width getWidth(id_ty i) const { return widths[i]; }
+	Expr::Hash getHash(id_ty i) const { return hashes[i]; }
+	uint64_t getAux(id_ty i) const { return aux[i]; }
+	unsigned getNumKids(id_ty i) const
+	{ return kid_off[i+1] - kid_off[i]; }
+	id_ty getKid(id_ty i, unsigned k) const { return kids[kid_off[i] + k]; }
+	const Array* getArray(id_ty i) const { return arrays[aux[i]].get(); }
+	/* reads name their array by slot (the aux word) */
+	unsigned getNumArrays(void) const { return arrays.size(); }
+	const Array* getArrayAt(unsigned slot) const
+	{ return arrays[slot].get(); }
+
+	/* some node is wider than 64 bits or has no flat form */
+	bool isWide(void) const { return wide; }
+
+	/* Value of every node under 'a', masked to its width. Fails if
+	 * the store is wide, a divisor is zero, or a read has no binding
+	 * and 'a' allows free values: cases where ExprEvaluator would not
+	 * produce a constant. */
+	bool evaluate(const Assignment& a, std::vector<uint64_t>& vals) const;
+
+	/* one node, given the values of its kids */
+	bool evalNode(
+		id_ty i,
+		const Assignment& a,
+		std::vector<uint64_t>& vals) const;
+
+	static uint64_t mask(uint64_t v, Expr::Width w)
+	{ return (w >= 64) ? v : v & ((1ULL << w) - 1); }
+
+	static int64_t sext(uint64_t v, Expr::Width w)
+	{
+		if (w >= 64 || w == 0) return (int64_t)v;
+		return (int64_t)(v << (64 - w)) >> (64 - w);
+	}
+
+private:
+	id_ty intern(const Expr* e);
+	id_ty cons(
+		Expr::Kind k, Expr::Width w, Expr::Hash h, uint64_t x,
+		const std::vector<id_ty>& ks);
+	unsigned getArraySlot(const ref<Array>& arr);
+	uint64_t readByte(
+		id_ty i, uint64_t idx,
+		const Assignment& a, const std::vector<uint64_t>& vals,
+		bool& ok) const;
+
+	std::vector<uint8_t>		kinds;
+	std::vector<Expr::Width>	widths;
+	std::vector<Expr::Hash>		hashes;
+	std::vector<uint64_t>		aux;
+	std::vector<id_ty>		kid_off;	/* size() + 1 entries */
+	std::vector<id_ty>		kids;
+
+	std::vector<ref<Expr> >		roots;
+	std::vector<ref<Array> >	arrays;
+	std::unordered_map<const Array*, unsigned>	array_slots;
+
+	/* Expr pointer => id, then structural hash => candidate ids */
+	std::unordered_map<const Expr*, id_ty>		expr_ids;
+	std::unordered_multimap<uint64_t, id_ty>	cons_tab;
+
+	bool	wide;
+};
+}
+
+#endif
@@ -52,6 +52,9 @@ public:
   // normal copy constructor
   ref(const ref<T> &r) : ptr(r.ptr) { inc(); }
 
+  // move constructor; takes over r's count instead of bumping it
+  ref(ref<T> &&r) : ptr(r.ptr) { r.ptr = 0; }
+
   // conversion constructor
   template<class U>
   ref (const ref<U> &r) {
@@ -73,6 +76,15 @@ public:
     return *this;
   }
 
+  ref<T> &operator= (ref<T> &&r) {
+    T* old_p = ptr;
+    if (&r == this) return *this;
+    ptr = r.ptr;
+    r.ptr = 0;
+    dec(old_p);
+    return *this;
+  }
+
   template<class U> ref<T> &operator= (const ref<U> &r) {
     T* old_p = ptr;
     ptr = r.ptr;
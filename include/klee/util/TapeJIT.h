@@ -0,0 +1,63 @@
+//===-- TapeJIT.h -----------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_TAPEJIT_H
+#define KLEE_TAPEJIT_H
+
+#include "klee/Expr.h"
+#include <vector>
+
+namespace klee {
+class Assignment;
+
+/* checkers with more arrays than this are never compiled */
+#define TAPE_MAX_ARRAYS	64
+
+/* Native checkers for constraint sets that are checked over and over.
+ *
+ * lookup() finds a set by hash. Once the set has been seen often enough,
+ * it returns a compiled checker. Until then, or if the set can't be
+ * lowered, it returns NULL and the caller evaluates as usual.
+ *
+ * The backend needs the JIT, so it lives with the executor and is
+ * installed with set(), like Expr::setBuilder. */
+class TapeJIT
+{
+public:
+	/* binds[s] and lens[s] hold the assignment's bytes for array slot s,
+	 * or NULL and 0. Returns 1 if every constraint holds and 0 if one
+	 * fails. Returns 2 if a read had no value or a divisor was zero. */
+	typedef int (*check_fn)(
+		const uint8_t* const* binds, const uint64_t* lens);
+
+	struct Checker
+	{
+		std::vector<ref<Expr> >		exprs;
+		std::vector<const Array*>	arrays;	/* by slot */
+		check_fn			fn;
+		unsigned			uses;
+	};
+
+	virtual ~TapeJIT() {}
+
+	virtual const Checker* lookup(const std::vector<ref<Expr> >& es) = 0;
+
+	/* 1 sat, 0 unsat, -1 undecided (use ExprEvaluator) */
+	static int run(const Checker* c, const Assignment& a);
+	static uint64_t hashSet(const std::vector<ref<Expr> >& es);
+
+	static TapeJIT* get(void) { return theJIT; }
+	/* returns the old backend */
+	static TapeJIT* set(TapeJIT* jit);
+private:
+	static TapeJIT	*theJIT;
+};
+}
+
+#endif
@@ -0,0 +1,290 @@
+//===-- ValueRange.h --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_UTIL_VALUERANGE_H
+#define KLEE_UTIL_VALUERANGE_H
+
+#include <algorithm>
+#include <iostream>
+#include "klee/Expr.h"
+#include "klee/util/Bits.h"
+#include "klee/Internal/Support/IntEvaluation.h"
+
+namespace klee {
+
+// Hacker's Delight, pgs 58-63
+static inline uint64_t minOR(uint64_t a, uint64_t b,
+                      uint64_t c, uint64_t d) {
+  uint64_t temp, m = ((uint64_t) 1)<<63;
+  while (m) {
+    if (~a & c & m) {
+      temp = (a | m) & -m;
+      if (temp <= b) { a = temp; break; }
+    } else if (a & ~c & m) {
+      temp = (c | m) & -m;
+      if (temp <= d) { c = temp; break; }
+    }
+    m >>= 1;
+  }
+
+  return a | c;
+}
+static inline uint64_t maxOR(uint64_t a, uint64_t b,
+                      uint64_t c, uint64_t d) {
+  uint64_t temp, m = ((uint64_t) 1)<<63;
+
+  while (m) {
+    if (b & d & m) {
+      temp = (b - m) | (m - 1);
+      if (temp >= a) { b = temp; break; }
+      temp = (d - m) | (m -1);
+      if (temp >= c) { d = temp; break; }
+    }
+    m >>= 1;
+  }
+
+  return b | d;
+}
+static inline uint64_t minAND(uint64_t a, uint64_t b,
+                       uint64_t c, uint64_t d) {
+  uint64_t temp, m = ((uint64_t) 1)<<63;
+  while (m) {
+    if (~a & ~c & m) {
+      temp = (a | m) & -m;
+      if (temp <= b) { a = temp; break; }
+      temp = (c | m) & -m;
+      if (temp <= d) { c = temp; break; }
+    }
+    m >>= 1;
+  }
+
+  return a & c;
+}
+static inline uint64_t maxAND(uint64_t a, uint64_t b,
+                       uint64_t c, uint64_t d) {
+  uint64_t temp, m = ((uint64_t) 1)<<63;
+  while (m) {
+    if (b & ~d & m) {
+      temp = (b & ~m) | (m - 1);
+      if (temp >= a) { b = temp; break; }
+    } else if (~b & d & m) {
+      temp = (d & ~m) | (m - 1);
+      if (temp >= c) { d = temp; break; }
+    }
+    m >>= 1;
+  }
+
+  return b & d;
+}
+
+/// Unsigned [min,max] interval; the value type for ExprRangeEvaluator.
+class ValueRange {
+private:
+  uint64_t m_min, m_max;
+
+public:
+  ValueRange() : m_min(1),m_max(0) {}
+  ValueRange(const ref<ConstantExpr> &ce) {
+    // FIXME: Support large widths.
+    m_min = m_max = ce->getLimitedValue();
+  }
+  ValueRange(uint64_t value) : m_min(value), m_max(value) {}
+  ValueRange(uint64_t _min, uint64_t _max) : m_min(_min), m_max(_max) {}
+  ValueRange(const ValueRange &b) : m_min(b.m_min), m_max(b.m_max) {}
+
+  void print(std::ostream &os) const {
+    if (isFixed()) {
+      os << m_min;
+    } else {
+      os << "[" << m_min << "," << m_max << "]";
+    }
+  }
+
+  bool isEmpty() const {  return m_min > m_max; }
+  bool contains(uint64_t value) const
+  { return this->intersects(ValueRange(value)); }
+  bool intersects(const ValueRange &b) const
+  { return !this->set_intersection(b).isEmpty(); }
+
+  bool isFullRange(unsigned bits)
+  { return m_min==0 && m_max==bits64::maxValueOfNBits(bits); }
+
+  ValueRange set_intersection(const ValueRange &b) const {
+    return ValueRange(std::max(m_min,b.m_min), std::min(m_max,b.m_max));
+  }
+  ValueRange set_union(const ValueRange &b) const
+  { return ValueRange(std::min(m_min,b.m_min), std::max(m_max,b.m_max)); }
+
+  ValueRange set_difference(const ValueRange &b) const {
+    // no intersection
+    if (b.isEmpty() || b.m_min > m_max || b.m_max < m_min)
+      return *this;
+    // empty
+    if (b.m_min <= m_min && b.m_max >= m_max)
+      return ValueRange(1,0);
+
+    // one range out
+    // cannot overflow because b.m_max < m_max
+    if (b.m_min <= m_min)
+      return ValueRange(b.m_max+1, m_max);
+
+    // cannot overflow because b.min > m_min
+    if (b.m_max >= m_max)
+      return ValueRange(m_min, b.m_min-1);
+
+    // two ranges, take bottom
+    return ValueRange(m_min, b.m_min-1);
+  }
+
+  ValueRange binaryAnd(const ValueRange &b) const {
+    // XXX
+    assert(!isEmpty() && !b.isEmpty() && "XXX");
+    if (isFixed() && b.isFixed())
+      return ValueRange(m_min & b.m_min);
+    return ValueRange(minAND(m_min, m_max, b.m_min, b.m_max),
+                      maxAND(m_min, m_max, b.m_min, b.m_max));
+  }
+
+  ValueRange binaryAnd(uint64_t b) const { return binaryAnd(ValueRange(b)); }
+  ValueRange binaryOr(ValueRange b) const {
+    // XXX
+    assert(!isEmpty() && !b.isEmpty() && "XXX");
+    if (isFixed() && b.isFixed()) {
+      return ValueRange(m_min | b.m_min);
+    } else {
+      return ValueRange(minOR(m_min, m_max, b.m_min, b.m_max),
+                        maxOR(m_min, m_max, b.m_min, b.m_max));
+    }
+  }
+  ValueRange binaryOr(uint64_t b) const { return binaryOr(ValueRange(b)); }
+  ValueRange binaryXor(ValueRange b) const {
+    if (isFixed() && b.isFixed()) {
+      return ValueRange(m_min ^ b.m_min);
+    } else {
+      uint64_t t = m_max | b.m_max;
+      while (!bits64::isPowerOfTwo(t))
+        t = bits64::withoutRightmostBit(t);
+      return ValueRange(0, (t<<1)-1);
+    }
+  }
+
+  ValueRange binaryShiftLeft(unsigned bits) const
+  { return ValueRange(m_min<<bits, m_max<<bits); }
+  ValueRange binaryShiftRight(unsigned bits) const
+  { return ValueRange(m_min>>bits, m_max>>bits); }
+
+  ValueRange concat(const ValueRange &b, unsigned bits) const {
+    if (bits >= 64 || (bits && (m_max >> (64 - bits)) != 0))
+      return ValueRange(0, ~((uint64_t) 0));
+    return binaryShiftLeft(bits).binaryOr(b);
+  }
+  ValueRange extract(uint64_t lowBit, uint64_t maxBit) const {
+    return binaryShiftRight(lowBit).binaryAnd(bits64::maxValueOfNBits(maxBit-lowBit));
+  }
+
+  // exact unless the result can wrap, then the full range
+  ValueRange add(const ValueRange &b, unsigned width) const {
+    uint64_t top = bits64::maxValueOfNBits(width);
+    if (isEmpty() || b.isEmpty())
+      return ValueRange();
+    if (m_max > top || b.m_max > top - m_max)
+      return ValueRange(0, top);
+    return ValueRange(m_min + b.m_min, m_max + b.m_max);
+  }
+  ValueRange sub(const ValueRange &b, unsigned width) const {
+    uint64_t top = bits64::maxValueOfNBits(width);
+    if (isEmpty() || b.isEmpty())
+      return ValueRange();
+    if (m_max > top || m_min < b.m_max)
+      return ValueRange(0, top);
+    return ValueRange(m_min - b.m_max, m_max - b.m_min);
+  }
+  ValueRange mul(const ValueRange &b, unsigned width) const {
+    uint64_t top = bits64::maxValueOfNBits(width);
+    if (isEmpty() || b.isEmpty())
+      return ValueRange();
+    if (m_max > top || (m_max != 0 && b.m_max > top / m_max))
+      return ValueRange(0, top);
+    return ValueRange(m_min * b.m_min, m_max * b.m_max);
+  }
+  ValueRange udiv(const ValueRange &b, unsigned width) const
+  { return ValueRange(0, bits64::maxValueOfNBits(width)); }
+  ValueRange sdiv(const ValueRange &b, unsigned width) const 
+  { return ValueRange(0, bits64::maxValueOfNBits(width)); }
+  ValueRange urem(const ValueRange &b, unsigned width) const
+  { return ValueRange(0, bits64::maxValueOfNBits(width)); }
+  ValueRange srem(const ValueRange &b, unsigned width) const
+  { return ValueRange(0, bits64::maxValueOfNBits(width));  }
+
+  // use min() to get value if true (XXX should we add a method to
+  // make code clearer?)
+  bool isFixed() const { return m_min==m_max; }
+
+  bool operator==(const ValueRange &b) const
+  { return m_min==b.m_min && m_max==b.m_max; }
+
+  bool operator!=(const ValueRange &b) const { return !(*this==b); }
+
+  bool mustEqual(const uint64_t b) const { return m_min==m_max && m_min==b; }
+  bool mayEqual(const uint64_t b) const { return m_min<=b && m_max>=b; }
+
+  bool mustEqual(const ValueRange &b) const
+  { return isFixed() && b.isFixed() && m_min==b.m_min; }
+
+  bool mayEqual(const ValueRange &b) const { return this->intersects(b); }
+
+  uint64_t min() const {
+    assert(!isEmpty() && "cannot get minimum of empty range");
+    return m_min;
+  }
+
+  uint64_t max() const {
+    assert(!isEmpty() && "cannot get maximum of empty range");
+    return m_max;
+  }
+
+  int64_t minSigned(unsigned bits) const {
+    assert((m_min>>bits)==0 && (m_max>>bits)==0 &&
+           "range is outside given number of bits");
+
+    // if max allows sign bit to be set then it can be smallest value,
+    // otherwise since the range is not empty, min cannot have a sign
+    // bit
+
+    uint64_t smallest = ((uint64_t) 1 << (bits-1));
+    if (m_max >= smallest) {
+      return ints::sext(smallest, 64, bits);
+    } else {
+      return m_min;
+    }
+  }
+
+  int64_t maxSigned(unsigned bits) const {
+    assert((m_min>>bits)==0 && (m_max>>bits)==0 &&
+           "range is outside given number of bits");
+
+    uint64_t smallest = ((uint64_t) 1 << (bits-1));
+
+    // if max and min have sign bit then max is max, otherwise if only
+    // max has sign bit then max is largest signed integer, otherwise
+    // max is max
+
+    if (m_min < smallest && m_max >= smallest) {
+      return smallest - 1;
+    } else {
+      return ints::sext(m_max, 64, bits);
+    }
+  }
+};
+
+inline std::ostream &operator<<(std::ostream &os, const ValueRange &vr)
+{ vr.print(os); return os; }
+}
+
+#endif
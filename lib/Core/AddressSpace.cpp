@@ -15,18 +15,32 @@
 #include <stdint.h>
 #include <stack>
 #include "static/Sugar.h"
+#include <llvm/Support/CommandLine.h>
 
 using namespace llvm;
 using namespace klee;
 
+uint64_t AddressSpace::tlb_tag_c = 0;
+
+namespace {
+	/* off until measured; the first write to a page-aligned object
+	 * after a fork copies a path of table nodes (~3.5KB) */
+	cl::opt<bool> UsePageTable(
+		"use-pagetable",
+		cl::desc("Resolve page-aligned objects through a page table."),
+		cl::init(false));
+}
+
 void AddressSpace::unbindObject(const MemoryObject *mo)
 {
 	if (mo == last_mo)
 		last_mo = NULL;
 
 	objects = objects.remove(mo);
+	if (UsePageTable) pt.remove(mo);
 	mo_generation++;
 	os_generation++;
+	newTag();
 }
 
 const ObjectState *AddressSpace::findObject(const MemoryObject *mo) const
@@ -44,7 +58,23 @@ void AddressSpace::bindObject(const MemoryObject *mo, ObjectState *os)
 
 	assert (os->getSize() >= mo->size);
 	objects = objects.replace(std::make_pair(mo, os));
+	if (UsePageTable) pt.set(mo, os);
 	os_generation++;
+	newTag();
+
+	if (mo == last_mo)
+		last_mo = NULL;
+}
+
+void AddressSpace::rebindShared(const MemoryObject *mo, const ObjectState *os)
+{
+	assert (!os->hasOwner() && "shared object must be unowned");
+	assert (os->getSize() >= mo->size);
+	objects = objects.replace(
+		std::make_pair(mo, const_cast<ObjectState*>(os)));
+	if (UsePageTable) pt.set(mo, os);
+	os_generation++;
+	newTag();
 
 	if (mo == last_mo)
 		last_mo = NULL;
@@ -64,7 +94,9 @@ ObjectState *AddressSpace::getWriteable(
 	assert (n->getCopyDepth());
 	n->setOwner(cowKey);
 	objects = objects.replace(std::make_pair(mo, n));
+	if (UsePageTable) pt.set(mo, n);
 	os_generation++;
+	newTag();
 
 	return n;
 }
@@ -88,6 +120,9 @@ bool AddressSpace::resolveOne(uint64_t address, ObjectPair &result) const
 	if (address == 0)
 		return false;
 
+	if (UsePageTable && pt.lookup(address, result))
+		return true;
+
 	MemoryObject			toFind(address);
 
 	res = objects.lookup_previous(&toFind);
@@ -522,7 +557,9 @@ void AddressSpace::clear(void)
 	cowKey = -1;
 	os_generation = 0;
 	mo_generation = 0;
+	newTag();
 	objects = MemoryMap();
+	pt.clear();
 }
 
 void AddressSpace::checkObjects(void) const
@@ -12,6 +12,7 @@
 
 #include <stack>
 #include "ObjectHolder.h"
+#include "PageTable.h"
 
 #include "klee/Expr.h"
 #include "klee/Internal/ADT/ImmutableMap.h"
@@ -55,6 +56,13 @@ private:
 
 	const MemoryObject* last_mo;
 
+	/* Names the exact contents of the map. Every change draws a fresh
+	 * tag; a copy keeps its source's tag until either side changes,
+	 * so shared translations stay valid across forked states. */
+	uint64_t	tlb_tag;
+	static uint64_t	tlb_tag_c;
+	void newTag(void) { tlb_tag = ++tlb_tag_c; }
+
 	/// Unsupported, use copy constructor
 	AddressSpace &operator=(const AddressSpace&);
 
@@ -66,19 +74,25 @@ private:
 	///
 	/// \invariant forall o in objects, o->copyOnWriteOwner <= cowKey
 	MemoryMap objects;
+
+	/* page-aligned subset of objects for fast concrete lookups */
+	PageTable pt;
 public:
 	AddressSpace()
 	: cowKey(1)
 	, os_generation(0)
 	, mo_generation(0)
-	, last_mo(NULL) {}
+	, last_mo(NULL)
+	, tlb_tag(++tlb_tag_c) {}
 
 	AddressSpace(const AddressSpace &b)
 	: cowKey(++b.cowKey)
 	, os_generation(b.os_generation)
 	, mo_generation(b.mo_generation)
 	, last_mo(NULL)
+	, tlb_tag(b.tlb_tag)
 	, objects(b.objects)
+	, pt(b.pt)
 	{ }
 
 	virtual ~AddressSpace() {}
@@ -94,6 +108,7 @@ public:
 	Expr::Hash hash(void) const;
 	unsigned getGeneration(void) const { return os_generation; }
 	unsigned getGenerationMO(void) const { return mo_generation; }
+	uint64_t getTag(void) const { return tlb_tag; }
 private:
 	/// Add a binding to the address space.
 	void bindObject(const MemoryObject *mo, ObjectState *os);
@@ -121,6 +136,10 @@ public:
 	/// Remove a binding from the address space.
 	void unbindObject(const MemoryObject *mo);
 
+	/* point mo at an unowned object with the same contents;
+	 * the next write through this space copies it again */
+	void rebindShared(const MemoryObject *mo, const ObjectState *os);
+
 	/* an integrity check to make sure that object states have
 	 * sizes >= memory objects */
 	void checkObjects(void) const;
@@ -145,7 +145,7 @@ bool ConcreteMMU::lookup(
 		/* no feasible objects */
 		return false;
 	}
-	tlb.put(state, op);
+	tlb.put(state, addr, op);
 
 	in_bounds = op.first->isInBounds(addr, byte_c);
 	if (in_bounds == false) {
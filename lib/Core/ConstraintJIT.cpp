@@ -0,0 +1,408 @@
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/GlobalVariable.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/Support/CommandLine.h>
+#include <sstream>
+#include <iostream>
+#include "static/Sugar.h"
+#include "klee/util/ExprStore.h"
+#include "ExternalDispatcher.h"
+#include "ConstraintJIT.h"
+
+using namespace klee;
+using namespace llvm;
+
+#define TAG	"[ConstraintJIT] "
+
+namespace {
+	cl::opt<bool> UseConstraintJIT(
+		"jit-constraints",
+		cl::desc("Compile hot constraint sets to native checkers "
+			 "for cex cache and ktest evaluation."),
+		cl::init(false));
+
+	cl::opt<unsigned> JITHotUses(
+		"jit-constraints-hot",
+		cl::desc("Lookups of a constraint set before it is compiled."),
+		cl::init(8));
+
+	cl::opt<unsigned> JITMaxSets(
+		"jit-constraints-max",
+		cl::desc("Most constraint sets compiled by the constraint JIT."),
+		cl::init(4096));
+
+	cl::opt<unsigned> JITMaxCold(
+		"jit-constraints-cold",
+		cl::desc("Most uncompiled constraint sets tracked by the "
+			 "constraint JIT; least recently seen go first."),
+		cl::init(16384));
+
+/* one checker function under construction */
+class TapeLowering
+{
+public:
+	TapeLowering(const ExprStore& _st, Module& _m, Function* f)
+	: st(_st)
+	, m(_m)
+	, irb(BasicBlock::Create(getGlobalContext(), "entry", f))
+	, v(_st.size(), NULL)
+	{
+		Function::arg_iterator	ai = f->arg_begin();
+		Value			*binds = &*ai++;
+		Value			*lens = &*ai;
+
+		bad = irb.getFalse();
+		zero_byte = new GlobalVariable(
+			m, irb.getInt8Ty(), true,
+			GlobalValue::PrivateLinkage, irb.getInt8(0), "zb");
+
+		for (unsigned s = 0; s < st.getNumArrays(); s++) {
+			bp.push_back(irb.CreateLoad(
+				irb.CreateConstGEP1_32(binds, s)));
+			bl.push_back(irb.CreateLoad(
+				irb.CreateConstGEP1_32(lens, s)));
+		}
+	}
+
+	bool lowerNode(ExprStore::id_ty i);
+	void finish(const std::vector<ExprStore::id_ty>& roots);
+private:
+	Value* lowerRead(ExprStore::id_ty i);
+	Value* lowerDiv(Expr::Kind k, Value* l, Value* r, IntegerType* ty);
+	Value* lowerShift(Expr::Kind k, Value* l, Value* r, IntegerType* ty);
+
+	const ExprStore		&st;
+	Module			&m;
+	IRBuilder<>		irb;
+	std::vector<Value*>	v;	/* by store id */
+	std::vector<Value*>	bp, bl;	/* by array slot */
+	Value			*bad;
+	GlobalVariable		*zero_byte;
+};
+}
+
+unsigned ConstraintJIT::compiled_c = 0;
+
+bool ConstraintJIT::isEnabled(void) { return UseConstraintJIT; }
+
+ConstraintJIT::ConstraintJIT()
+: ed(std::make_unique<ExternalDispatcher>())
+, fn_c(0)
+{}
+
+ConstraintJIT::~ConstraintJIT()
+{
+	foreach (it, checkers.begin(), checkers.end())
+		delete it->second;
+}
+
+ConstraintJIT::Entry* ConstraintJIT::find(
+	uint64_t h, const std::vector<ref<Expr> >& es) const
+{
+	auto range(checkers.equal_range(h));
+	for (auto it = range.first; it != range.second; ++it) {
+		Entry		*cur = it->second;
+		unsigned	i;
+
+		if (cur->exprs.size() != es.size())
+			continue;
+
+		for (i = 0; i < es.size(); i++) {
+			if (cur->exprs[i]->hash() != es[i]->hash())
+				break;
+			if (cur->exprs[i] != es[i])
+				break;
+		}
+
+		if (i == es.size())
+			return cur;
+	}
+
+	return NULL;
+}
+
+void ConstraintJIT::evictCold(void)
+{
+	Entry	*e = cold.back();
+
+	cold.pop_back();
+
+	auto range(checkers.equal_range(e->hash));
+	for (auto it = range.first; it != range.second; ++it) {
+		if (it->second == e) {
+			checkers.erase(it);
+			break;
+		}
+	}
+
+	delete e;
+}
+
+const TapeJIT::Checker* ConstraintJIT::lookup(
+	const std::vector<ref<Expr> >& es)
+{
+	uint64_t	h = hashSet(es);
+	Entry		*c = find(h, es);
+
+	if (c != NULL && c->fn != NULL)
+		return c;
+
+	if (c == NULL) {
+		while (!cold.empty() && cold.size() >= JITMaxCold)
+			evictCold();
+
+		c = new Entry();
+		c->exprs = es;
+		c->fn = NULL;
+		c->uses = 0;
+		c->hash = h;
+		checkers.insert(std::make_pair(h, c));
+		cold.push_front(c);
+		c->lru = cold.begin();
+	} else
+		cold.splice(cold.begin(), cold, c->lru);
+
+	/* compiles at most once; a failed set stays NULL until evicted */
+	if (	c->uses <= JITHotUses && ++c->uses == JITHotUses &&
+		fn_c < JITMaxSets)
+		c->fn = compile(*c);
+
+	if (c->fn == NULL)
+		return NULL;
+
+	/* compiled code is never freed, so the entry stays for good */
+	cold.erase(c->lru);
+	fn_c++;
+	return c;
+}
+
+TapeJIT::check_fn ConstraintJIT::compile(Checker& c)
+{
+	LLVMContext			&ctx(getGlobalContext());
+	ExprStore			st;
+	std::vector<ExprStore::id_ty>	roots;
+	std::unique_ptr<Module>		m;
+	std::vector<Type*>		args;
+	std::stringstream		ss;
+	Function			*f;
+	void				*fn;
+
+	foreach (it, c.exprs.begin(), c.exprs.end())
+		roots.push_back(st.add(*it));
+
+	if (st.isWide() || st.getNumArrays() > TAPE_MAX_ARRAYS)
+		return NULL;
+
+	ss << "ktape" << compiled_c;
+	m = std::make_unique<Module>(ss.str(), ctx);
+
+	args.push_back(PointerType::getUnqual(Type::getInt8PtrTy(ctx)));
+	args.push_back(PointerType::getUnqual(Type::getInt64Ty(ctx)));
+	f = Function::Create(
+		FunctionType::get(Type::getInt32Ty(ctx), args, false),
+		GlobalValue::ExternalLinkage,
+		ss.str(),
+		m.get());
+
+	TapeLowering	tl(st, *m, f);
+	for (ExprStore::id_ty i = 0; i < st.size(); i++)
+		if (!tl.lowerNode(i))
+			return NULL;
+	tl.finish(roots);
+
+	fn = ed->compileModule(std::move(m), ss.str());
+	if (fn == NULL)
+		return NULL;
+
+	for (unsigned s = 0; s < st.getNumArrays(); s++)
+		c.arrays.push_back(st.getArrayAt(s));
+
+	compiled_c++;
+	return (check_fn)fn;
+}
+
+/* same order as ExprEvaluator::evalRead: updates, constant array, binding */
+Value* TapeLowering::lowerRead(ExprStore::id_ty i)
+{
+	unsigned	slot = st.getAux(i);
+	const Array	*arr = st.getArrayAt(slot);
+	unsigned	nk = st.getNumKids(i);
+	Value		*idx, *inb, *p, *val, *found;
+
+	idx = irb.CreateZExt(v[st.getKid(i, 0)], irb.getInt64Ty());
+
+	/* never dereference past the binding; load a dummy byte instead */
+	inb = irb.CreateICmpULT(idx, bl[slot]);
+	p = irb.CreateGEP(bp[slot], irb.CreateSelect(inb, idx, irb.getInt64(0)));
+	val = irb.CreateLoad(irb.CreateSelect(inb, p, zero_byte));
+	found = inb;
+
+	if (arr->isConstantArray() && arr->mallocKey.size > 0) {
+		std::vector<Constant*>	cs;
+		std::vector<Value*>	gidx;
+		ArrayType		*at;
+		GlobalVariable		*g;
+		Value			*cin;
+
+		for (unsigned k = 0; k < arr->mallocKey.size; k++)
+			cs.push_back(irb.getInt8(arr->getValue(k)->getZExtValue()));
+
+		at = ArrayType::get(irb.getInt8Ty(), cs.size());
+		g = new GlobalVariable(
+			m, at, true, GlobalValue::PrivateLinkage,
+			ConstantArray::get(at, cs), "carr");
+
+		cin = irb.CreateICmpULT(idx, irb.getInt64(cs.size()));
+		gidx.push_back(irb.getInt64(0));
+		gidx.push_back(irb.CreateSelect(cin, idx, irb.getInt64(0)));
+		val = irb.CreateSelect(cin, irb.CreateLoad(irb.CreateGEP(g, gidx)), val);
+		found = irb.CreateOr(found, cin);
+	}
+
+	/* kids are (index, value) newest first; apply oldest first */
+	for (int k = (int)nk - 2; k >= 1; k -= 2) {
+		Value	*hit;
+
+		hit = irb.CreateICmpEQ(
+			irb.CreateZExt(v[st.getKid(i, k)], irb.getInt64Ty()),
+			idx);
+		val = irb.CreateSelect(hit, v[st.getKid(i, k + 1)], val);
+		found = irb.CreateOr(found, hit);
+	}
+
+	bad = irb.CreateOr(bad, irb.CreateNot(found));
+	return val;
+}
+
+/* LLVM division by zero and INT_MIN / -1 are undefined; match APInt */
+Value* TapeLowering::lowerDiv(
+	Expr::Kind k, Value* l, Value* r, IntegerType* ty)
+{
+	Value	*z, *m1, *rs, *q;
+
+	z = irb.CreateICmpEQ(r, ConstantInt::get(ty, 0));
+	bad = irb.CreateOr(bad, z);
+
+	if (k == Expr::UDiv || k == Expr::URem) {
+		rs = irb.CreateSelect(z, ConstantInt::get(ty, 1), r);
+		return (k == Expr::UDiv)
+			? irb.CreateUDiv(l, rs)
+			: irb.CreateURem(l, rs);
+	}
+
+	m1 = irb.CreateICmpEQ(r, Constant::getAllOnesValue(ty));
+	rs = irb.CreateSelect(
+		irb.CreateOr(z, m1), ConstantInt::get(ty, 1), r);
+	if (k == Expr::SDiv) {
+		q = irb.CreateSDiv(l, rs);
+		return irb.CreateSelect(m1, irb.CreateNeg(l), q);
+	}
+
+	q = irb.CreateSRem(l, rs);
+	return irb.CreateSelect(m1, ConstantInt::get(ty, 0), q);
+}
+
+/* over-wide shifts are poison in LLVM but defined for exprs */
+Value* TapeLowering::lowerShift(
+	Expr::Kind k, Value* l, Value* r, IntegerType* ty)
+{
+	unsigned	w = ty->getBitWidth();
+	Value		*big, *sh;
+
+	big = irb.CreateICmpUGE(r, ConstantInt::get(ty, w));
+	if (k == Expr::AShr) {
+		sh = irb.CreateSelect(big, ConstantInt::get(ty, w - 1), r);
+		return irb.CreateAShr(l, sh);
+	}
+
+	sh = irb.CreateSelect(big, ConstantInt::get(ty, 0), r);
+	return irb.CreateSelect(
+		big,
+		ConstantInt::get(ty, 0),
+		(k == Expr::Shl) ? irb.CreateShl(l, sh) : irb.CreateLShr(l, sh));
+}
+
+bool TapeLowering::lowerNode(ExprStore::id_ty i)
+{
+	IntegerType	*ty = irb.getIntNTy(st.getWidth(i));
+	unsigned	nk = st.getNumKids(i);
+	Value		*l = NULL, *r = NULL, *ret;
+
+	if (nk > 0) l = v[st.getKid(i, 0)];
+	if (nk > 1) r = v[st.getKid(i, 1)];
+
+	switch (st.getKind(i)) {
+	case Expr::Constant: ret = ConstantInt::get(ty, st.getAux(i)); break;
+	case Expr::NotOptimized: ret = l; break;
+	case Expr::Read: ret = lowerRead(i); break;
+	case Expr::Select:
+		ret = irb.CreateSelect(l, r, v[st.getKid(i, 2)]);
+		break;
+	case Expr::Concat:
+		ret = irb.CreateOr(
+			irb.CreateShl(
+				irb.CreateZExt(l, ty),
+				st.getWidth(st.getKid(i, 1))),
+			irb.CreateZExt(r, ty));
+		break;
+	case Expr::Extract:
+		ret = irb.CreateTrunc(irb.CreateLShr(l, st.getAux(i)), ty);
+		break;
+	case Expr::ZExt: ret = irb.CreateZExt(l, ty); break;
+	case Expr::SExt: ret = irb.CreateSExt(l, ty); break;
+
+	case Expr::Add: ret = irb.CreateAdd(l, r); break;
+	case Expr::Sub: ret = irb.CreateSub(l, r); break;
+	case Expr::Mul: ret = irb.CreateMul(l, r); break;
+	case Expr::UDiv:
+	case Expr::URem:
+	case Expr::SDiv:
+	case Expr::SRem:
+		ret = lowerDiv(st.getKind(i), l, r, ty);
+		break;
+
+	case Expr::Not: ret = irb.CreateNot(l); break;
+	case Expr::And: ret = irb.CreateAnd(l, r); break;
+	case Expr::Or: ret = irb.CreateOr(l, r); break;
+	case Expr::Xor: ret = irb.CreateXor(l, r); break;
+	case Expr::Shl:
+	case Expr::LShr:
+	case Expr::AShr:
+		ret = lowerShift(st.getKind(i), l, r, ty);
+		break;
+
+	case Expr::Eq: ret = irb.CreateICmpEQ(l, r); break;
+	case Expr::Ne: ret = irb.CreateICmpNE(l, r); break;
+	case Expr::Ult: ret = irb.CreateICmpULT(l, r); break;
+	case Expr::Ule: ret = irb.CreateICmpULE(l, r); break;
+	case Expr::Ugt: ret = irb.CreateICmpUGT(l, r); break;
+	case Expr::Uge: ret = irb.CreateICmpUGE(l, r); break;
+	case Expr::Slt: ret = irb.CreateICmpSLT(l, r); break;
+	case Expr::Sle: ret = irb.CreateICmpSLE(l, r); break;
+	case Expr::Sgt: ret = irb.CreateICmpSGT(l, r); break;
+	case Expr::Sge: ret = irb.CreateICmpSGE(l, r); break;
+
+	default:
+		std::cerr << TAG "Can't lower kind " << st.getKind(i) << '\n';
+		return false;
+	}
+
+	v[i] = ret;
+	return true;
+}
+
+void TapeLowering::finish(const std::vector<ExprStore::id_ty>& roots)
+{
+	Value	*all = irb.getTrue();
+
+	foreach (it, roots.begin(), roots.end())
+		all = irb.CreateAnd(all, v[*it]);
+
+	irb.CreateRet(irb.CreateSelect(
+		bad,
+		irb.getInt32(2),
+		irb.CreateZExt(all, irb.getInt32Ty())));
+}
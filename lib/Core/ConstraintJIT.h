@@ -0,0 +1,63 @@
+#ifndef KLEE_CONSTRAINTJIT_H
+#define KLEE_CONSTRAINTJIT_H
+
+#include "klee/util/TapeJIT.h"
+#include <unordered_map>
+#include <memory>
+#include <list>
+
+namespace klee
+{
+class ExternalDispatcher;
+class ExprStore;
+
+/* TapeJIT backend that lowers constraint sets to LLVM IR and compiles
+ * them with its own ExternalDispatcher.
+ *
+ * A set is first flattened into an ExprStore. Each node then becomes
+ * one straight-line SSA value, in store id order. Nothing branches:
+ * a read chooses among its updates, the constant array and the
+ * assignment's bytes with selects, and a zero divisor or a byte with
+ * no value sets a 'bad' flag so the caller falls back to ExprEvaluator.
+ *
+ * Sets wider than 64 bits, or reading more than TAPE_MAX_ARRAYS
+ * arrays, are never compiled. Compiled code is never freed, so the
+ * number of compiled sets is capped. Sets without a checker are only
+ * counted while they warm up; the least recently seen are dropped once
+ * too many are tracked. */
+class ConstraintJIT : public TapeJIT
+{
+public:
+	static ConstraintJIT* create(void) { return new ConstraintJIT(); }
+	virtual ~ConstraintJIT();
+
+	const Checker* lookup(const std::vector<ref<Expr> >& es) override;
+
+	static bool isEnabled(void);
+	static unsigned getNumCompiled(void) { return compiled_c; }
+private:
+	struct Entry;
+	typedef std::list<Entry*>	lru_ty;
+	struct Entry : public Checker
+	{
+		uint64_t		hash;
+		lru_ty::iterator	lru;	/* valid while fn == NULL */
+	};
+	typedef std::unordered_multimap<uint64_t, Entry*> checkers_ty;
+
+	ConstraintJIT();
+	check_fn compile(Checker& c);
+	Entry* find(uint64_t h, const std::vector<ref<Expr> >& es) const;
+	void evictCold(void);
+
+	std::unique_ptr<ExternalDispatcher>	ed;
+	checkers_ty				checkers;
+	/* entries without a checker, most recently seen first */
+	lru_ty					cold;
+	unsigned				fn_c;
+
+	static unsigned	compiled_c;
+};
+}
+
+#endif
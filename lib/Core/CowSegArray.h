@@ -0,0 +1,328 @@
+#ifndef KLEE_COWSEGARRAY_H
+#define KLEE_COWSEGARRAY_H
+
+#include <algorithm>
+#include <assert.h>
+#include <string.h>
+#include <stdint.h>
+#include "SlabAlloc.h"
+
+namespace klee
+{
+/* Fixed-size array split into refcounted lines of COW_SEG_ELEMS
+ * elements. Copying the array shares every line; writing an element
+ * clones only the line it falls in. A NULL line reads as T(), so
+ * zero-filled and never-written lines cost nothing. With a backing
+ * buffer, NULL lines read from the buffer instead and are copied out
+ * of it on first write; the buffer must outlive the array. A spill
+ * buffer (spillTo) belongs to this array alone and may be reused once
+ * it is unbacked, so copies take their own lines instead of sharing it. */
+#define COW_SEG_ELEMS	64
+
+template <class T>
+class CowSegArray
+{
+public:
+	CowSegArray(unsigned n)
+	: nsegs((n + COW_SEG_ELEMS - 1) / COW_SEG_ELEMS)
+	, segs(allocSegs(nsegs))
+	, backing(NULL)
+	, spilled(false)
+	{ memset(segs, 0, nsegs*sizeof(Seg*)); }
+
+	CowSegArray(const CowSegArray& a)
+	: nsegs(a.nsegs)
+	, segs(allocSegs(nsegs))
+	, backing(a.backing)
+	, spilled(false)
+	{
+		for (unsigned i = 0; i < nsegs; i++) {
+			segs[i] = a.segs[i];
+			if (segs[i]) segs[i]->refs++;
+		}
+
+		/* a's spill extent goes away with a's backing */
+		if (a.spilled)
+			unback();
+	}
+
+	~CowSegArray()
+	{
+		clear();
+		SlabAlloc::release(segs, nsegs*sizeof(Seg*));
+	}
+
+	const T& get(unsigned i) const
+	{
+		const Seg	*s = segs[i / COW_SEG_ELEMS];
+		if (s) return s->v[i % COW_SEG_ELEMS];
+		return (backing) ? backing[i] : getDefault();
+	}
+
+	T& getMut(unsigned i)
+	{ return getSeg(i / COW_SEG_ELEMS)->v[i % COW_SEG_ELEMS]; }
+
+	/* reset element to T() without materializing an empty line */
+	void reset(unsigned i)
+	{ if (segs[i / COW_SEG_ELEMS] || backing) getMut(i) = T(); }
+
+	/* every element back to T() */
+	void clear(void)
+	{
+		for (unsigned i = 0; i < nsegs; i++) {
+			putSeg(segs[i]);
+			segs[i] = NULL;
+		}
+		backing = NULL;
+		spilled = false;
+	}
+
+	/* NULL lines read from p; p must hold getNumSegs() full lines */
+	void setBacking(const T* p)
+	{
+		for (unsigned i = 0; i < nsegs; i++)
+			assert (segs[i] == NULL && "backing a written array");
+		backing = p;
+	}
+
+	bool isBacked(void) const { return backing != NULL; }
+	bool isSpilled(void) const { return spilled; }
+	const T* getBacking(void) const { return backing; }
+
+	/* moves lines no other array shares into p and backs the array by
+	 * it; shared lines stay put. p must hold getNumSegs() full lines
+	 * that read as T(). returns bytes moved */
+	uint64_t spillTo(T* p)
+	{
+		uint64_t	ret = 0;
+
+		assert (backing == NULL && "spilling a backed array");
+		for (unsigned i = 0; i < nsegs; i++) {
+			if (segs[i] == NULL || segs[i]->refs != 1)
+				continue;
+			std::copy(
+				segs[i]->v, segs[i]->v + COW_SEG_ELEMS,
+				p + i*COW_SEG_ELEMS);
+			ret += sizeof(segs[i]->v);
+			putSeg(segs[i]);
+			segs[i] = NULL;
+		}
+		backing = p;
+		spilled = true;
+		return ret;
+	}
+
+	/* copies backed lines into private ones and drops the backing;
+	 * lines that read as T() stay empty */
+	void unback(void)
+	{
+		static const Seg	empty;
+
+		if (backing == NULL)
+			return;
+
+		for (unsigned i = 0; i < nsegs; i++) {
+			const T	*line = backing + i*COW_SEG_ELEMS;
+			if (segs[i] != NULL)
+				continue;
+			if (!memcmp(line, empty.v, sizeof(empty.v)))
+				continue;
+			segs[i] = new Seg(line);
+		}
+		backing = NULL;
+		spilled = false;
+	}
+
+	void fill(const T& v)
+	{
+		for (unsigned i = 0; i < nsegs; i++) {
+			Seg	*s = getSeg(i);
+			std::fill(s->v, s->v + COW_SEG_ELEMS, v);
+		}
+	}
+
+	void copyIn(unsigned off, const T* src, unsigned n)
+	{
+		while (n) {
+			unsigned	s_off = off % COW_SEG_ELEMS;
+			unsigned	len = std::min(n, COW_SEG_ELEMS - s_off);
+
+			std::copy(src, src + len,
+				getSeg(off / COW_SEG_ELEMS)->v + s_off);
+			src += len;
+			off += len;
+			n -= len;
+		}
+	}
+
+	void copyOut(T* dst, unsigned off, unsigned n) const
+	{
+		while (n) {
+			unsigned	s_off = off % COW_SEG_ELEMS;
+			unsigned	len = std::min(n, COW_SEG_ELEMS - s_off);
+			const T		*line = getLine(off / COW_SEG_ELEMS);
+
+			std::copy(line + s_off, line + s_off + len, dst);
+			dst += len;
+			off += len;
+			n -= len;
+		}
+	}
+
+	/* memcmp semantics over the first n elements; shared lines skip */
+	int cmp(const CowSegArray& a, unsigned n) const
+	{
+		assert (a.nsegs == nsegs);
+		for (unsigned i = 0; i < nsegs && n; i++) {
+			unsigned	len = std::min(n, (unsigned)COW_SEG_ELEMS);
+			int		r;
+
+			n -= len;
+			if (segs[i] == a.segs[i] &&
+			    (segs[i] != NULL || backing == a.backing))
+				continue;
+
+			r = memcmp(getLine(i), a.getLine(i), len*sizeof(T));
+			if (r) return r;
+		}
+		return 0;
+	}
+
+	int cmp(const T* buf, unsigned off, unsigned n) const
+	{
+		while (n) {
+			unsigned	s_off = off % COW_SEG_ELEMS;
+			unsigned	len = std::min(n, COW_SEG_ELEMS - s_off);
+			int		r;
+
+			r = memcmp(
+				getLine(off / COW_SEG_ELEMS) + s_off,
+				buf, len*sizeof(T));
+			if (r) return r;
+			buf += len;
+			off += len;
+			n -= len;
+		}
+		return 0;
+	}
+
+	unsigned getNumSegs(void) const { return nsegs; }
+	bool isSegEmpty(unsigned s) const
+	{ return segs[s] == NULL && backing == NULL; }
+
+	/* bytewise hash of line s; kept in the line until it is written */
+	uint32_t hashLine(unsigned s) const
+	{
+		const Seg	*p = segs[s];
+
+		if (p == NULL)
+			return (backing)
+				? hashBytes(backing + s*COW_SEG_ELEMS)
+				: getEmptyHash();
+
+		if (!p->hash_ok) {
+			p->hash = hashBytes(p->v);
+			p->hash_ok = true;
+		}
+
+		return p->hash;
+	}
+
+	/* bytes in lines no other array shares; freed with this array */
+	uint64_t getPrivateBytes(void) const
+	{
+		uint64_t	ret = 0;
+		for (unsigned i = 0; i < nsegs; i++)
+			if (segs[i] && segs[i]->refs == 1)
+				ret += sizeof(segs[i]->v);
+		return ret;
+	}
+
+	/* number of lines cloned on write, all arrays of this type */
+	static uint64_t getNumClones(void) { return clone_c; }
+private:
+	struct Seg
+	{
+		Seg() : refs(1), hash_ok(false), v() {}
+		Seg(const Seg& s)
+		: refs(1), hash(s.hash), hash_ok(s.hash_ok)
+		{ std::copy(s.v, s.v + COW_SEG_ELEMS, v); }
+		Seg(const T* src) : refs(1), hash_ok(false)
+		{ std::copy(src, src + COW_SEG_ELEMS, v); }
+		static void* operator new(size_t sz)
+		{ return SlabAlloc::alloc(sz); }
+		static void operator delete(void* p, size_t sz)
+		{ SlabAlloc::release(p, sz); }
+
+		unsigned	refs;
+		mutable uint32_t	hash;
+		mutable bool	hash_ok;
+		T		v[COW_SEG_ELEMS];
+	};
+
+	static Seg** allocSegs(unsigned n)
+	{ return static_cast<Seg**>(SlabAlloc::alloc(n*sizeof(Seg*))); }
+
+	CowSegArray& operator=(const CowSegArray&) = delete;
+
+	static const T& getDefault(void)
+	{ static const T dummy = T(); return dummy; }
+
+	static uint32_t hashBytes(const T* line)
+	{
+		const uint8_t	*p = reinterpret_cast<const uint8_t*>(line);
+		uint32_t	h = 2166136261U;
+
+		for (unsigned i = 0; i < sizeof(T)*COW_SEG_ELEMS; i++)
+			h = (h ^ p[i]) * 16777619U;
+		return h;
+	}
+
+	static uint32_t getEmptyHash(void)
+	{
+		static const Seg	empty;
+		static const uint32_t	h = hashBytes(empty.v);
+		return h;
+	}
+
+	const T* getLine(unsigned s) const
+	{
+		static const Seg	empty;
+		if (segs[s]) return segs[s]->v;
+		return (backing) ? backing + s*COW_SEG_ELEMS : empty.v;
+	}
+
+	Seg* getSeg(unsigned s)
+	{
+		Seg	*&p(segs[s]);
+
+		if (p == NULL) {
+			p = (backing)
+				? new Seg(backing + s*COW_SEG_ELEMS)
+				: new Seg();
+		} else if (p->refs > 1) {
+			p->refs--;
+			p = new Seg(*p);
+			clone_c++;
+		}
+
+		/* caller is about to write */
+		p->hash_ok = false;
+		return p;
+	}
+
+	static void putSeg(Seg* s)
+	{ if (s && --s->refs == 0) delete s; }
+
+	const unsigned	nsegs;
+	Seg		**segs;
+	const T		*backing;
+	bool		spilled;	/* backing is a private spill extent */
+	static uint64_t	clone_c;
+};
+
+template <class T>
+uint64_t CowSegArray<T>::clone_c = 0;
+}
+
+#endif
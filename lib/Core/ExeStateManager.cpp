@@ -5,6 +5,7 @@
 #include "klee/Common.h"
 #include "static/Sugar.h"
 #include "PTree.h"
+#include "StateSpill.h"
 
 #include <llvm/Support/CommandLine.h>
 
@@ -28,6 +29,8 @@ ExeStateManager::~ExeStateManager()
 	/* flush all pending states */
 	commitQueue(NULL);
 
+	unparkAll();
+
 	/* wake up all yielding */
 	while (!yieldedStates.empty()) {
 		popYieldedState();
@@ -78,6 +81,9 @@ ExecutionState* ExeStateManager::selectState(void)
 	}
 	assert((allowCompact || !ret->isCompact()) && "compact state chosen");
 
+	if (StateSpill::isEnabled())
+		StateSpill::reload(*ret);
+
 	return ret;
 }
 
@@ -166,6 +172,43 @@ void ExeStateManager::forceYield(ExecutionState* s)
 	states.erase(s);
 }
 
+void ExeStateManager::park(ExecutionState* s, uint64_t key)
+{
+	assert (addedStates.empty() && removedStates.empty());
+	assert (states.count(s) && !s->isCompact());
+
+	searcher->removeState(s);
+	states.erase(s);
+	nonCompactStateCount--;
+	parkedStates.insert(std::make_pair(key, s));
+}
+
+unsigned ExeStateManager::unpark(uint64_t key)
+{
+	ExeStateSet	back;
+	auto		r(parkedStates.equal_range(key));
+
+	for (auto it = r.first; it != r.second; ++it)
+		back.insert(it->second);
+	parkedStates.erase(r.first, r.second);
+
+	if (back.empty())
+		return 0;
+
+	if (searcher != NULL)
+		searcher->update(
+			NULL, Searcher::States(back, Searcher::States::emptySet));
+	states.insert(back.begin(), back.end());
+	nonCompactStateCount += back.size();
+	return back.size();
+}
+
+void ExeStateManager::unparkAll(void)
+{
+	while (!parkedStates.empty())
+		unpark(parkedStates.begin()->first);
+}
+
 void ExeStateManager::dropAdded(ExecutionState* es)
 {
 	dropAddedDirect(es);
@@ -299,7 +342,35 @@ ExecutionState* ExeStateManager::getReplacedState(ExecutionState* s) const
 	return NULL;
 }
 
-void ExeStateManager::compactStates(unsigned toCompact)
+void ExeStateManager::partition(const std::function<bool(unsigned)>& keep)
+{
+	ExecutionState	*root_to_be_removed = NULL;
+	unsigned	rank = 0;
+
+	assert (addedStates.empty() && removedStates.empty());
+
+	/* set order is pointer order, which is the same in every
+	 * worker since they are all forked from one address space */
+	for (auto es : states) {
+		if (!keep(rank++))
+			queueRemove(es);
+	}
+
+	/* yielded states never reach the searcher; keep them with
+	 * whoever owns rank 0 */
+	if (!keep(0)) {
+		for (auto es : yieldedStates)
+			removePTreeState(es, &root_to_be_removed);
+		yieldedStates.clear();
+	}
+
+	commitQueue(NULL);
+
+	if (root_to_be_removed) removeRoot(root_to_be_removed);
+}
+
+void ExeStateManager::compactStates(
+	unsigned toCompact, const ExecutionState* current)
 {
 	std::vector<ExecutionState*> arr(nonCompactStateCount);
 	unsigned i = 0;
@@ -320,12 +391,34 @@ void ExeStateManager::compactStates(unsigned toCompact)
 		arr.end(),
 		KillOrCompactOrdering());
 
-	for (i = 0; i < toCompact; ++i)
-		compactState(arr[i]);
+	for (i = 0; i < toCompact; ++i) {
+		/* spilled states resume in place; compact what won't spill.
+		 * the running state may fork before it is picked (and
+		 * reloaded) again, so it never spills */
+		if (arr[i] == current || !spillState(arr[i]))
+			compactState(arr[i]);
+	}
 
 	onlyNonCompact = false;
 }
 
+bool ExeStateManager::spillState(ExecutionState* s)
+{
+	uint64_t	bytes;
+
+	if (!StateSpill::isEnabled())
+		return false;
+
+	bytes = StateSpill::spill(*s);
+	if (bytes == 0)
+		return false;
+
+	std::cerr << "[ExeMan] Spilled st=" << (void*)s << ". bytes="
+		<< bytes << ". total=" << StateSpill::getBytesSpilled()
+		<< '\n';
+	return true;
+}
+
 void ExeStateManager::compactState(ExecutionState* s)
 {
 	assert (s->isCompact() == false);
@@ -338,7 +431,8 @@ void ExeStateManager::compactState(ExecutionState* s)
 	assert (s->isCompact());
 }
 
-void ExeStateManager::compactPressureStates(uint64_t maxMem)
+void ExeStateManager::compactPressureStates(
+	uint64_t maxMem, const ExecutionState* current)
 {
 	// compact instead of killing
 	// (a rough measure)
@@ -349,7 +443,7 @@ void ExeStateManager::compactPressureStates(uint64_t maxMem)
 	toCompact = std::min(toCompact, (unsigned) nonCompactStateCount);
 	klee_warning("compacting %u states (over memory cap)", toCompact);
 
-	compactStates(toCompact);
+	compactStates(toCompact, current);
 
 	onlyNonCompact = true;
 }
@@ -6,6 +6,7 @@
 #include "klee/ExecutionState.h"
 #include "PTree.h"
 #include "Searcher.h"
+#include <functional>
 
 namespace klee
 {
@@ -41,6 +42,9 @@ private:
 	/* all yielded states */
 	ExeStateSet yieldedStates;
 
+	/* states waiting on an async solver answer, by query key */
+	std::multimap<uint64_t, ExecutionState*> parkedStates;
+
 	std::unique_ptr<Searcher> searcher;
 
 	/// Forces only non-compact states to be chosen. Initially false,
@@ -77,6 +81,12 @@ public:
 	void yield(ExecutionState* s);
 	void forceYield(ExecutionState* s);
 
+	/* takes 's' out of the searcher until unpark(key); the state
+	 * must be committed and have no queued changes */
+	void park(ExecutionState* s, uint64_t key);
+	unsigned unpark(uint64_t key);
+	void unparkAll(void);
+
 	void setInitialState(ExecutionState* initialState);
 	void setWeights(double weight);
 	void replaceState(ExecutionState* old_s, ExecutionState* new_s);
@@ -86,16 +96,26 @@ public:
 		ExecutionState** root_to_be_removed = NULL);
 	ExecutionState* getReplacedState(ExecutionState* s) const;
 
-	void compactPressureStates(uint64_t maxMem);
-	void compactStates(unsigned numToCompact);
+	/* drops every state whose rank in the state set fails 'keep';
+	 * used to hand disjoint slices of the states to forked workers */
+	void partition(const std::function<bool(unsigned)>& keep);
+
+	/* 'current' is the running state; it is never spilled */
+	void compactPressureStates(
+		uint64_t maxMem, const ExecutionState* current = NULL);
+	void compactStates(
+		unsigned numToCompact, const ExecutionState* current = NULL);
 	void compactState(ExecutionState* state);
+	/* moves private memory to the spill file; false if nothing moved */
+	bool spillState(ExecutionState* state);
 
 
 	bool empty(void) const { return size() == 0; }
 	unsigned size(void) const
-	{ return states.size() + yieldedStates.size(); }
+	{ return states.size() + yieldedStates.size() + parkedStates.size(); }
 
 	unsigned numYieldedStates(void) const { return yieldedStates.size(); }
+	unsigned numParkedStates(void) const { return parkedStates.size(); }
 	unsigned numRunningStates(void) const { return states.size(); }
 	unsigned numRemovedStates(void) const { return removedStates.size(); }
 	bool isRemovedState(ExecutionState* s) const;
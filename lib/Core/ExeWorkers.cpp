@@ -0,0 +1,303 @@
+#include <llvm/Support/CommandLine.h>
+#include <iostream>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+#include <signal.h>
+
+#include "klee/Common.h"
+#include "klee/Interpreter.h"
+#include "klee/Statistics.h"
+#include "Executor.h"
+#include "ExeStateManager.h"
+#include "StatsTracker.h"
+#include "StateSpill.h"
+#include "CoreStats.h"
+#include "ExeWorkers.h"
+
+using namespace klee;
+using namespace llvm;
+
+#define TAG "[ExeWorkers] "
+
+namespace
+{
+	cl::opt<unsigned>
+	NumExeWorkers(
+		"exe-workers",
+		cl::desc("Split exploration across N forked workers (0=off)"),
+		cl::init(0));
+
+	cl::opt<unsigned>
+	ExeWorkersMinStates(
+		"exe-workers-min-states",
+		cl::desc("Running states needed before splitting (default=4N)"),
+		cl::init(0));
+}
+
+namespace llvm { extern cl::opt<bool> UseForkedSTP; }
+
+/* what a worker did after the split; the deltas of every statistic
+ * follow the header */
+struct WorkerReport
+{
+	uint32_t	tests;
+	uint32_t	paths;
+	uint32_t	errors;
+	uint32_t	num_stats;
+};
+
+static bool xfer(int fd, void* buf, size_t len, bool is_write)
+{
+	uint8_t	*p = static_cast<uint8_t*>(buf);
+
+	while (len) {
+		ssize_t	n;
+
+		n = (is_write) ? write(fd, p, len) : read(fd, p, len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		p += n;
+		len -= n;
+	}
+
+	return true;
+}
+
+static bool isCoverageStat(const Statistic& s)
+{
+	return	&s == &stats::coveredInstructions ||
+		&s == &stats::uncoveredInstructions ||
+		&s == &stats::reachableUncovered;
+}
+
+void ExeWorkers::checkOptions(void)
+{
+	/* the forked solver's shared memory segment is process-global */
+	if (NumExeWorkers > 1 && UseForkedSTP)
+		klee_error("-exe-workers cannot be used with -use-forked-stp");
+}
+
+ExeWorkers* ExeWorkers::create(Executor& exe)
+{
+	if (NumExeWorkers <= 1)
+		return NULL;
+	return new ExeWorkers(exe, NumExeWorkers);
+}
+
+ExeWorkers::ExeWorkers(Executor& _exe, unsigned _numWorkers)
+: exe(_exe)
+, numWorkers(_numWorkers)
+, minStates(ExeWorkersMinStates)
+, workerId(0)
+, split(false)
+, report_fd(-1)
+{
+	assert (numWorkers > 1);
+	if (minStates < numWorkers)
+		minStates = 4*numWorkers;
+}
+
+bool ExeWorkers::trySplit(void)
+{
+	ExeStateManager	*esm;
+	unsigned	i;
+
+	if (split)
+		return false;
+
+	esm = exe.getStateManager();
+	if (esm->numRunningStates() < minStates)
+		return false;
+
+	/* async solver sessions can't be handed to another process */
+	if (esm->numParkedStates())
+		return false;
+
+	split = true;
+
+	/* anything left in a buffer would be written once per worker */
+	if (exe.getStatsTracker() != NULL)
+		exe.getStatsTracker()->flushFiles();
+	exe.getInterpreterHandler()->getInfoStream().flush();
+	fflush(NULL);
+
+	std::cerr << TAG"Splitting " << esm->numRunningStates()
+		<< " states across " << numWorkers << " workers\n";
+
+	/* workers would share (and punch holes in) the spill file */
+	StateSpill::reloadAll();
+
+	/* every process starts from these; workers report past them */
+	InterpreterHandler	*ih = exe.getInterpreterHandler();
+	base_tests = ih->getNumTestCases();
+	base_paths = ih->getNumPathsExplored();
+	base_errors = ih->getNumErrors();
+	base_stats.resize(theStatisticManager->getNumStatistics());
+	for (unsigned k = 0; k < base_stats.size(); k++)
+		base_stats[k] = theStatisticManager->getStatistic(k).getValue();
+
+	for (i = 1; i < numWorkers; i++) {
+		pid_t	pid;
+		int	fds[2];
+
+		if (pipe(fds) != 0) {
+			klee_warning(
+				"exe-workers: pipe failed (%s). "
+				"Running with %u workers.",
+				strerror(errno), i);
+			break;
+		}
+
+		pid = fork();
+		if (pid == -1) {
+			klee_warning(
+				"exe-workers: fork failed (%s). "
+				"Running with %u workers.",
+				strerror(errno), i);
+			close(fds[0]);
+			close(fds[1]);
+			break;
+		}
+
+		if (pid == 0) {
+			/* don't outlive the original process */
+			prctl(PR_SET_PDEATHSIG, SIGKILL);
+			for (auto &c : children)
+				close(c.report_fd);
+			children.clear();
+			close(fds[0]);
+			report_fd = fds[1];
+			enterWorker(i);
+			esm->partition([i, this] (unsigned rank)
+				{ return rank % numWorkers == i; });
+			return true;
+		}
+
+		close(fds[1]);
+		children.push_back(Child { pid, fds[0] });
+	}
+
+	/* forks may have failed; keep whatever no worker took */
+	enterWorker(0);
+	esm->partition([i, this] (unsigned rank)
+		{ return rank % numWorkers == 0 || rank % numWorkers >= i; });
+	return true;
+}
+
+void ExeWorkers::enterWorker(unsigned id)
+{
+	workerId = id;
+	if (id != 0)
+		StateSpill::resetForWorker();
+	exe.getInterpreterHandler()->setWorker(id, numWorkers);
+	if (id != 0 && exe.getStatsTracker() != NULL)
+		exe.getStatsTracker()->setWorker(id);
+}
+
+void ExeWorkers::waitWorkers(void)
+{
+	for (auto &c : children) {
+		int	status;
+
+		/* read first; the worker may block writing its report */
+		if (!mergeReport(c.report_fd))
+			klee_warning(
+				"exe-workers: no report from worker pid=%d; "
+				"its stats are missing from the summary",
+				c.pid);
+		close(c.report_fd);
+
+		if (waitpid(c.pid, &status, 0) != c.pid) {
+			klee_warning("exe-workers: lost worker pid=%d", c.pid);
+			continue;
+		}
+
+		if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+			continue;
+
+		klee_warning(
+			"exe-workers: worker pid=%d exited abnormally "
+			"(status=%d)", c.pid, status);
+	}
+
+	children.clear();
+}
+
+bool ExeWorkers::mergeReport(int fd)
+{
+	WorkerReport		wr;
+	std::vector<uint64_t>	deltas;
+
+	if (!xfer(fd, &wr, sizeof(wr), false))
+		return false;
+
+	if (wr.num_stats != base_stats.size())
+		return false;
+
+	deltas.resize(wr.num_stats);
+	if (!xfer(fd, deltas.data(), deltas.size()*sizeof(uint64_t), false))
+		return false;
+
+	for (unsigned k = 0; k < deltas.size(); k++)
+		theStatisticManager->incrementGlobalValue(
+			theStatisticManager->getStatistic(k), deltas[k]);
+
+	exe.getInterpreterHandler()->addWorkerCounts(
+		wr.tests, wr.paths, wr.errors);
+	return true;
+}
+
+void ExeWorkers::sendReport(void)
+{
+	InterpreterHandler	*ih = exe.getInterpreterHandler();
+	WorkerReport		wr;
+	std::vector<uint64_t>	deltas(base_stats.size());
+
+	wr.tests = ih->getNumTestCases() - base_tests;
+	wr.paths = ih->getNumPathsExplored() - base_paths;
+	wr.errors = ih->getNumErrors() - base_errors;
+	wr.num_stats = deltas.size();
+
+	for (unsigned k = 0; k < deltas.size(); k++) {
+		Statistic	&s(theStatisticManager->getStatistic(k));
+		uint64_t	v = s.getValue();
+
+		/* coverage is a per-process view, not a count; the
+		 * worker's run.istats.N has it */
+		if (isCoverageStat(s))
+			continue;
+
+		deltas[k] = v - base_stats[k];
+	}
+
+	if (	!xfer(report_fd, &wr, sizeof(wr), true) ||
+		!xfer(report_fd, deltas.data(),
+			deltas.size()*sizeof(uint64_t), true))
+	{
+		klee_warning("exe-workers: could not send worker report");
+	}
+
+	close(report_fd);
+	report_fd = -1;
+}
+
+void ExeWorkers::exitWorker(void)
+{
+	assert (isWorker());
+
+	if (exe.getStatsTracker() != NULL) {
+		exe.getStatsTracker()->done();
+		exe.getStatsTracker()->flushFiles();
+	}
+
+	sendReport();
+
+	fflush(NULL);
+	_exit(0);
+}
@@ -0,0 +1,79 @@
+#ifndef KLEE_EXEWORKERS_H
+#define KLEE_EXEWORKERS_H
+
+#include <sys/types.h>
+#include <stdint.h>
+#include <vector>
+
+namespace klee
+{
+class Executor;
+
+/* Splits exploration across forked worker processes.
+ *
+ * Once the executor has enough running states, the process forks
+ * into N workers. Every worker sees the same state set (fork() copies
+ * the address space, so state pointers match), keeps only the states
+ * whose rank in the set matches its worker id, and carries on with
+ * the usual runLoop. Nothing mutable is shared after the split, so
+ * the expression tables, stats, and ptree need no locking.
+ *
+ * Each worker sends its test, path, and statistic counts since the
+ * split back over a pipe when it exits; the original process adds them
+ * in before writing the summary and its final run.stats line. Coverage
+ * is not summed; each worker's run.istats.N holds its own. */
+class ExeWorkers
+{
+public:
+	ExeWorkers(Executor& _exe, unsigned _numWorkers);
+	virtual ~ExeWorkers() = default;
+
+	/* forks off workers if the state set is large enough;
+	 * returns true if the state set was partitioned */
+	bool trySplit(void);
+
+	/* called by the original process once its runLoop is done */
+	void waitWorkers(void);
+
+	/* called by a worker once its states are dumped; writes the
+	 * worker's own stats and exits without running the tool's exit
+	 * path, which would redo the parent's summary */
+	void exitWorker(void) __attribute__((noreturn));
+
+	/* -use-forked-stp's shared memory segment is process-global */
+	static void checkOptions(void);
+
+	bool isSplit(void) const { return split; }
+	bool isWorker(void) const { return workerId != 0; }
+	unsigned getWorkerId(void) const { return workerId; }
+	unsigned getNumWorkers(void) const { return numWorkers; }
+
+	static ExeWorkers* create(Executor& exe);
+private:
+	void enterWorker(unsigned id);
+	void sendReport(void);
+	bool mergeReport(int fd);
+
+	struct Child
+	{
+		pid_t	pid;
+		int	report_fd;
+	};
+
+	Executor		&exe;
+	unsigned		numWorkers;
+	unsigned		minStates;
+	unsigned		workerId;
+	bool			split;
+	std::vector<Child>	children;
+
+	/* counts at the split; a worker reports what it added past them */
+	int			report_fd;
+	unsigned		base_tests;
+	unsigned		base_paths;
+	unsigned		base_errors;
+	std::vector<uint64_t>	base_stats;
+};
+}
+
+#endif
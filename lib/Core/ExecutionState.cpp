@@ -28,6 +28,7 @@
 
 #include "PTree.h"
 #include "Memory.h"
+#include "StateSpill.h"
 
 #include <llvm/IR/Function.h>
 #include <llvm/Support/CommandLine.h>
@@ -130,6 +131,8 @@ ExecutionState::ExecutionState(void)
 
 ExecutionState::~ExecutionState()
 {
+	StateSpill::drop(*this);
+
 	while (!stack.empty())  {
 		StackFrame	&sf(stack.back());
 		if (sf.allocas) {
@@ -34,6 +34,7 @@
 #include "Executor.h"
 #include "Globals.h"
 #include "ExeStateManager.h"
+#include "ExeWorkers.h"
 
 #include "../Searcher/UserSearcher.h"
 
@@ -46,6 +47,9 @@
 #include "StateSolver.h"
 #include "MMU.h"
 #include "BranchPredictors.h"
+#include "ConstraintJIT.h"
+#include "SlabAlloc.h"
+#include "StateSpill.h"
 #include "StatsTracker.h"
 #include "SpecialFunctionHandler.h"
 #include "../Expr/RuleBuilder.h"
@@ -119,6 +123,13 @@ namespace {
   cl::opt<bool>
   UseIVC("use-ivc", cl::desc("Implied Value Concretization"), cl::init(true));
 
+  cl::opt<bool>
+  AsyncSolver(
+  	"async-solver",
+	cl::desc("Park states on symbolic branches while the pipe solver "
+		"pool answers; other states run meanwhile."),
+	cl::init(false));
+
   cl::opt<bool>
   UseRuleBuilder(
   	"use-rule-builder", cl::desc("Machine-learned peephole expr builder"));
@@ -144,11 +155,16 @@ Executor::Executor(InterpreterHandler *ih)
 , initialStateCopy(0)
 , ivcEnabled(UseIVC)
 {
+	ExeWorkers::checkOptions();
+
 	/* rule builder should be installed before equiv checker, otherwise
 	 * we waste time searching the equivdb for rules we already have! */
 	if (UseRuleBuilder)
 		Expr::setBuilder(RuleBuilder::create(Expr::getBuilder()));
 
+	if (ConstraintJIT::isEnabled())
+		TapeJIT::set(ConstraintJIT::create());
+
 	solver = createSolverChain(
 		MaxInstructionTime
 			? std::min(MaxSTPTime, (double)MaxInstructionTime)
@@ -157,7 +173,11 @@ Executor::Executor(InterpreterHandler *ih)
 		interpreterHandler->getOutputFilename("stp-queries.pc"));
 	fastSolver = (YieldUncached) ? createFastSolver() : NULL;
 
+	/* before the first object state is allocated */
+	SlabAlloc::setup();
 	ObjectState::setupZeroObjs();
+	StateSpill::setup(
+		interpreterHandler->getOutputFilename("klee-spill.XXXXXX"));
 
 	memory.reset(MemoryManager::create());
 	stateManager = new ExeStateManager();
@@ -188,6 +208,7 @@ Executor::~Executor()
 	delete replay;
 
 	timers.clear();
+	workers = nullptr;
 	delete stateManager;
 	delete mmu;
 
@@ -196,6 +217,8 @@ Executor::~Executor()
 
 	ExeStateBuilder::replaceBuilder(NULL);
 	delete forking;
+
+	delete TapeJIT::set(NULL);
 }
 
 void Executor::replaceStateImmForked(ExecutionState* os, ExecutionState* ns)
@@ -2025,8 +2048,18 @@ void Executor::run(ExecutionState &initState)
 	 * until after replay. Hm. */
 	stateManager->setupSearcher(UserSearcher::constructUserSearcher(*this));
 
+	workers.reset(ExeWorkers::create(*this));
+
 	runLoop();
 
+	/* halted with queries out; those states get dumped like the rest */
+	if (stateManager->numParkedStates()) {
+		solver->cancelPrefetched();
+		stateManager->unparkAll();
+	}
+
+	if (workers) workers->waitWorkers();
+
 	stateManager->teardownUserSearcher();
 
 eraseStates:
@@ -2065,10 +2098,67 @@ done:
 	currentState = NULL;
 	delete mmu;
 	mmu = NULL;
+
+	/* the original process writes the only summary */
+	if (workers && workers->isWorker())
+		workers->exitWorker();
+}
+
+/* A state about to branch on a symbolic condition sends the branch's
+ * validity query to the solver pool and sits out until the answer is
+ * in. Other states run in the meantime; when the parked state is picked
+ * again, the fork takes the answer instead of blocking on the solver. */
+bool Executor::parkState(ExecutionState& st)
+{
+	KInstruction	*ki = st.pc;
+	Expr::Hash	key;
+
+	if (ki->getInst()->getOpcode() != Instruction::Br)
+		return false;
+
+	if (cast<BranchInst>(ki->getInst())->isUnconditional())
+		return false;
+
+	/* nothing else to run; just ask */
+	if (stateManager->numRunningStates() < 2)
+		return false;
+
+	ref<Expr>	cond(eval(ki, 0, st));
+	if (cond->getKind() == Expr::Constant)
+		return false;
+
+	if (!solver->prefetch(st, cond, key))
+		return false;
+
+	stateManager->park(&st, key);
+	return true;
+}
+
+void Executor::wakeParked(void)
+{
+	std::vector<Expr::Hash>	keys;
+	bool			block;
+
+	/* only parked states left => wait for an answer */
+	block = stateManager->numRunningStates() == 0 &&
+		stateManager->numYieldedStates() == 0;
+	solver->collectPrefetched(keys, block);
+
+	for (auto key : keys)
+		stateManager->unpark(key);
+
+	/* nothing out on the pool; don't strand anyone */
+	if (block && keys.empty()) {
+		solver->cancelPrefetched();
+		stateManager->unparkAll();
+	}
 }
 
 void Executor::step(void)
 {
+	if (stateManager->numParkedStates())
+		wakeParked();
+
 	currentState = stateManager->selectState();
 	assert (currentState != NULL &&
 		"State man not empty, but selectState is?");
@@ -2085,6 +2175,11 @@ void Executor::step(void)
 		currentState = newSt;
 	}
 
+	if (solver->hasAsync() && parkState(*currentState)) {
+		currentState = NULL;
+		return;
+	}
+
 	stepStateInst(*currentState);
 	commitQueue(currentState);
 }
@@ -2095,7 +2190,12 @@ void Executor::commitQueue(ExecutionState *current)
 }
 
 void Executor::runLoop(void)
-{ while (!stateManager->empty() && !haltExecution) step(); }
+{
+	while (!stateManager->empty() && !haltExecution) {
+		step();
+		if (workers) workers->trySplit();
+	}
+}
 
 std::string Executor::getAddressInfo(
 	ExecutionState &state,
@@ -2613,6 +2713,8 @@ StateSolver* Executor::createSolverChain(
 	s = Solver::createChainWithTimedSolver(qPath, logPath, timedSolver);
 	ts = new StateSolver(s, timedSolver);
 	ts->setTimeout(timeout);
+	if (AsyncSolver && !ts->setupAsync())
+		klee_warning("-async-solver needs -pipe-solver; ignoring");
 	return ts;
 }
 
@@ -58,6 +58,7 @@ class Terminator;
 class ConstantExpr;
 class ExecutionState;
 class ExeStateManager;
+class ExeWorkers;
 class ExternalDispatcher;
 class Expr;
 class Forks;
@@ -233,6 +234,8 @@ protected:
 	virtual void run(ExecutionState &initialState);
 	virtual void runLoop();
 	void step(void);
+	bool parkState(ExecutionState& st);
+	void wakeParked(void);
 
 	/* returns false if unable to start finalization */
 	virtual bool startFini(ExecutionState& state);
@@ -274,6 +277,7 @@ protected:
 	TreeStreamWriter	*symPathWriter;
 	StateSolver		*solver, *fastSolver;
 	ExeStateManager		*stateManager;
+	std::unique_ptr<ExeWorkers>	workers;
 	Forks			*forking;
 	ForkHistory		forkHistory;
 	ExecutionState		*currentState;
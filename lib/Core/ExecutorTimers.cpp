@@ -108,6 +108,8 @@ public:
 		ExprAlloc	*ea;
 		ea = Expr::getAllocator();
 		ea->garbageCollect();
+		/* after the first sweep, so minor ones never come first */
+		ea->armGC();
 		Array::garbageCollect();
 		ObjectState::garbageCollect();
 	}
@@ -132,6 +134,106 @@ public:
 private:
 };
 
+#include <unordered_map>
+#include <typeindex>
+#include "klee/ExecutionState.h"
+#include "Memory.h"
+cl::opt<double>
+UseObjDedupTimer("objdedup-timer",
+        cl::desc("Merge identical concrete objects every n seconds (0=off)"),
+        cl::init(0));
+/* Hash every sharable concrete object across all states and point
+ * duplicates at one unowned copy. Nothing owns the survivor, so the
+ * usual copy-on-write splits it again on the next write. */
+class ObjDedupTimer : public Executor::Timer
+{
+public:
+	ObjDedupTimer(Executor &_exe) : exe(_exe), total_bytes(0) {}
+
+	void run() override {
+		ExeStateManager	*sm(exe.getStateManager());
+		uint64_t	bytes = 0;
+		unsigned	merged = 0;
+
+		canon.clear();
+		foreach (it, sm->begin(), sm->end())
+			dedupState(**it, merged, bytes);
+		foreach (it, sm->beginYielded(), sm->endYielded())
+			dedupState(**it, merged, bytes);
+		canon.clear();
+
+		total_bytes += bytes;
+		std::cerr << "[ObjDedup] merged " << merged
+			<< " objects; reclaimed " << bytes << " bytes ("
+			<< total_bytes << " total)\n";
+	}
+private:
+	typedef std::pair<const MemoryObject*, const ObjectState*> rebind_ty;
+	/* merging across object types would drop subclass state */
+	typedef std::pair<std::type_index, uint64_t> canon_key;
+	struct canon_hash {
+		size_t operator()(const canon_key& k) const
+		{ return k.first.hash_code() ^ k.second; }
+	};
+
+	const ObjectState* findCanon(const ObjectState* os)
+	{
+		canon_key	key(typeid(*os), os->hashConcrete());
+
+		std::vector<const ObjectState*>	&v(canon[key]);
+		foreach (it, v.begin(), v.end())
+			if (*it == os || ((*it)->getSize() == os->getSize()
+					&& (*it)->cmpConcrete(*os) == 0))
+				return *it;
+
+		v.push_back(os);
+		return os;
+	}
+
+	void dedupState(ExecutionState& es, unsigned& merged, uint64_t& bytes)
+	{
+		AddressSpace		&as(es.addressSpace);
+		std::vector<rebind_ty>	rebinds;
+
+		/* the map can't be changed while it's walked */
+		foreach (it, as.begin(), as.end()) {
+			const MemoryObject	*mo((*it).first);
+			const ObjectState	*os((*it).second);
+			const ObjectState	*c;
+
+			if (!os->isSharable())
+				continue;
+
+			c = findCanon(os);
+			if (c == os) {
+				/* survivor; its owner must copy before writing */
+				if (os->hasOwner())
+					rebinds.push_back(rebind_ty(mo, os));
+				continue;
+			}
+
+			/* last reference goes; only unshared lines are freed */
+			if (os->getRefCount() == 1)
+				bytes += os->getPrivateBytes();
+			rebinds.push_back(rebind_ty(mo, c));
+			merged++;
+		}
+
+		foreach (it, rebinds.begin(), rebinds.end()) {
+			ObjectState	*os(const_cast<ObjectState*>(it->second));
+			os->setOwner(0);
+			as.rebindShared(it->first, os);
+		}
+	}
+
+	Executor	&exe;
+	uint64_t	total_bytes;
+	std::unordered_map<
+		canon_key,
+		std::vector<const ObjectState*>,
+		canon_hash>	canon;
+};
+
 class StatTimer : public Executor::Timer
 {
 public:
@@ -198,6 +300,25 @@ protected:
 		' ' << UpdateList::getCount(); }
 };
 
+#include "SlabAlloc.h"
+cl::opt<unsigned>
+DumpSlabStats("dump-slabstats",
+        cl::desc("Dump object state slab stats every n seconds (0=off)"),
+        cl::init(0));
+class SlabStatTimer : public StatTimer
+{
+public:
+	SlabStatTimer(Executor &_exe) : StatTimer(_exe, "slab.txt") {}
+protected:
+	void print(void) { *os
+		<< SlabAlloc::getNumSlabs() << ' '
+		<< SlabAlloc::getBlocksInUse() << ' '
+		<< SlabAlloc::getBytesInUse() << ' '
+		<< SlabAlloc::getBytesFree() << ' '
+		<< ObjectState::getNumLineCopies() << ' '
+		<< SlabAlloc::getNumSlabsFreed(); }
+};
+
 class StateStatTimer : public StatTimer
 {
 public:
@@ -232,6 +353,7 @@ extern unsigned g_cachingsolver_sz;
 extern unsigned g_cexcache_sz;
 
 #include "../Solver/CachingSolver.h"
+#include "TLB.h"
 cl::opt<unsigned>
 DumpCacheStats("dump-cachestats",
         cl::desc("Dump cache stats every n seconds (0=off)"),
@@ -245,7 +367,9 @@ protected:
 		<< g_cachingsolver_sz << ' '
 		<< g_cexcache_sz << ' '
 		<< CachingSolver::getHits() << ' '
-		<< CachingSolver::getMisses(); }
+		<< CachingSolver::getMisses() << ' '
+		<< TLB::getHits() << ' '
+		<< TLB::getMisses(); }
 };
 
 
@@ -836,6 +960,7 @@ void Executor::initTimers(void)
 	EXE_ADD_TIMER(HaltNoProgressTimer, MaxTimeNoProgress);
 	EXE_ADD_TIMER(RuleBuilderStatTimer, DumpRuleBuilderStats)
 	EXE_ADD_TIMER(MemStatTimer, DumpMemStats)
+	EXE_ADD_TIMER(SlabStatTimer, DumpSlabStats)
 	EXE_ADD_TIMER(StateStatTimer, DumpStateStats)
 	EXE_ADD_TIMER(ExprStatTimer, DumpExprStats)
 	EXE_ADD_TIMER(CacheStatTimer, DumpCacheStats)
@@ -845,6 +970,7 @@ void Executor::initTimers(void)
 	EXE_ADD_TIMER(StackStatTimer, DumpStackStats)
 	EXE_ADD_TIMER(ExprGCTimer, UseGCTimer)
 	EXE_ADD_TIMER(ExprObjScanTimer, UseObjScanTimer)
+	EXE_ADD_TIMER(ObjDedupTimer, UseObjDedupTimer)
 	EXE_ADD_TIMER(StateInstStatTimer, DumpStateInstStats)
 	EXE_ADD_TIMER(ForkCondTimer, DumpForkCondGraph)
 	EXE_ADD_TIMER(StatesTimer, DumpStatesTimer)
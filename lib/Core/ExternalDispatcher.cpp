@@ -185,6 +185,29 @@ void ExternalDispatcher::buildExeEngine(void)
 	exeEngine->finalizeObject();
 }
 
+void* ExternalDispatcher::compileModule(
+	std::unique_ptr<llvm::Module> m,
+	const std::string& fname)
+{
+	std::string	error;
+	ExecutionEngine	*ee;
+
+	ee = EngineBuilder(std::move(m))
+		.setErrorStr(&error)
+		.setEngineKind(EngineKind::JIT)
+		.setMCJITMemoryManager(smm->createProxy())
+		.create();
+	if (ee == NULL) {
+		std::cerr << "[ExternalDispatcher] unable to jit module: "
+			<< error << '\n';
+		return NULL;
+	}
+
+	ee->finalizeObject();
+	moduleEngines.push_back(std::unique_ptr<ExecutionEngine>(ee));
+	return (void*)ee->getFunctionAddress(fname);
+}
+
 ExternalDispatcher::ExternalDispatcher()
 	: smm(std::make_unique<DispatcherMem>())
 {
@@ -15,6 +15,7 @@
 #include <string>
 #include <stdint.h>
 #include <memory>
+#include <vector>
 
 namespace llvm {
 	class ExecutionEngine;
@@ -55,6 +56,8 @@ private:
  	void buildExeEngine(void);
 
 	std::unique_ptr<DispatcherMem>	smm;
+	/* engines for modules handed over by compileModule */
+	std::vector<std::unique_ptr<llvm::ExecutionEngine> >	moduleEngines;
 public:
 	ExternalDispatcher();
 	~ExternalDispatcher();
@@ -69,6 +72,11 @@ public:
 				uint64_t *args);
 
 	void* resolveSymbol(const std::string& name) const;
+
+	/* JIT a self-contained module; returns the address of 'fname' */
+	void* compileModule(
+		std::unique_ptr<llvm::Module> m,
+		const std::string& fname);
 };
 }
 
@@ -2,6 +2,7 @@
 #include "Forks.h"
 #include "klee/Internal/ADT/KTest.h"
 #include "klee/util/Assignment.h"
+#include "klee/util/TapeJIT.h"
 #include "KTestStateSolver.h"
 
 using namespace klee;
@@ -35,7 +36,7 @@ bool KTestStateSolver::evaluate(
 	Solver::Validity &result)
 {
 	if (updateArrays(es) == false) goto done;
-	e = kt_assignment->evaluate(e);
+	e = evalKTest(e);
 done:	return base->evaluate(es, e, result);
 }
 
@@ -44,7 +45,7 @@ bool KTestStateSolver::mayBeTrue(
 {
 	ref<Expr>	expr;
 	if (updateArrays(es) == false) goto done;
-	expr = kt_assignment->evaluate(e);
+	expr = evalKTest(e);
 	if (expr->isTrue()) {
 		result = true;
 		return true;
@@ -57,7 +58,7 @@ bool KTestStateSolver::mayBeFalse(
 {
 	ref<Expr>	expr;
 	if (updateArrays(es) == false) goto done;
-	expr = kt_assignment->evaluate(e);
+	expr = evalKTest(e);
 	if (expr->isFalse()) {
 		result = true;
 		return true;
@@ -70,7 +71,7 @@ bool KTestStateSolver::mustBeTrue(
 {
 	ref<Expr>	expr;
 	if (updateArrays(es) == false) goto done;
-	expr = kt_assignment->evaluate(e);
+	expr = evalKTest(e);
 	if (expr->isFalse()) {
 		result = false;
 		return true;
@@ -83,7 +84,7 @@ bool KTestStateSolver::mustBeFalse(
 {
 	ref<Expr>	expr;
 	if (updateArrays(es) == false) goto done;
-	expr = kt_assignment->evaluate(e);
+	expr = evalKTest(e);
 	if (expr->isTrue()) {
 		result = false;
 		return true;
@@ -118,6 +119,23 @@ ref<Expr> KTestStateSolver::toUnique(const ExecutionState &es, const ref<Expr> &
 done:	return base->toUnique(es, e);
 }
 
+/* conditions replayed from a ktest repeat; run hot ones as native code */
+ref<Expr> KTestStateSolver::evalKTest(const ref<Expr>& e)
+{
+	TapeJIT			*jit = TapeJIT::get();
+	const TapeJIT::Checker	*c;
+	int			r;
+
+	if (jit == NULL || e->getWidth() != Expr::Bool || isa<ConstantExpr>(e))
+		return kt_assignment->evaluate(e);
+
+	c = jit->lookup(std::vector<ref<Expr> >(1, e));
+	if (c != NULL && (r = TapeJIT::run(c, *kt_assignment)) >= 0)
+		return ConstantExpr::alloc(r, Expr::Bool);
+
+	return kt_assignment->evaluate(e);
+}
+
 bool KTestStateSolver::updateArrays(const ExecutionState& es)
 {
 	auto		it(es.getSymbolics().begin());
@@ -48,6 +48,7 @@ public:
 			   const ref<Expr> &e) override;
 private:
 	bool updateArrays(const ExecutionState& state);
+	ref<Expr> evalKTest(const ref<Expr>& e);
 
 	StateSolver	*base;
 
@@ -62,6 +62,10 @@ KleeHandler::KleeHandler(const CmdArgs* in_args)
 : m_testIndex(0)
 , m_pathsExplored(0)
 , m_errorsFound(0)
+, m_workerId(0)
+, m_workerCount(1)
+, m_workerBase(0)
+, m_workerTests(0)
 , cmdargs(in_args)
 , m_interpreter(0)
 , tms_valid(false)
@@ -375,7 +379,7 @@ unsigned KleeHandler::processTestCase(
 	if (!success)
 		klee_warning("unable to get symbolic solution, losing test");
 
-	id = ++m_testIndex;
+	id = nextTestId();
 
 	if (success) {
 		if (!state.covset.isCommitted())
@@ -459,6 +463,35 @@ unsigned KleeHandler::processTestCase(
 	return id;
 }
 
+void KleeHandler::setWorker(unsigned id, unsigned count)
+{
+	m_workerId = id;
+	m_workerCount = count;
+	m_workerBase = m_testIndex;
+}
+
+void KleeHandler::addWorkerCounts(
+	unsigned tests, unsigned paths, unsigned errors)
+{
+	/* kept apart from m_testIndex so this process's ids don't move */
+	m_workerTests += tests;
+	m_pathsExplored += paths;
+	m_errorsFound += errors;
+}
+
+/* workers share the output directory, so each worker takes every
+ * count'th id after the tests written before the split */
+unsigned KleeHandler::nextTestId(void)
+{
+	unsigned	n = ++m_testIndex;
+
+	if (m_workerCount <= 1 || n <= m_workerBase)
+		return n;
+
+	n -= m_workerBase + 1;
+	return m_workerBase + n*m_workerCount + m_workerId + 1;
+}
+
 void KleeHandler::writeMem(const ExecutionState& state, unsigned id)
 {
 	char	dname[PATH_MAX];
@@ -470,6 +503,7 @@ void KleeHandler::writeMem(const ExecutionState& state, unsigned id)
 		char			fname[PATH_MAX];
 		const MemoryObject	*mo(it->first);
 		const ObjectState	*os(state.addressSpace.findObject(mo));
+		std::vector<uint8_t>	buf;
 		void			*base;
 		FILE			*f;
 
@@ -482,8 +516,10 @@ void KleeHandler::writeMem(const ExecutionState& state, unsigned id)
 		if (os->getCopyDepth() == 0) continue;
 
 		sprintf(fname, "%s/%p.dat", dname, base);
+		buf.resize(mo->size);
+		os->readConcrete(buf.data(), mo->size);
 		f = fopen(fname, "wb");
-		fwrite(os->getConcreteBuf(), mo->size, 1, f);
+		fwrite(buf.data(), mo->size, 1, f);
 		fclose(f);
 
 		sprintf(fname, "%s/%p.mask", dname, base);
@@ -694,6 +730,8 @@ void KleeHandler::printStats(PrefixWriter& info)
 	GET_STAT(queryCacheMisses, "QueryCacheMisses")
 	GET_STAT(instructions, "Instructions")
 	GET_STAT(forks, "Forks")
+	GET_STAT(queriesAsync, "QueriesAsync")
+	GET_STAT(queriesAsyncHits, "QueriesAsyncHits")
 
 	info	<< "done: total queries = " << queries << " ("
 		<< "valid: " << queriesValid << ", "
@@ -708,6 +746,10 @@ void KleeHandler::printStats(PrefixWriter& info)
 	info	<< "done: query cache hits = " << queryCacheHits << ", "
 		<< "query cache misses = " << queryCacheMisses << "\n";
 
+	if (queriesAsync)
+		info	<< "done: async queries = " << queriesAsync << " ("
+			<< "answers used: " << queriesAsyncHits << ")\n";
+
 	info << "done: total instructions = " << instructions << "\n";
 	info << "done: explored paths = " << 1 + forks << "\n";
 	info << "done: completed paths = " << getNumPathsExplored() << "\n";
@@ -314,7 +314,7 @@ KleeMMU::MemOpRes KleeMMU::memOpResolveConst(
 			/* no feasible objects */
 			return ret;
 		}
-		tlb.put(state, ret.op);
+		tlb.put(state, addr, ret.op);
 
 		in_bounds = ret.op.first->isInBounds(addr, bytes);
 		if (in_bounds == false) {
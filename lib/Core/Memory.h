@@ -11,6 +11,8 @@
 #define KLEE_MEMORY_H
 
 #include "Context.h"
+#include "CowSegArray.h"
+#include "SymByteMap.h"
 
 #include "klee/Expr.h"
 
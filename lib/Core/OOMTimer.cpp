@@ -41,7 +41,8 @@ void OOMTimer::handleMemoryPID(void)
 	if (states_to_gen >= 0)
 		return;
 
-	exe.getStateManager()->compactStates(-states_to_gen);
+	exe.getStateManager()->compactStates(
+		-states_to_gen, exe.getCurrentState());
 }
 
 // guess at how many to kill
@@ -103,7 +104,8 @@ void OOMTimer::run(void)
 		exe.getNumStates() > 1)
 	{
 		std::cerr << "[Exe] Replay inhibited forks.. COMPACTING!!\n";
-		exe.getStateManager()->compactPressureStates(MaxMemory);
+		exe.getStateManager()->compactPressureStates(
+			MaxMemory, exe.getCurrentState());
 		return;
 	}
 
@@ -46,13 +46,12 @@ ObjectState::ObjectState(unsigned _size)
 , copyOnWriteOwner(0)
 , refCount(0)
 , copyDepth(0)
-, concreteStore(std::make_unique<uint8_t[]>(_size))
+, concreteStore(_size)
 , updates(0, 0)
 , readOnly(false)
 , size(_size)
 {
 	assert (size > 0);
-	memset(concreteStore.get(), 0, size);
 	ADD_TO_LIST;
 }
 
@@ -61,13 +60,12 @@ ObjectState::ObjectState(unsigned _size, const ref<Array>& array)
 , copyOnWriteOwner(0)
 , refCount(0)
 , copyDepth(0)
-, concreteStore(std::make_unique<uint8_t[]>(_size))
+, concreteStore(_size)
 , updates(array, 0)
 , readOnly(false)
 , size(_size)
 {
 	assert (size > 0);
-	memset(concreteStore.get(), 0, size);
 	makeSymbolic();
 	ADD_TO_LIST;
 }
@@ -77,7 +75,7 @@ ObjectState::ObjectState(const ObjectState &os)
 , copyOnWriteOwner(0)
 , refCount(0)
 , copyDepth(os.copyDepth+1)
-, concreteStore(std::make_unique<uint8_t[]>(os.size))
+, concreteStore(os.concreteStore)
 , concreteMask(os.concreteMask
 	? std::make_unique<BitArray>(*os.concreteMask, os.size)
 	: nullptr)
@@ -95,15 +93,11 @@ ObjectState::ObjectState(const ObjectState &os)
 	 * but it can't be done here. */
 	revertToConcrete();
 
-	if (concreteMask != NULL && os.knownSymbolics) {
-		knownSymbolics = std::make_unique<ref<Expr>[]>(size);
-		for (unsigned i=0; i<size; i++)
-			knownSymbolics[i] = os.knownSymbolics[i];
-	}
+	/* sparse maps are copied; dense lines are shared until written */
+	if (concreteMask != NULL && os.knownSymbolics)
+		knownSymbolics = std::make_unique<SymByteMap>(
+			*os.knownSymbolics);
 
-	memcpy(	concreteStore.get(),
-		os.concreteStore.get(),
-		size * sizeof(concreteStore[0]));
 	ADD_TO_LIST;
 }
 
@@ -216,16 +210,14 @@ void ObjectState::makeSymbolic(void)
 void ObjectState::initializeToZero()
 {
 	makeConcrete();
-	memset(concreteStore.get(), 0, size);
+	concreteStore.clear();
 }
 
 void ObjectState::initializeToRandom()
 {
 	makeConcrete();
-	for (unsigned i=0; i<size; i++) {
-		// randomly selected by 256 sided die
-		concreteStore[i] = 0xAB;
-	}
+	// randomly selected by 256 sided die
+	concreteStore.fill(0xAB);
 }
 
 /*
@@ -254,13 +246,13 @@ void ObjectState::flushRangeForRead(
 		if (isByteConcrete(offset)) {
 			updates.extend(
 				MK_CONST(offset, Expr::Int32),
-				MK_CONST(concreteStore[offset], Expr::Int8));
+				MK_CONST(concreteStore.get(offset), Expr::Int8));
 		} else {
 			assert(	isByteKnownSymbolic(offset) &&
 				"invalid bit set in flushMask");
 			updates.extend(
 				MK_CONST(offset, Expr::Int32),
-				knownSymbolics[offset]);
+				knownSymbolics->get(offset));
 		}
 		flushMask->unset(offset);
 	}
@@ -273,13 +265,13 @@ void ObjectState::flushWriteByte(unsigned offset)
 	if (isByteConcrete(offset)) {
 		updates.extend(
 			MK_CONST(offset, Expr::Int32),
-			MK_CONST(concreteStore[offset], Expr::Int8));
+			MK_CONST(concreteStore.get(offset), Expr::Int8));
 		markByteSymbolic(offset);
 	} else {
 		assert(	isByteKnownSymbolic(offset) &&
 			"invalid bit set in flushMask");
 		updates.extend(
-			MK_CONST(offset, Expr::Int32), knownSymbolics[offset]);
+			MK_CONST(offset, Expr::Int32), knownSymbolics->get(offset));
 		setKnownSymbolic(offset, 0);
 	}
 
@@ -317,7 +309,7 @@ bool ObjectState::isByteFlushed(unsigned offset) const
 { return flushMask && !flushMask->get(offset); }
 
 bool ObjectState::isByteKnownSymbolic(unsigned offset) const
-{  return knownSymbolics && knownSymbolics[offset].get(); }
+{  return knownSymbolics && knownSymbolics->get(offset).get(); }
 
 void ObjectState::markByteConcrete(unsigned offset)
 { if (concreteMask) concreteMask->set(offset); }
@@ -349,30 +341,33 @@ void ObjectState::setKnownSymbolic(
 	Expr *value /* can be null */)
 {
 	if (knownSymbolics != NULL) {
-		knownSymbolics[offset] = value;
+		if (value == NULL)
+			knownSymbolics->reset(offset);
+		else
+			knownSymbolics->set(offset, value);
 		return;
 	}
 
 	if (value == NULL)
 		return;
 
-	knownSymbolics = std::make_unique<ref<Expr>[]>(size);
-	knownSymbolics[offset] = value;
+	knownSymbolics = std::make_unique<SymByteMap>(size);
+	knownSymbolics->set(offset, value);
 }
 
 uint8_t ObjectState::read8c(unsigned offset) const
 {
 	assert (isByteConcrete(offset));
-	return concreteStore[offset];
+	return concreteStore.get(offset);
 }
 
 ref<Expr> ObjectState::read8(unsigned offset) const
 {
 	if (isByteConcrete(offset))
-		return MK_CONST(concreteStore[offset], Expr::Int8);
+		return MK_CONST(concreteStore.get(offset), Expr::Int8);
 
 	if (isByteKnownSymbolic(offset))
-		return knownSymbolics[offset];
+		return knownSymbolics->get(offset);
 
 
 	assert(isByteFlushed(offset) && "unflushed byte without cache value");
@@ -397,7 +392,7 @@ void ObjectState::write8(unsigned offset, uint8_t value)
 	assert(!readOnly  && "writing to read-only object!");
 	assert(!isZeroPage());
 
-	concreteStore[offset] = value;
+	concreteStore.getMut(offset) = value;
 	setKnownSymbolic(offset, 0);
 
 	markByteConcrete(offset);
@@ -473,27 +468,50 @@ ref<Expr> ObjectState::readSlow(ref<Expr>& offset, Expr::Width width) const
 ref<Expr> ObjectState::readConstantBytes(
 	unsigned offset, unsigned NumBytes) const
 {
+	uint8_t		buf[8];
 	uint64_t	ret = 0;
 
 	assert (offset + NumBytes <= size);
+	assert (NumBytes <= sizeof(buf));
 
-	/* confirm all bytes in read are concrete */
-	if (!isConcrete()) {
-		/* page isn't concrete; scan read bytes. */
-		for (unsigned i = 0; i < NumBytes; i++) {
-			if (!isByteConcrete(offset + i)) {
-				return NULL;
-			}
-		}
-	}
+	/* confirm all bytes in read are concrete, a mask word at a time */
+	if (!isConcrete() && !concreteMask->isRangeSet(offset, NumBytes))
+		return NULL;
+
+	concreteStore.copyOut(buf, offset, NumBytes);
+	for (unsigned i = 0; i < NumBytes; i++)
+		ret |= ((uint64_t)buf[i]) << (8*i);
+
+	return MK_CONST(ret, NumBytes*8);
+}
+
+/* bulk equivalent of write8(offset+i, (uint8_t)...) for each byte */
+void ObjectState::writeConstantBytes(
+	unsigned offset, uint64_t v, unsigned NumBytes)
+{
+	uint8_t		buf[8];
+
+	assert (!readOnly && "writing to read-only object!");
+	assert (!isZeroPage());
+	assert (offset + NumBytes <= size);
+	assert (NumBytes <= sizeof(buf));
 
-	assert (concreteStore);
 	for (unsigned i = 0; i < NumBytes; i++) {
-		ret <<= 8;
-		ret |= read8c(offset + ((NumBytes - 1) - i));
+		unsigned	idx;
+		idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
+		buf[idx] = v >> (8*i);
 	}
 
-	return MK_CONST(ret, NumBytes*8);
+	concreteStore.copyIn(offset, buf, NumBytes);
+
+	/* fully concrete objects carry none of these */
+	if (knownSymbolics)
+		for (unsigned i = 0; i < NumBytes; i++)
+			knownSymbolics->reset(offset + i);
+	if (concreteMask)
+		concreteMask->setRange(offset, NumBytes);
+	if (flushMask)
+		flushMask->setRange(offset, NumBytes);
 }
 
 ref<Expr> ObjectState::read(unsigned offset, Expr::Width width) const
@@ -506,10 +524,24 @@ ref<Expr> ObjectState::read(unsigned offset, Expr::Width width) const
 	unsigned	NumBytes = width / 8;
 
 	assert(width == NumBytes * 8 && "Non-byte aligned write size!");
-	if (NumBytes <= 8) {
+	if (hasReadHook()) {
+		/* every byte must go through read8 */
+	} else if (NumBytes <= 8) {
 		ref<Expr>	ret(readConstantBytes(offset, NumBytes));
 		if (!ret.isNull())
 			return ret;
+	} else if (	Context::get().isLittleEndian() &&
+			(isConcrete() ||
+			 concreteMask->isRangeSet(offset, NumBytes)))
+	{
+		/* wide vector loads; one copy instead of a concat chain */
+		std::vector<uint8_t>	buf(NumBytes);
+		std::vector<uint64_t>	words((NumBytes + 7) / 8, 0);
+
+		concreteStore.copyOut(buf.data(), offset, NumBytes);
+		for (unsigned i = 0; i < NumBytes; i++)
+			words[i / 8] |= ((uint64_t)buf[i]) << (8*(i % 8));
+		return ConstantExpr::alloc(llvm::APInt(width, words));
 	}
 
 
@@ -617,7 +649,7 @@ bool ObjectState::writeIVC(unsigned offset, const ref<ConstantExpr>& ce)
 		if (isByteKnownSymbolic(cur_off))
 			continue;
 
-		concreteStore[cur_off] = v8;
+		concreteStore.getMut(cur_off) = v8;
 		markByteConcrete(cur_off);
 		updated = true;
 	}
@@ -671,17 +703,16 @@ unsigned ObjectState::hash(void) const
 		hash_ret = getUpdates().hash();
 	}
 
-	if (concreteStore) {
-		for (unsigned int i = 0; i < size; i++) {
-			hash_ret += (i+1)*concreteStore[i];
-		}
+	for (unsigned int i = 0; i < size; i++) {
+		hash_ret += (i+1)*concreteStore.get(i);
 	}
 
 	if (knownSymbolics) {
 		for (unsigned i = 0; i < size; i++) {
-			if (knownSymbolics[i].isNull())
+			const ref<Expr>	&e(knownSymbolics->get(i));
+			if (e.isNull())
 				continue;
-			hash_ret += (i+1)*knownSymbolics[i]->hash();
+			hash_ret += (i+1)*e->hash();
 		}
 	}
 
@@ -713,31 +744,31 @@ void ObjectState::garbageCollect(void)
 }
 
 void ObjectState::writeConcrete(const uint8_t* addr, unsigned wr_sz)
-{ memcpy(concreteStore.get(), addr, wr_sz); }
+{ concreteStore.copyIn(0, addr, wr_sz); }
 
 void ObjectState::readConcrete(uint8_t* addr, unsigned rd_sz, unsigned off) const
-{ memcpy(addr, concreteStore.get() + off, rd_sz);  }
+{ concreteStore.copyOut(addr, off, rd_sz);  }
 
 
 int ObjectState::readConcreteSafe(
 	uint8_t* buf, unsigned rd_sz, unsigned off) const
 {
-	int	copy_total, copy_len;
+	int	copy_len;
 
 	copy_len = rd_sz;
 	if (rd_sz + off >= size) {
 		copy_len = size - off;
 	}
 
-	copy_total = 0;
-	for (int i = 0; i < copy_len; i++) {
-		if (!isByteConcrete(off+i))
-			break;
-		buf[i] = concreteStore[off+i];
-		copy_total++;
-	}
+	if (copy_len <= 0)
+		return 0;
 
-	return copy_total;
+	/* stop at the first symbolic byte */
+	if (!isConcrete())
+		copy_len = concreteMask->findFirstUnset(off, copy_len) - off;
+
+	concreteStore.copyOut(buf, off, copy_len);
+	return copy_len;
 }
 
 ObjectState* ObjectState::createDemandObj(unsigned sz)
@@ -751,6 +782,16 @@ ObjectState* ObjectState::createDemandObj(unsigned sz)
 	return ObjectState::create(sz);
 }
 
+ObjectState* ObjectState::createBacked(unsigned sz, const uint8_t* data)
+{
+	ObjectState	*os;
+
+	assert ((sz % COW_SEG_ELEMS) == 0 && "backing needs whole lines");
+	os = create(sz);
+	os->concreteStore.setBacking(data);
+	return os;
+}
+
 ObjectState* ObjectState::create(unsigned size)
 { return os_alloc->create(size); }
 
@@ -787,12 +828,12 @@ int ObjectState::cmpConcrete(
 	const uint8_t* addr, unsigned sz, unsigned off) const
 {
 	if (isConcrete())
-		return memcmp(addr, concreteStore.get() + off, sz);
+		return -concreteStore.cmp(addr, off, sz);
 
 	for (unsigned i = 0; i < sz; i++) {
 		int	diff;
 		if (isByteConcrete(i+off)) {
-			diff = concreteStore[i+off] - addr[i];
+			diff = concreteStore.get(i+off) - addr[i];
 			if (diff) return diff;
 		}
 	}
@@ -814,7 +855,17 @@ int ObjectState::cmpConcrete(const ObjectState& os) const
 	revertToConcrete(this);
 
 	if (!isConcrete() || !os.isConcrete()) return 0;
-	return memcmp(concreteStore.get(), os.concreteStore.get(), size);
+	return concreteStore.cmp(os.concreteStore, size);
+}
+
+uint64_t ObjectState::hashConcrete(void) const
+{
+	uint64_t	h = size;
+
+	for (unsigned s = 0; s < concreteStore.getNumSegs(); s++)
+		h = (h ^ concreteStore.hashLine(s)) * 0x100000001b3ULL;
+
+	return h;
 }
 
 void ObjectState::printDiff(const ObjectState& os) const
@@ -826,9 +877,9 @@ void ObjectState::printDiff(const ObjectState& os) const
 	}
 
 	for (unsigned i = 0 ; i < size; i++) {
-		if (concreteStore[i] != os.concreteStore[i])
+		if (concreteStore.get(i) != os.concreteStore.get(i))
 			std::cerr << "[ObjDiff] Diff @" << i << ": " <<
-				(void*)(long)concreteStore[i] << " vs " <<
-				(void*)(long)os.concreteStore[i] << '\n';
+				(void*)(long)concreteStore.get(i) << " vs " <<
+				(void*)(long)os.concreteStore.get(i) << '\n';
 	}
 }
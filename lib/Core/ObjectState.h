@@ -48,14 +48,16 @@ private:
 	unsigned		refCount;
 	unsigned		copyDepth;
 
-	std::unique_ptr<uint8_t[]> 	concreteStore;
+	/* split into lines shared with the object this was copied from */
+	CowSegArray<uint8_t>		concreteStore;
 	std::unique_ptr<BitArray>	concreteMask;
 
 	// mutable because may need flushed during read of const
 	// XXX cleanup name of flushMask (its backwards or something) ???
 	mutable std::unique_ptr<BitArray> flushMask;
 
-	std::unique_ptr<ref<Expr>[]>	knownSymbolics;
+	/* sparse until enough bytes are symbolic */
+	std::unique_ptr<SymByteMap>	knownSymbolics;
 
 	// mutable because we may need flush during read of const
 	mutable UpdateList	updates;
@@ -87,6 +89,11 @@ protected:
 public:
 	virtual ~ObjectState();
 
+	/* headers come out of the same slabs as their lines */
+	static void* operator new(size_t sz) { return SlabAlloc::alloc(sz); }
+	static void operator delete(void* p, size_t sz)
+	{ SlabAlloc::release(p, sz); }
+
 	static unsigned getNumObjStates(void) { return numObjStates; }
 
 	unsigned getSize(void) const { return size; }
@@ -112,6 +119,8 @@ public:
 	ref<Expr> read(unsigned offset, Expr::Width width) const;
 
 	virtual ref<Expr> read8(unsigned offset) const;
+	/* read8 does more than fetch the byte; no concrete fast paths */
+	virtual bool hasReadHook(void) const { return false; }
 
 	uint8_t	read8c(unsigned off) const;
 	void write8(unsigned offset, uint8_t value);
@@ -129,6 +138,9 @@ public:
 	static ObjectStateAlloc* getAlloc(void) { return os_alloc; }
 
 	static ObjectState* createDemandObj(unsigned sz);
+	/* concrete contents read from 'data' until written; data must
+	 * outlive the object and every copy of it */
+	static ObjectState* createBacked(unsigned sz, const uint8_t* data);
 	static void garbageCollect(void);
 
 	bool isZeroPage(void) const { return copyOnWriteOwner == COW_ZERO; }
@@ -140,9 +152,32 @@ public:
 	int readConcreteSafe(uint8_t* addr, unsigned rd_sz, unsigned off=0) const;
 	int cmpConcrete(const uint8_t* addr, unsigned sz, unsigned off=0) const;
 
-	const uint8_t* getConcreteBuf(void) const { return concreteStore.get(); }
+	static uint64_t getNumLineCopies(void)
+	{ return CowSegArray<uint8_t>::getNumClones(); }
 
 	int cmpConcrete(const ObjectState& os) const;
+	/* hash of the concrete bytes, from cached per-line hashes */
+	uint64_t hashConcrete(void) const;
+	/* bytes of lines that go away with this object */
+	uint64_t getPrivateBytes(void) const
+	{ return concreteStore.getPrivateBytes(); }
+
+	/* for StateSpill; private lines move into buf, which then backs
+	 * them. neither changes the concrete bytes */
+	uint64_t spillConcrete(uint8_t* buf)
+	{ return concreteStore.spillTo(buf); }
+	void unspillConcrete(void) { concreteStore.unback(); }
+	const uint8_t* getConcreteBacking(void) const
+	{ return concreteStore.getBacking(); }
+
+	/* may be swapped for another object with equal concrete bytes;
+	 * snapshot-backed objects hold little private memory, and hashing
+	 * them would fault in the whole snapshot */
+	virtual bool isSharable(void) const
+	{
+		return	!readOnly && !isZeroPage() && isConcrete() &&
+			!concreteStore.isBacked();
+	}
 
 	void setOwner(unsigned _new_cow) { copyOnWriteOwner = _new_cow; }
 	bool hasOwner(void) const { return copyOnWriteOwner != 0; }
@@ -172,6 +207,7 @@ protected:
 	virtual void write8(unsigned offset, ref<Expr>& value);
 	void write8(ref<Expr> offset, ref<Expr>& value);
 	ref<Expr> readConstantBytes(unsigned offset, unsigned NumBytes) const;
+	void writeConstantBytes(unsigned offset, uint64_t v, unsigned NumBytes);
 
 
 	void fastRangeCheckOffset(
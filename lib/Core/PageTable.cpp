@@ -0,0 +1,145 @@
+#include "Memory.h"
+#include "PageTable.h"
+
+using namespace klee;
+
+uint64_t PageTable::copy_c = 0;
+
+#define PT_DIGIT(pn, d)	\
+	(((pn) >> (PT_BITS*(PT_LEVELS - 1 - (d)))) & (PT_FANOUT - 1))
+#define PT_MAX_PN	(1ULL << (PT_BITS*PT_LEVELS))
+
+PageTable& PageTable::operator=(const PageTable& pt)
+{
+	if (pt.root) pt.root->refs++;
+	clear();
+	root = pt.root;
+	return *this;
+}
+
+bool PageTable::isIndexable(const MemoryObject* mo)
+{
+	uint64_t	pages;
+
+	if (mo->address & ((1 << PT_PAGE_BITS) - 1))
+		return false;
+	if (mo->size == 0 || (mo->size & ((1 << PT_PAGE_BITS) - 1)))
+		return false;
+
+	pages = mo->size >> PT_PAGE_BITS;
+	if (pages > PT_MAX_OBJ_PAGES)
+		return false;
+
+	return ((mo->address >> PT_PAGE_BITS) + pages) <= PT_MAX_PN;
+}
+
+bool PageTable::lookup(uint64_t addr, ent_ty& ent) const
+{
+	uint64_t	pn = addr >> PT_PAGE_BITS;
+	const Node	*n = root;
+
+	if (pn >= PT_MAX_PN)
+		return false;
+
+	for (unsigned d = 0; n != NULL && d < PT_LEVELS - 1; d++)
+		n = static_cast<const Dir*>(n)->kids[PT_DIGIT(pn, d)];
+
+	if (n == NULL)
+		return false;
+
+	ent = static_cast<const Leaf*>(n)->ents[PT_DIGIT(pn, PT_LEVELS-1)];
+	return ent.first != NULL;
+}
+
+PageTable::Node* PageTable::copyNode(const Node* n, unsigned depth)
+{
+	copy_c++;
+
+	if (depth == PT_LEVELS - 1)
+		return new Leaf(*static_cast<const Leaf*>(n));
+
+	Dir	*dir = new Dir(*static_cast<const Dir*>(n));
+	for (unsigned i = 0; i < PT_FANOUT; i++)
+		if (dir->kids[i])
+			dir->kids[i]->refs++;
+	dir->refs = 1;
+	return dir;
+}
+
+void PageTable::putNode(Node* n, unsigned depth)
+{
+	if (n == NULL || --n->refs != 0)
+		return;
+
+	if (depth == PT_LEVELS - 1) {
+		delete static_cast<Leaf*>(n);
+		return;
+	}
+
+	Dir	*dir = static_cast<Dir*>(n);
+	for (unsigned i = 0; i < PT_FANOUT; i++)
+		putNode(dir->kids[i], depth + 1);
+	delete dir;
+}
+
+PageTable::Node* PageTable::getMut(Node* &slot, unsigned depth)
+{
+	if (slot == NULL) {
+		if (depth == PT_LEVELS - 1)
+			slot = new Leaf();
+		else
+			slot = new Dir();
+	} else if (slot->refs > 1) {
+		Node	*n = copyNode(slot, depth);
+		slot->refs--;
+		slot = n;
+	}
+
+	slot->refs = 1;
+	return slot;
+}
+
+void PageTable::setPage(uint64_t pn, const ent_ty& ent)
+{
+	Node	*n = getMut(root, 0);
+
+	for (unsigned d = 0; d < PT_LEVELS - 1; d++)
+		n = getMut(static_cast<Dir*>(n)->kids[PT_DIGIT(pn, d)], d + 1);
+
+	static_cast<Leaf*>(n)->ents[PT_DIGIT(pn, PT_LEVELS-1)] = ent;
+}
+
+void PageTable::clearPage(uint64_t pn, const MemoryObject* mo)
+{
+	ent_ty	cur;
+
+	/* skip the copy when there's nothing to clear */
+	if (!lookup(pn << PT_PAGE_BITS, cur) || cur.first != mo)
+		return;
+
+	setPage(pn, ent_ty(NULL, NULL));
+}
+
+void PageTable::set(const MemoryObject* mo, const ObjectState* os)
+{
+	uint64_t	pn;
+
+	if (!isIndexable(mo))
+		return;
+
+	pn = mo->address >> PT_PAGE_BITS;
+	for (unsigned i = 0; i < (mo->size >> PT_PAGE_BITS); i++)
+		setPage(pn + i, ent_ty(mo, os));
+}
+
+void PageTable::remove(const MemoryObject* mo)
+{
+	uint64_t	pn;
+
+	if (!isIndexable(mo))
+		return;
+
+	pn = mo->address >> PT_PAGE_BITS;
+	for (unsigned i = 0; i < (mo->size >> PT_PAGE_BITS); i++)
+		clearPage(pn + i, mo);
+}
@@ -0,0 +1,82 @@
+#ifndef KLEE_PAGETABLE_H
+#define KLEE_PAGETABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <utility>
+
+namespace klee
+{
+class MemoryObject;
+class ObjectState;
+
+/* Radix page table mirroring the page-aligned part of an address space.
+ *
+ * Guest page numbers are split into PT_LEVELS digits of PT_BITS bits;
+ * only the low 48 address bits are indexed. Nodes are refcounted and
+ * copied on write, so copying the table shares everything and a later
+ * update only copies the nodes on its own path.
+ *
+ * Only objects that start on a page and span 1..PT_MAX_OBJ_PAGES whole
+ * pages get entries. Everything else stays map-only, so a failed lookup
+ * means "ask the map", not "unmapped". Entries are raw pointers; the
+ * owning address space keeps them alive through its map. */
+#define PT_PAGE_BITS		12
+#define PT_BITS			6
+#define PT_FANOUT		(1 << PT_BITS)
+#define PT_LEVELS		6
+#define PT_MAX_OBJ_PAGES	16
+
+class PageTable
+{
+public:
+	typedef std::pair<const MemoryObject*, const ObjectState*> ent_ty;
+
+	PageTable() : root(NULL) {}
+	PageTable(const PageTable& pt) : root(pt.root)
+	{ if (root) root->refs++; }
+	PageTable& operator=(const PageTable& pt);
+	virtual ~PageTable() { clear(); }
+
+	bool lookup(uint64_t addr, ent_ty& ent) const;
+	void set(const MemoryObject* mo, const ObjectState* os);
+	void remove(const MemoryObject* mo);
+	void clear(void) { putNode(root, 0); root = NULL; }
+
+	static bool isIndexable(const MemoryObject* mo);
+	static uint64_t getNumNodeCopies(void) { return copy_c; }
+private:
+	struct Node
+	{
+		Node(void) : refs(1) {}
+		unsigned	refs;
+	};
+
+	/* levels 0..PT_LEVELS-2 */
+	struct Dir : Node
+	{
+		Dir(void) : kids() {}
+		Node	*kids[PT_FANOUT];
+	};
+
+	/* level PT_LEVELS-1 */
+	struct Leaf : Node
+	{
+		Leaf(void) : ents() {}
+		ent_ty	ents[PT_FANOUT];
+	};
+
+	static Node* copyNode(const Node* n, unsigned depth);
+	static void putNode(Node* n, unsigned depth);
+	/* makes slot privately owned, allocating or copying as needed */
+	static Node* getMut(Node* &slot, unsigned depth);
+
+	void setPage(uint64_t pn, const ent_ty& ent);
+	void clearPage(uint64_t pn, const MemoryObject* mo);
+
+	Node	*root;
+	static uint64_t	copy_c;
+};
+}
+
+#endif
@@ -0,0 +1,103 @@
+#include <llvm/Support/CommandLine.h>
+#include <stdlib.h>
+#include "klee/Common.h"
+#include "SlabAlloc.h"
+
+using namespace klee;
+using namespace llvm;
+
+namespace {
+	cl::opt<bool> UseObjSlabs(
+		"objstate-slabs",
+		cl::desc("Pool object states and their lines in slabs."),
+		cl::init(true));
+}
+
+SlabAlloc::SizeClass SlabAlloc::classes[SLAB_NUM_CLASSES];
+uint64_t SlabAlloc::slab_c = 0;
+uint64_t SlabAlloc::slab_free_c = 0;
+int64_t SlabAlloc::early_c = 0;
+int SlabAlloc::enabled = -1;
+
+void SlabAlloc::setup(void)
+{
+	if (enabled >= 0)
+		return;
+
+	/* can't tell those blocks from pooled ones once the pool is on */
+	if (early_c != 0 && UseObjSlabs) {
+		klee_warning(
+			"%ld blocks allocated before slab setup; slabs off",
+			(long)early_c);
+		enabled = 0;
+		return;
+	}
+
+	enabled = (UseObjSlabs) ? 1 : 0;
+}
+
+void SlabAlloc::newSlab(unsigned cls)
+{
+	SizeClass	*sc = &classes[cls];
+	size_t		blk_sz = getBlockBytes(cls);
+	unsigned	n = (SLAB_BYTES - getHeaderBytes()) / blk_sz;
+	char		*base;
+	void		*p;
+	Slab		*s;
+
+	if (posix_memalign(&p, SLAB_BYTES, SLAB_BYTES) != 0)
+		throw std::bad_alloc();
+
+	s = static_cast<Slab*>(p);
+	s->free = NULL;
+	s->used = 0;
+	s->cls = cls;
+
+	/* thread the list front to back so allocations walk the slab */
+	base = static_cast<char*>(p) + getHeaderBytes();
+	for (unsigned i = n; i > 0; i--) {
+		FreeBlock	*b = reinterpret_cast<FreeBlock*>(
+			base + (i - 1)*blk_sz);
+		b->next = s->free;
+		s->free = b;
+	}
+
+	linkSlab(sc, s);
+	sc->total += n;
+	slab_c++;
+}
+
+void SlabAlloc::freeSlab(Slab* s)
+{
+	SizeClass	*sc = &classes[s->cls];
+
+	unlinkSlab(sc, s);
+	sc->total -= (SLAB_BYTES - getHeaderBytes()) / getBlockBytes(s->cls);
+	slab_c--;
+	slab_free_c++;
+	free(s);
+}
+
+uint64_t SlabAlloc::getBytesInUse(void)
+{
+	uint64_t	ret = 0;
+	for (unsigned i = 0; i < SLAB_NUM_CLASSES; i++)
+		ret += classes[i].used * getBlockBytes(i);
+	return ret;
+}
+
+uint64_t SlabAlloc::getBytesFree(void)
+{
+	uint64_t	ret = 0;
+	for (unsigned i = 0; i < SLAB_NUM_CLASSES; i++)
+		ret += (classes[i].total - classes[i].used)*getBlockBytes(i);
+	return ret;
+}
+
+uint64_t SlabAlloc::getBlocksInUse(void)
+{
+	uint64_t	ret = 0;
+	for (unsigned i = 0; i < SLAB_NUM_CLASSES; i++)
+		ret += classes[i].used;
+	return ret;
+}
@@ -0,0 +1,153 @@
+#ifndef KLEE_SLABALLOC_H
+#define KLEE_SLABALLOC_H
+
+#include <new>
+#include <stdint.h>
+#include <stddef.h>
+
+namespace klee
+{
+/* Size-class slab allocator for object state headers, COW lines, and
+ * line tables. Requests up to SLAB_MAX_BLOCK bytes are rounded up to a
+ * multiple of SLAB_GRAIN and carved out of SLAB_BYTES slabs. Slabs are
+ * aligned to their size, so a block finds its slab by masking. Each slab
+ * keeps its own free list; once every block of a slab is free, the slab
+ * goes back to the system, unless it is the last one of its class with
+ * room left. Fork-heavy runs recycle the same few sizes constantly, so
+ * this mostly turns malloc/free into a list push/pop.
+ *
+ * The pool stays off until setup(), which the executor calls after the
+ * command line is parsed, so -objstate-slabs is honored and a block is
+ * always released the same way it was allocated. */
+#define SLAB_BYTES		(64*1024)
+#define SLAB_GRAIN		16
+#define SLAB_MAX_BLOCK		1024
+#define SLAB_NUM_CLASSES	(SLAB_MAX_BLOCK / SLAB_GRAIN)
+
+class SlabAlloc
+{
+public:
+	static void* alloc(size_t sz)
+	{
+		SizeClass	*sc;
+		FreeBlock	*b;
+		Slab		*s;
+
+		if (sz > SLAB_MAX_BLOCK || enabled <= 0) {
+			if (enabled < 0) early_c++;
+			return ::operator new(sz);
+		}
+
+		sc = &classes[getClass(sz)];
+		if (sc->partial == NULL)
+			newSlab(getClass(sz));
+
+		s = sc->partial;
+		b = s->free;
+		s->free = b->next;
+		s->used++;
+		sc->used++;
+
+		/* full slabs are off the list until a block comes back */
+		if (s->free == NULL)
+			unlinkSlab(sc, s);
+
+		return b;
+	}
+
+	static void release(void* p, size_t sz)
+	{
+		SizeClass	*sc;
+		FreeBlock	*b;
+		Slab		*s;
+
+		if (p == NULL)
+			return;
+
+		if (sz > SLAB_MAX_BLOCK || enabled <= 0) {
+			if (enabled < 0) early_c--;
+			::operator delete(p);
+			return;
+		}
+
+		s = getSlab(p);
+		sc = &classes[s->cls];
+		if (s->free == NULL)
+			linkSlab(sc, s);
+
+		b = static_cast<FreeBlock*>(p);
+		b->next = s->free;
+		s->free = b;
+		s->used--;
+		sc->used--;
+
+		if (s->used == 0 && (sc->partial != s || s->next != NULL))
+			freeSlab(s);
+	}
+
+	/* latch -objstate-slabs; call once options are parsed */
+	static void setup(void);
+	static bool isEnabled(void) { return enabled > 0; }
+
+	/* slabs currently held */
+	static uint64_t getNumSlabs(void) { return slab_c; }
+	static uint64_t getNumSlabsFreed(void) { return slab_free_c; }
+	static uint64_t getBytesInUse(void);
+	static uint64_t getBytesFree(void);
+	static uint64_t getBlocksInUse(void);
+private:
+	struct FreeBlock { FreeBlock *next; };
+	struct Slab
+	{
+		FreeBlock	*free;
+		Slab		*prev, *next;	/* class's partial list */
+		uint32_t	used;
+		uint32_t	cls;
+	};
+	struct SizeClass
+	{
+		Slab		*partial;	/* slabs with free blocks */
+		uint64_t	used;	/* blocks handed out */
+		uint64_t	total;	/* blocks carved from slabs */
+	};
+
+	static unsigned getClass(size_t sz)
+	{ return (sz) ? (sz - 1) / SLAB_GRAIN : 0; }
+	static size_t getBlockBytes(unsigned cls)
+	{ return (cls + 1) * SLAB_GRAIN; }
+	static size_t getHeaderBytes(void)
+	{ return (sizeof(Slab) + SLAB_GRAIN - 1) & ~(size_t)(SLAB_GRAIN - 1); }
+	static Slab* getSlab(void* p)
+	{ return reinterpret_cast<Slab*>(
+		reinterpret_cast<uintptr_t>(p) & ~(uintptr_t)(SLAB_BYTES - 1)); }
+
+	static void linkSlab(SizeClass* sc, Slab* s)
+	{
+		s->prev = NULL;
+		s->next = sc->partial;
+		if (sc->partial) sc->partial->prev = s;
+		sc->partial = s;
+	}
+
+	static void unlinkSlab(SizeClass* sc, Slab* s)
+	{
+		if (s->prev) s->prev->next = s->next;
+		else sc->partial = s->next;
+		if (s->next) s->next->prev = s->prev;
+		s->prev = s->next = NULL;
+	}
+
+	static void newSlab(unsigned cls);
+	static void freeSlab(Slab* s);
+
+	static SizeClass	classes[SLAB_NUM_CLASSES];
+	static uint64_t		slab_c;
+	static uint64_t		slab_free_c;
+	/* unpooled small blocks live from before setup() */
+	static int64_t		early_c;
+	/* -1 until setup() */
+	static int		enabled;
+};
+}
+
+#endif
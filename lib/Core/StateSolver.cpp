@@ -20,6 +20,7 @@
 #include "CoreStats.h"
 #include "../Solver/SMTPrinter.h"
 #include "../Solver/IndependentSolver.h"
+#include "../Solver/PipeSolver.h"
 #include "klee/SolverStats.h"
 #include <string.h>
 
@@ -31,6 +32,9 @@ unsigned StateSolver::timeBuckets[NUM_STATESOLVER_BUCKETS];
 double StateSolver::timeBucketTotal[NUM_STATESOLVER_BUCKETS];
 #define TAG "[StateSolver] "
 
+/* answers nobody took are dropped past this */
+#define MAX_PREFETCHED	1024
+
 extern double MaxSTPTime;
 
 namespace {
@@ -75,6 +79,7 @@ StateSolver::StateSolver(Solver *_solver, TimedSolver *_timedSolver, bool _simpl
 : solver(_solver)
 , timedSolver(_timedSolver)
 , simplifyExprs(_simplifyExprs)
+, async(NULL)
 {
 	assert (solver != nullptr && "state solver without a solver??");
 	memset(timeBuckets, 0, sizeof(timeBuckets));
@@ -114,11 +119,108 @@ bool StateSolver::evaluate(
 		return true;
 	}
 
+	if (!prefetched.empty() && takePrefetched(state, expr, result))
+		return true;
+
 	WRAP_QUERY(solver->evaluate(Query(state.constraints, expr), result));
 
 	return ok;
 }
 
+bool StateSolver::setupAsync(void)
+{
+	async = dynamic_cast<PipeSolver*>(timedSolver);
+	return async != NULL;
+}
+
+bool StateSolver::prefetch(
+	const ExecutionState& state, ref<Expr> expr, Expr::Hash& key)
+{
+	if (async == NULL)
+		return false;
+
+	if (simplifyExprs)
+		expr = state.constraints.simplifyExpr(expr);
+	if (isa<ConstantExpr>(expr))
+		return false;
+
+	Query	q(state.constraints, expr);
+
+	key = q.hash();
+	auto it = prefetched.find(key);
+	if (it != prefetched.end()) {
+		/* answer in => run now; still out => wait with the rest */
+		return !it->second.ready;
+	}
+
+	if (prefetched.size() >= MAX_PREFETCHED) {
+		for (auto it = prefetched.begin(); it != prefetched.end(); ) {
+			if (it->second.ready) it = prefetched.erase(it);
+			else ++it;
+		}
+	}
+
+	if (prefetched.size() >= MAX_PREFETCHED || !async->submitAsync(q))
+		return false;
+
+	++stats::queriesAsync;
+	prefetched[key] = Prefetched { expr, false, false, Solver::Unknown };
+	return true;
+}
+
+void StateSolver::collectPrefetched(std::vector<Expr::Hash>& keys, bool block)
+{
+	std::vector<PipeAnswer>	done;
+
+	assert (async != NULL);
+	async->pollAsync(done, block);
+	for (const auto &ans : done) {
+		auto it = prefetched.find(ans.key);
+		if (it == prefetched.end())
+			continue;
+
+		it->second.ready = true;
+		it->second.ok = ans.ok;
+		it->second.v = ans.v;
+		keys.push_back(ans.key);
+	}
+}
+
+void StateSolver::cancelPrefetched(void)
+{
+	if (async != NULL)
+		async->cancelAsync();
+	prefetched.clear();
+}
+
+bool StateSolver::takePrefetched(
+	const ExecutionState& state, ref<Expr> expr, Solver::Validity &result)
+{
+	bool	ok;
+
+	if (simplifyExprs)
+		expr = state.constraints.simplifyExpr(expr);
+
+	auto it = prefetched.find(Query(state.constraints, expr).hash());
+	if (	it == prefetched.end() ||
+		!it->second.ready ||
+		it->second.expr != expr)
+	{
+		return false;
+	}
+
+	ok = it->second.ok;
+	result = it->second.v;
+	prefetched.erase(it);
+
+	/* a failed async check is asked again the usual way */
+	if (!ok)
+		return false;
+
+	++stats::queriesAsyncHits;
+	return true;
+}
+
 bool StateSolver::mustBeTrue(
 	const ExecutionState& state, ref<Expr> expr, bool &result)
 {
@@ -11,6 +11,8 @@
 #define KLEE_STATESOLVER_H
 
 #include <iostream>
+#include <unordered_map>
+#include <vector>
 #include "klee/Expr.h"
 #include "klee/Solver.h"
 
@@ -18,6 +20,7 @@ namespace klee
 {
 class ExecutionState;
 class Solver;
+class PipeSolver;
 
 /// StateSolver - A simple class which wraps a solver and handles
 /// tracking the statistics that we care about.
@@ -77,7 +80,33 @@ public:
 	static void dumpTimes(std::ostream& os);
 
 	ref<Expr> getLastBadExpr(void) const { return last_bad; }
+
+	/* Branch validity queries sent to the pipe solver pool before the
+	 * branch runs. The executor parks the state until the answer is
+	 * in; evaluate() then takes it instead of asking again. */
+	bool setupAsync(void);
+	bool hasAsync(void) const { return async != NULL; }
+	/* true if the state should park until 'key' comes back */
+	bool prefetch(const ExecutionState&, ref<Expr> expr, Expr::Hash& key);
+	/* keys answered since the last call; 'block' waits for one */
+	void collectPrefetched(std::vector<Expr::Hash>& keys, bool block);
+	void cancelPrefetched(void);
 private:
+	bool takePrefetched(
+		const ExecutionState&, ref<Expr> expr,
+		Solver::Validity &result);
+
+	struct Prefetched
+	{
+		ref<Expr>		expr;
+		bool			ready;
+		bool			ok;
+		Solver::Validity	v;
+	};
+
+	PipeSolver	*async;
+	std::unordered_map<Expr::Hash, Prefetched>	prefetched;
+
 	static uint64_t	constQueries;
 	bool updateTimes(const ExecutionState& state, double totalTime);
 #define STATESOLVER_LOWEST_TIME		1.0e-6
@@ -0,0 +1,250 @@
+#include <llvm/Support/CommandLine.h>
+#include <sys/mman.h>
+#include <linux/falloc.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <iostream>
+#include <vector>
+#include "klee/ExecutionState.h"
+#include "static/Sugar.h"
+#include "Memory.h"
+#include "StateSpill.h"
+
+using namespace klee;
+using namespace llvm;
+
+#define TAG	"[StateSpill] "
+
+namespace {
+	cl::opt<bool> UseStateSpill(
+		"spill-states",
+		cl::desc("Spill private memory of cold states to disk "
+			 "instead of compacting them for replay."),
+		cl::init(false));
+
+	cl::opt<std::string> SpillDir(
+		"spill-dir",
+		cl::desc("Directory for the state spill file "
+			 "(default: output directory)."),
+		cl::init(""));
+}
+
+std::string StateSpill::spill_tmpl("/tmp/klee-spill.XXXXXX");
+int StateSpill::fd = -1;
+std::vector<StateSpill::Extent> StateSpill::segments;
+uint64_t StateSpill::file_len = 0;
+uint64_t StateSpill::spilled_bytes = 0;
+uint64_t StateSpill::reclaimed_bytes = 0;
+uint64_t StateSpill::spilled_objs = 0;
+std::map<uint8_t*, StateSpill::Extent> StateSpill::free_exts;
+std::unordered_map<const ExecutionState*, StateSpill::SpillRec>
+	StateSpill::spilled;
+
+bool StateSpill::isEnabled(void) { return UseStateSpill; }
+
+void StateSpill::setup(const std::string& tmpl)
+{
+	spill_tmpl = (SpillDir.empty())
+		? tmpl
+		: SpillDir + "/klee-spill.XXXXXX";
+}
+
+bool StateSpill::openFile(void)
+{
+	std::vector<char>	buf(spill_tmpl.begin(), spill_tmpl.end());
+
+	buf.push_back('\0');
+	fd = mkstemp(buf.data());
+	if (fd < 0) {
+		std::cerr << TAG "could not create spill file "
+			<< spill_tmpl << '\n';
+		return false;
+	}
+
+	/* only reachable through the mappings from here on */
+	unlink(buf.data());
+	return true;
+}
+
+bool StateSpill::newSegment(size_t sz)
+{
+	size_t	map_len;
+	void	*p;
+	Extent	ext;
+
+	if (fd < 0 && !openFile())
+		return false;
+
+	map_len = std::max(sz, (size_t)SPILL_SEG_BYTES);
+	if (ftruncate(fd, file_len + map_len) != 0)
+		return false;
+
+	p = mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_SHARED,
+		fd, file_len);
+	if (p == MAP_FAILED)
+		return false;
+
+	/* segments stay mapped; backed objects point into them */
+	ext.p = static_cast<uint8_t*>(p);
+	ext.off = file_len;
+	ext.len = map_len;
+	segments.push_back(ext);
+	free_exts[ext.p] = ext;
+	file_len += map_len;
+	return true;
+}
+
+bool StateSpill::reserve(size_t sz, Extent& ext)
+{
+	/* keep every object page aligned in the file */
+	sz = (sz + 4095) & ~((size_t)4095);
+
+	foreach (it, free_exts.begin(), free_exts.end()) {
+		Extent	e(it->second);
+
+		if (e.len < sz)
+			continue;
+
+		free_exts.erase(it);
+		ext.p = e.p;
+		ext.off = e.off;
+		ext.len = sz;
+		if (e.len > sz) {
+			e.p += sz;
+			e.off += sz;
+			e.len -= sz;
+			free_exts[e.p] = e;
+		}
+		return true;
+	}
+
+	if (!newSegment(sz))
+		return false;
+
+	return reserve(sz, ext);
+}
+
+void StateSpill::freeExtent(const Extent& ext)
+{
+	Extent	e(ext);
+
+	/* give the blocks back; reused extents must read as zeroes */
+	if (fallocate(	fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+			e.off, e.len) != 0)
+		memset(e.p, 0, e.len);
+
+	auto	next = free_exts.lower_bound(e.p);
+	if (	next != free_exts.end() &&
+		e.p + e.len == next->first &&
+		e.off + e.len == next->second.off)
+	{
+		e.len += next->second.len;
+		next = free_exts.erase(next);
+	}
+
+	if (next != free_exts.begin()) {
+		Extent	&prev((--next)->second);
+		if (prev.p + prev.len == e.p && prev.off + prev.len == e.off) {
+			prev.len += e.len;
+			return;
+		}
+	}
+
+	free_exts[e.p] = e;
+}
+
+uint64_t StateSpill::spill(ExecutionState& st)
+{
+	SpillRec	*rec = NULL;
+	uint64_t	bytes = 0;
+
+	foreach (it, st.addressSpace.begin(), st.addressSpace.end()) {
+		const ObjectState	*os((*it).second);
+		unsigned		sz(os->getSize());
+		uint64_t		moved;
+		Extent			ext;
+
+		/* shared with another state => no private copy to drop */
+		if (os->getRefCount() != 1 || !os->isSharable())
+			continue;
+
+		if ((sz % COW_SEG_ELEMS) != 0)
+			continue;
+
+		/* lines shared with other objects stay put */
+		if (os->getPrivateBytes() < SPILL_MIN_OBJ)
+			continue;
+
+		if (!reserve(sz, ext))
+			break;
+
+		/* only this state sees the object; its bytes don't change */
+		moved = const_cast<ObjectState*>(os)->spillConcrete(ext.p);
+
+		if (rec == NULL)
+			rec = &spilled[&st];
+		rec->exts[ext.p] = ext;
+		rec->bytes += moved;
+		bytes += moved;
+		spilled_objs++;
+	}
+
+	spilled_bytes += bytes;
+	return bytes;
+}
+
+void StateSpill::release(ExecutionState& st, bool reloading)
+{
+	auto	rec_it = spilled.find(&st);
+
+	if (rec_it == spilled.end())
+		return;
+
+	SpillRec	&rec(rec_it->second);
+
+	foreach (it, st.addressSpace.begin(), st.addressSpace.end()) {
+		const ObjectState	*os((*it).second);
+		const uint8_t		*b(os->getConcreteBacking());
+
+		if (b == NULL || rec.exts.count(b) == 0)
+			continue;
+
+		/* dies with the state; no point paging it back in */
+		if (!reloading && os->getRefCount() == 1)
+			continue;
+
+		const_cast<ObjectState*>(os)->unspillConcrete();
+	}
+
+	foreach (it, rec.exts.begin(), rec.exts.end())
+		freeExtent(it->second);
+
+	spilled_bytes -= rec.bytes;
+	reclaimed_bytes += rec.bytes;
+	spilled.erase(rec_it);
+}
+
+void StateSpill::reloadAll(void)
+{
+	while (!spilled.empty())
+		release(const_cast<ExecutionState&>(
+			*spilled.begin()->first), true);
+}
+
+void StateSpill::resetForWorker(void)
+{
+	assert (spilled.empty() && "reloadAll() before forking");
+
+	/* the parent still spills into these; don't touch them */
+	foreach (it, segments.begin(), segments.end())
+		munmap(it->p, it->len);
+	segments.clear();
+	free_exts.clear();
+
+	if (fd != -1)
+		close(fd);
+	fd = -1;
+	file_len = 0;
+}
@@ -0,0 +1,95 @@
+#ifndef KLEE_STATESPILL_H
+#define KLEE_STATESPILL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace klee
+{
+class ExecutionState;
+
+/* Moves the private concrete memory of a cold state into a file-backed
+ * spill arena instead of compacting it down to a branch path.
+ *
+ * For each object the state owns outright (refcount 1, concrete,
+ * sharable), the lines no other object shares are copied into a
+ * MAP_SHARED mapping of an unlinked spill file and the object is backed
+ * by that copy. Lines still shared with a parent or sibling cost
+ * nothing extra and stay where they are. The kernel can write the pages
+ * back and drop them. Constraints, stack, and symbolics stay in memory.
+ *
+ * When the state is picked again, its objects copy their lines back out
+ * and its extents are freed; a killed state frees them too. Freed
+ * extents have their file blocks punched out and are handed out again
+ * by later spills, so nothing else may point into an extent: a copy of
+ * a spilled object takes its own lines, the running state is never
+ * spilled, and every state is reloaded before the workers fork. */
+#define SPILL_SEG_BYTES	(64*1024*1024)
+#define SPILL_MIN_OBJ	4096
+
+class StateSpill
+{
+public:
+	/* mkstemp template for the spill file unless -spill-dir is set;
+	 * the executor passes one in the output directory */
+	static void setup(const std::string& tmpl);
+
+	/* returns bytes moved out; 0 means there was nothing to spill */
+	static uint64_t spill(ExecutionState& st);
+	/* state is about to run; bring its memory back */
+	static void reload(ExecutionState& st) { release(st, true); }
+	/* state is going away */
+	static void drop(ExecutionState& st) { release(st, false); }
+
+	/* brings every state back; forked processes would share the file */
+	static void reloadAll(void);
+	/* in a forked process, after reloadAll() in the parent: let go of
+	 * the parent's file and spill into a fresh one on demand */
+	static void resetForWorker(void);
+
+	static bool isEnabled(void);
+	static uint64_t getBytesSpilled(void) { return spilled_bytes; }
+	static uint64_t getBytesReclaimed(void) { return reclaimed_bytes; }
+	static uint64_t getNumObjsSpilled(void) { return spilled_objs; }
+private:
+	struct Extent
+	{
+		uint8_t		*p;
+		uint64_t	off;	/* in the spill file */
+		size_t		len;
+	};
+
+	/* what a spilled state holds in the file */
+	struct SpillRec
+	{
+		SpillRec() : bytes(0) {}
+		std::unordered_map<const uint8_t*, Extent>	exts;
+		uint64_t					bytes;
+	};
+
+	static void release(ExecutionState& st, bool reloading);
+	static bool reserve(size_t sz, Extent& ext);
+	static void freeExtent(const Extent& ext);
+	static bool newSegment(size_t sz);
+	static bool openFile(void);
+
+	static std::string	spill_tmpl;
+	static int		fd;
+	/* every mapping of the file, for dropping it in a worker */
+	static std::vector<Extent>	segments;
+	static uint64_t		file_len;
+	static uint64_t		spilled_bytes;
+	static uint64_t		reclaimed_bytes;
+	static uint64_t		spilled_objs;
+
+	/* keyed by address; neighbors in both memory and file merge */
+	static std::map<uint8_t*, Extent>			free_exts;
+	static std::unordered_map<const ExecutionState*, SpillRec>	spilled;
+};
+}
+
+#endif
@@ -214,6 +214,32 @@ void StatsTracker::done()
 }
 
 
+void StatsTracker::flushFiles(void)
+{
+	if (statsFile) statsFile->flush();
+	if (istatsFile) istatsFile->flush();
+}
+
+void StatsTracker::setWorker(unsigned id)
+{
+	char	suffix[32];
+
+	snprintf(suffix, sizeof(suffix), ".%u", id);
+
+	if (statsFile) {
+		statsFile = executor.interpreterHandler->openOutputFile(
+			std::string("run.stats") + suffix);
+		assert(statsFile && "unable to open statistics trace file");
+		writeStatsLine();
+	}
+
+	if (istatsFile) {
+		istatsFile = executor.interpreterHandler->openOutputFile(
+			std::string("run.istats") + suffix);
+		assert(istatsFile && "unable to open istats file");
+	}
+}
+
 void StatsTracker::addKFunction(KFunction* kf)
 {
 	const std::string &name = kf->function->getName();
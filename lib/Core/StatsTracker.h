@@ -98,6 +98,10 @@ public:
     // called when execution is done and stats files should be flushed
     void done();
 
+	void flushFiles(void);
+	// reopen stats files under a per-worker name (e.g., run.stats.1)
+	void setWorker(unsigned id);
+
     // process stats for a single instruction step, es is the state
     // about to be stepped
     void stepInstruction(ExecutionState &es);
@@ -5,6 +5,8 @@
 #include "klee/Internal/ADT/RNG.h"
 #include "klee/ExecutionState.h"
 #include "StateSolver.h"
+#include "klee/util/ExprRangeEvaluator.h"
+#include "klee/util/ValueRange.h"
 #include "static/Sugar.h"
 #include "SymAddrSpace.h"
 
@@ -22,6 +24,28 @@ namespace {
 		"randomize-ptraddend",
 		cl::desc("Randomize pointer addend hint for ptr+u8."),
 		cl::init(false));
+
+	cl::opt<bool> BoundPtrRange(
+		"bound-ptr-range",
+		cl::desc("Only search objects in a pointer's value range."),
+		cl::init(true));
+
+	/* range of an expression over every possible input */
+	class PtrRangeEvaluator : public ExprRangeEvaluator<ValueRange>
+	{
+	protected:
+		ValueRange getInitialReadRange(
+			const Array &array, ValueRange index)
+		{
+			if (	array.isConstantArray() &&
+				index.isFixed() &&
+				index.min() < array.mallocKey.size)
+				return ValueRange(
+					array.getValue(index.min())
+						->getZExtValue(8));
+			return ValueRange(0, 255);
+		}
+	};
 }
 
 namespace klee  { extern RNG theRNG; }
@@ -128,6 +152,88 @@ ref<Expr> SymAddrSpace::getFeasibilityExpr(
 	return inRange;
 }
 
+/* Objects [lo_it, hi_it] overlapping every value the pointer could
+ * take, ignoring path constraints. false => no object can be hit.
+ * 'contained' is set when the whole range lands in one object, in
+ * which case that's the only resolution. Any range that leaves out
+ * objects is checked with one query before the search trusts it. */
+bool SymAddrSpace::getBoundedRange(
+	ref<Expr>	address,
+	MMIter		&lo_it,
+	MMIter		&hi_it,
+	bool		&contained) const
+{
+	const AddressSpace	&as(es.addressSpace);
+	const MemoryObject	*mo;
+	ValueRange		vr;
+	uint64_t		lo, hi;
+	bool			empty, outside, ok;
+
+	contained = false;
+	if (as.begin() == as.end())
+		return false;
+
+	if (!BoundPtrRange || address->getWidth() > 64) {
+		lo_it = as.begin();
+		hi_it = as.end();
+		--hi_it;
+		return true;
+	}
+
+	vr = PtrRangeEvaluator().evaluate(address);
+	lo = vr.min();
+	hi = vr.max();
+
+	/* first object ending past lo */
+	lo_it = as.upper_bound(lo);
+	if (lo_it != as.begin()) {
+		MMIter	prev(lo_it);
+		--prev;
+		mo = prev->first;
+		if (mo->address == lo || lo - mo->address < mo->size)
+			lo_it = prev;
+	}
+
+	/* last object starting at or before hi */
+	hi_it = as.upper_bound(hi);
+	empty = (hi_it == as.begin());
+	if (!empty) {
+		--hi_it;
+		empty = (lo_it == as.end() ||
+			lo_it->first->address > hi_it->first->address);
+	}
+
+	if (!empty) {
+		MMIter	last(as.end());
+
+		mo = lo_it->first;
+		contained = (	lo_it == hi_it &&
+				lo >= mo->address &&
+				hi - mo->address < mo->size);
+
+		/* covers every object; nothing to drop */
+		--last;
+		if (!contained && lo_it == as.begin() && hi_it == last)
+			return true;
+	}
+
+	/* a range that's too tight would drop feasible objects */
+	ok = solver->mayBeTrue(
+		es,
+		MK_OR(	MK_ULT(address, MK_CONST(lo, address->getWidth())),
+			MK_UGT(address, MK_CONST(hi, address->getWidth()))),
+		outside);
+	if (!ok || outside) {
+		contained = false;
+		lo_it = as.begin();
+		hi_it = as.end();
+		--hi_it;
+		return true;
+	}
+
+	return !empty;
+}
+
 /////////////
 bool SymAddrSpace::isFeasibleRange(
 	ref<Expr> address,
@@ -219,33 +325,30 @@ bool SymAddrSpace::getFeasibleObject(ref<Expr>& address, ObjectPair& res)
 			return true;
 	}
 
+	/* every value lands in one object; no search needed */
+	MMIter	rb(es.addressSpace.end()), re(rb);
+	bool	contained;
+	if (!getBoundedRange(address, rb, re, contained))
+		return true;
+	if (contained) {
+		res = *rb;
+		return true;
+	}
+
 	// We couldn't throw a dart and hit a feasible address.
 	// The next step is to try to find any feasible address.
-	return binsearchFeasible(address, c_addr->getZExtValue(), res);
+	return binsearchFeasible(address, rb, re, res);
 }
 
+/* search only [lo_it, hi_it]; getBoundedRange has already shown the
+ * pointer can't land outside of it */
 bool SymAddrSpace::binsearchFeasible(
-	ref<Expr>& addr, uint64_t upper_addr, ObjectPair& res)
+	ref<Expr>& addr, MMIter lo_it, MMIter hi_it, ObjectPair& res)
 {
-	MemoryObject	toFind(upper_addr);
-	MMIter		oi = es.addressSpace.objects.upper_bound(&toFind);
-	MMIter		gt = oi;
-	MMIter		lt = oi;
-
-	if (gt == es.addressSpace.objects.end())
-		--gt;
-	else
-		++gt;
-
-	if (lt != es.addressSpace.objects.begin()) --lt;
-
-	MMIter begin = es.addressSpace.objects.begin();
-	MMIter end = es.addressSpace.objects.end();
-	--end;
-
 	std::pair<MMIter, MMIter>
-		left(es.addressSpace.objects.begin(),lt),
-		right(gt,es.addressSpace.objects.end());
+		left(lo_it, hi_it),
+		right(es.addressSpace.objects.end(),
+			es.addressSpace.objects.end());
 
 	while (true) {
 		// Check whether current range of MemoryObjects is feasible
@@ -343,6 +446,17 @@ bool SymAddrSpace::resolve(
 			return bad_addr;
 	}
 
+	MMIter	rb(es.addressSpace.end()), re(rb);
+	bool	contained;
+
+	if (!getBoundedRange(p, rb, re, contained))
+		return false;
+
+	if (contained) {
+		rl.push_back(*rb);
+		return false;
+	}
+
 	ref<ConstantExpr> cex;
 	if (!solver->getValue(es, p, cex))
 		return true;
@@ -350,34 +464,31 @@ bool SymAddrSpace::resolve(
 	MemoryObject toFind(cex->getZExtValue() /* example */);
 
 	MMIter	oi = es.addressSpace.objects.find(&toFind);
-	MMIter	gt = oi;
-	if (gt != es.addressSpace.objects.end())
-		++gt;
-
-	MMIter lt = oi;
-	if (lt != es.addressSpace.objects.begin())
-		--lt;
-
-	MMIter end = es.addressSpace.objects.end();
-	--end;
 
 	// Explicit stack to avoid recursion
 	std::stack < std::pair<decltype (oi), decltype (oi)> > tryRanges;
 
-	// Search [begin, first object < example] if range is not empty
-	if (lt != es.addressSpace.objects.begin())
-		tryRanges.push(
-			std::make_pair(es.addressSpace.objects.begin(), lt));
+	if (oi == es.addressSpace.objects.end()) {
+		tryRanges.push(std::make_pair(rb, re));
+		return binsearchRange(p, tryRanges, maxResolutions, rl);
+	}
 
-	// Search [first object > example, end-1] if range is not empty
-	if (gt != es.addressSpace.objects.end())
-		tryRanges.push(std::make_pair(gt, end));
+	// Search [first bounded object, first object < example]
+	if (oi != rb) {
+		MMIter	lt(oi);
+		tryRanges.push(std::make_pair(rb, --lt));
+	}
+
+	// Search [first object > example, last bounded object]
+	if (oi != re) {
+		MMIter	gt(oi);
+		tryRanges.push(std::make_pair(++gt, re));
+	}
 
 	// Search [example,example] if exists (may not on weird overlap cases)
 	// NOTE: check the example first in case of fast path,
 	// so push onto stack last
-	if (oi != es.addressSpace.objects.end())
-		tryRanges.push(std::make_pair(oi, oi));
+	tryRanges.push(std::make_pair(oi, oi));
 
 	return binsearchRange(p, tryRanges, maxResolutions, rl);
 }
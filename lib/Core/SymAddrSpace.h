@@ -82,6 +82,12 @@ private:
 		bool& ok)
 	{ return isFeasibleRange(address, mo, mo, ok); }
 
+	bool getBoundedRange(
+		ref<Expr> address,
+		MMIter& lo_it,
+		MMIter& hi_it,
+		bool& contained) const;
+
 	ref<Expr> getFeasibilityExpr(
 		ref<Expr> address,
 		const MemoryObject* lo,
@@ -95,7 +101,7 @@ private:
 
 	bool binsearchFeasible(
 		ref<Expr>& addr,
-		uint64_t upper_addr, ObjectPair& res);
+		MMIter lo_it, MMIter hi_it, ObjectPair& res);
 
 
 	bool contigOffsetSearchRange(
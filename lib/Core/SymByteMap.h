@@ -0,0 +1,119 @@
+#ifndef KLEE_SYMBYTEMAP_H
+#define KLEE_SYMBYTEMAP_H
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include "klee/Expr.h"
+#include "static/Sugar.h"
+#include "CowSegArray.h"
+
+namespace klee
+{
+/* Cached symbolic bytes of an object state. Most objects only ever
+ * carry a handful, so offsets start out in a small sorted vector; past
+ * SYM_SPARSE_MAX entries the map switches to a dense line array, which
+ * stays dense from then on. A missing offset reads as a null expr. */
+#define SYM_SPARSE_MAX	32
+
+class SymByteMap
+{
+public:
+	SymByteMap(unsigned _size) : size(_size) {}
+	SymByteMap(const SymByteMap& m)
+	: size(m.size)
+	, sparse(m.sparse)
+	, dense((m.dense)
+		? std::make_unique<CowSegArray<ref<Expr> > >(*m.dense)
+		: nullptr)
+	{}
+
+	const ref<Expr>& get(unsigned off) const
+	{
+		static const ref<Expr>	null_expr;
+		sparse_ty::const_iterator	it;
+
+		if (dense)
+			return dense->get(off);
+
+		it = find(off);
+		return (it != sparse.end() && it->first == off)
+			? it->second
+			: null_expr;
+	}
+
+	void set(unsigned off, const ref<Expr>& e)
+	{
+		sparse_ty::iterator	it;
+
+		if (dense) {
+			dense->getMut(off) = e;
+			return;
+		}
+
+		it = find(off);
+		if (it != sparse.end() && it->first == off) {
+			it->second = e;
+			return;
+		}
+
+		if (sparse.size() < SYM_SPARSE_MAX) {
+			sparse.insert(it, std::make_pair(off, e));
+			return;
+		}
+
+		makeDense();
+		dense->getMut(off) = e;
+	}
+
+	void reset(unsigned off)
+	{
+		sparse_ty::iterator	it;
+
+		if (dense) {
+			dense->reset(off);
+			return;
+		}
+
+		it = find(off);
+		if (it != sparse.end() && it->first == off)
+			sparse.erase(it);
+	}
+
+	bool isDense(void) const { return dense != nullptr; }
+private:
+	typedef std::vector<std::pair<unsigned, ref<Expr> > > sparse_ty;
+
+	SymByteMap& operator=(const SymByteMap&) = delete;
+
+	sparse_ty::const_iterator find(unsigned off) const
+	{
+		return std::lower_bound(
+			sparse.begin(), sparse.end(), off,
+			[] (const sparse_ty::value_type& p, unsigned o)
+			{ return p.first < o; });
+	}
+
+	sparse_ty::iterator find(unsigned off)
+	{
+		return std::lower_bound(
+			sparse.begin(), sparse.end(), off,
+			[] (const sparse_ty::value_type& p, unsigned o)
+			{ return p.first < o; });
+	}
+
+	void makeDense(void)
+	{
+		dense = std::make_unique<CowSegArray<ref<Expr> > >(size);
+		foreach (it, sparse.begin(), sparse.end())
+			dense->getMut(it->first) = it->second;
+		sparse_ty().swap(sparse);
+	}
+
+	const unsigned	size;
+	sparse_ty	sparse;
+	std::unique_ptr<CowSegArray<ref<Expr> > >	dense;
+};
+}
+
+#endif
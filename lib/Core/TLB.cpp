@@ -1,51 +1,83 @@
-#include <string.h>
 #include "klee/ExecutionState.h"
 #include "Memory.h"
 #include "TLB.h"
 
 using namespace klee;
 
-TLB::TLB(void) : cur_sid(~0) {}
+uint64_t TLB::hit_c = 0;
+uint64_t TLB::miss_c = 0;
 
-#define ADDR2IDX(x)	((((x) / (TLB_PAGE_SZ*TLB_OBJCACHE_ENTS)) \
-			^ ((x) / TLB_PAGE_SZ))\
-			% TLB_OBJCACHE_ENTS)
+TLB::TLB(void)
+: sets(new Set[TLB_SETS]())
+, epochs(new uint32_t[TLB_EPOCHS]())
+{}
+
+TLB::~TLB(void)
+{
+	delete [] sets;
+	delete [] epochs;
+}
+
+TLB::Set* TLB::getSet(uint64_t tag, uint64_t page) const
+{ return &sets[(page ^ (page >> 10) ^ (tag * 0x9e3779b97f4a7c15ULL >> 40))
+	% TLB_SETS]; }
 
 bool TLB::get(ExecutionState& st, uint64_t addr, ObjectPair& out_op)
+{ return get(st.addressSpace.getTag(), addr, out_op); }
+
+void TLB::put(ExecutionState& st, uint64_t addr, ObjectPair& op)
+{ put(st.addressSpace.getTag(), addr, op); }
+
+bool TLB::get(uint64_t tag, uint64_t addr, ObjectPair& out_op)
 {
-	ObjectPair	*op;
+	uint64_t	page = addr / TLB_PAGE_SZ;
+	Set		*s = getSet(tag, page);
+	uint32_t	epoch = getEpoch(page);
 
-	useState(&st);
+	for (unsigned i = 0; i < TLB_WAYS; i++) {
+		const Entry	&e(s->ways[i]);
 
-	op = &obj_cache[ADDR2IDX(addr)];
-	if (op->first == NULL)
-		return false;
+		if (	e.tag != tag || e.page != page ||
+			e.op.first == NULL || e.epoch != epoch)
+			continue;
 
-	/* full boundary checks are done in the MMU. */
-	if (op->first->isInBounds(addr, 1) == false)
-		return false;
+		/* full boundary checks are done in the MMU. */
+		if (e.op.first->isInBounds(addr, 1) == false)
+			break;
 
-	out_op = *op;
-	return true;
-}
+		out_op = e.op;
+		hit_c++;
+		return true;
+	}
 
-void TLB::put(ExecutionState& st, ObjectPair& op)
-{
-	useState(&st);
-	obj_cache[ADDR2IDX(op.first->address)] = op;
+	miss_c++;
+	return false;
 }
 
-/* if address space changed, reset TLB */
-void TLB::useState(const ExecutionState* st)
+void TLB::put(uint64_t tag, uint64_t addr, ObjectPair& op)
 {
-	if (	st->getSID() == cur_sid &&
-		cur_gen == st->addressSpace.getGeneration())
-		return;
+	uint64_t	page = addr / TLB_PAGE_SZ;
+	Set		*s = getSet(tag, page);
+	Entry		*e = NULL;
+
+	for (unsigned i = 0; i < TLB_WAYS; i++) {
+		if (s->ways[i].tag == tag && s->ways[i].page == page) {
+			e = &s->ways[i];
+			break;
+		}
+	}
+
+	if (e == NULL) {
+		e = &s->ways[s->next];
+		s->next = (s->next + 1) % TLB_WAYS;
+	}
 
-	memset(&obj_cache, 0, sizeof(obj_cache));
-	cur_sid = st->getSID();
-	cur_gen = st->addressSpace.getGeneration();
+	e->tag = tag;
+	e->page = page;
+	e->op = op;
+	e->epoch = getEpoch(page);
 }
 
+/* entries filled before the bump no longer match their page's epoch */
 void TLB::invalidate(uint64_t addr)
-{ obj_cache[ADDR2IDX(addr)].first = NULL; }
+{ getEpoch(addr / TLB_PAGE_SZ)++; }
@@ -3,27 +3,59 @@
 
 #include "AddressSpace.h"
 
-#define TLB_OBJCACHE_ENTS	256
+/* set-associative; TLB_SETS*TLB_WAYS translations */
+#define TLB_SETS		1024
+#define TLB_WAYS		4
 #define TLB_PAGE_SZ		4096
+/* invalidation epochs; pages hashing together are dropped together */
+#define TLB_EPOCHS		1024
 
 namespace klee
 {
 class ExecutionState;
 
+/* Translation cache shared by every state an MMU runs. Entries are
+ * tagged with the address space's content tag (see AddressSpace), so
+ * switching states costs nothing and forked states that haven't
+ * diverged hit on each other's translations. */
 class TLB
 {
 public:
 	TLB(void);
-	virtual ~TLB(void) {}
+	virtual ~TLB(void);
 	bool get(ExecutionState& st, uint64_t addr, ObjectPair& op);
-	void put(ExecutionState& st, ObjectPair& op);
+	void put(ExecutionState& st, uint64_t addr, ObjectPair& op);
+	/* by address space tag */
+	bool get(uint64_t tag, uint64_t addr, ObjectPair& op);
+	void put(uint64_t tag, uint64_t addr, ObjectPair& op);
+	/* drops the page for every tag */
 	void invalidate(uint64_t addr);
+
+	static uint64_t getHits(void) { return hit_c; }
+	static uint64_t getMisses(void) { return miss_c; }
 private:
-	void useState(const ExecutionState* st);
-	uint64_t	cur_sid;
-	unsigned	cur_gen;
-	ObjectPair	obj_cache[TLB_OBJCACHE_ENTS];
+	struct Entry
+	{
+		uint64_t	tag;
+		uint64_t	page;
+		ObjectPair	op;
+		uint32_t	epoch;
+	};
+
+	struct Set
+	{
+		Entry		ways[TLB_WAYS];
+		unsigned	next;	/* round-robin victim */
+	};
+
+	Set* getSet(uint64_t tag, uint64_t page) const;
+	uint32_t& getEpoch(uint64_t page) const
+	{ return epochs[(page ^ (page >> 10)) % TLB_EPOCHS]; }
 
+	Set		*sets;
+	uint32_t	*epochs;
+	static uint64_t	hit_c;
+	static uint64_t	miss_c;
 };
 }
 
@@ -14,17 +14,6 @@ void UnboxingObjectState::write8(unsigned offset, ref<Expr>& value)
 	ObjectState::write8(offset, value);
 }
 
-#define writeN(n)		\
-do {				\
-unsigned NumBytes = n/8;	\
-for (unsigned i = 0; i != NumBytes; ++i) {	\
-	unsigned idx;	\
-	idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);	\
-	ObjectState::write8(offset + idx, (uint8_t) (val >> (8 * i)));	\
-}	\
-} while (0)
-
-
 void UnboxingObjectState::write(unsigned offset, const ref<Expr>& value)
 {
 	// Check for writes of constant values.
@@ -38,9 +27,11 @@ void UnboxingObjectState::write(unsigned offset, const ref<Expr>& value)
 			case Expr::Int8:
 				ObjectState::write8(offset, val);
 				return;
-			case Expr::Int16: writeN(16); return;
-			case Expr::Int32: writeN(32); return;
-			case Expr::Int64: writeN(64); return;
+			case Expr::Int16:
+			case Expr::Int32:
+			case Expr::Int64:
+				writeConstantBytes(offset, val, w/8);
+				return;
 			}
 		}
 	}
@@ -0,0 +1,255 @@
+//===-- BatchEvaluator.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/util/BatchEvaluator.h"
+#include "klee/util/Assignment.h"
+#include <algorithm>
+
+using namespace klee;
+
+uint64_t BatchEvaluator::batch_c = 0;
+uint64_t BatchEvaluator::slow_c = 0;
+
+#define LANES(x)	for (unsigned k = 0; k < BATCH_LANES; k++) { x; }
+
+bool BatchEvaluator::checkSlow(const Assignment* a) const
+{
+	slow_c++;
+	return a->satisfies(exprs.begin(), exprs.end());
+}
+
+void BatchEvaluator::buildTape(void)
+{
+	if (built)
+		return;
+
+	for (const auto &e : exprs)
+		roots.push_back(store.add(e));
+	built = true;
+}
+
+const TapeJIT::Checker* BatchEvaluator::lookupJIT(void)
+{
+	TapeJIT	*jit = TapeJIT::get();
+	return (jit != NULL) ? jit->lookup(exprs) : NULL;
+}
+
+bool BatchEvaluator::checkJIT(
+	const TapeJIT::Checker* jc, const Assignment* a) const
+{
+	int	r = TapeJIT::run(jc, *a);
+	return (r < 0) ? checkSlow(a) : (r == 1);
+}
+
+void BatchEvaluator::check(
+	const std::vector<const Assignment*>& as,
+	std::vector<bool>& sat)
+{
+	const TapeJIT::Checker	*jc;
+	bool			lane_sat[BATCH_LANES];
+
+	sat.assign(as.size(), false);
+
+	if ((jc = lookupJIT()) != NULL) {
+		for (unsigned i = 0; i < as.size(); i++)
+			sat[i] = checkJIT(jc, as[i]);
+		return;
+	}
+
+	buildTape();
+	if (store.isWide()) {
+		for (unsigned i = 0; i < as.size(); i++)
+			sat[i] = checkSlow(as[i]);
+		return;
+	}
+
+	for (unsigned i = 0; i < as.size(); i += BATCH_LANES) {
+		unsigned	n = std::min(
+			(unsigned)BATCH_LANES, (unsigned)as.size() - i);
+
+		runBatch(&as[i], n, lane_sat);
+		for (unsigned k = 0; k < n; k++)
+			sat[i + k] = lane_sat[k];
+	}
+}
+
+int BatchEvaluator::findSatisfying(const std::vector<const Assignment*>& as)
+{
+	const TapeJIT::Checker	*jc;
+	bool			lane_sat[BATCH_LANES];
+
+	if ((jc = lookupJIT()) != NULL) {
+		for (unsigned i = 0; i < as.size(); i++)
+			if (checkJIT(jc, as[i]))
+				return i;
+		return -1;
+	}
+
+	buildTape();
+
+	for (unsigned i = 0; i < as.size(); i += BATCH_LANES) {
+		unsigned	n = std::min(
+			(unsigned)BATCH_LANES, (unsigned)as.size() - i);
+
+		if (store.isWide()) {
+			for (unsigned k = 0; k < n; k++)
+				lane_sat[k] = checkSlow(as[i + k]);
+		} else
+			runBatch(&as[i], n, lane_sat);
+
+		for (unsigned k = 0; k < n; k++)
+			if (lane_sat[k])
+				return i + k;
+	}
+
+	return -1;
+}
+
+/* same order as ExprEvaluator::evalRead: updates, constant array, binding */
+void BatchEvaluator::evalReads(ExprStore::id_ty i, unsigned n, uint8_t* bad)
+{
+	const uint64_t	*idx = &vals[store.getKid(i, 0) * BATCH_LANES];
+	uint64_t	*v = &vals[i * BATCH_LANES];
+	unsigned	slot = store.getAux(i);
+	const Array	*arr = store.getArrayAt(slot);
+	unsigned	nk = store.getNumKids(i);
+
+	for (unsigned k = 0; k < n; k++) {
+		const std::vector<unsigned char>	*b;
+		unsigned				u;
+
+		for (u = 1; u + 1 < nk; u += 2) {
+			ExprStore::id_ty	ui = store.getKid(i, u);
+			if (vals[ui * BATCH_LANES + k] == idx[k])
+				break;
+		}
+
+		if (u + 1 < nk) {
+			v[k] = vals[store.getKid(i, u + 1) * BATCH_LANES + k];
+			continue;
+		}
+
+		if (arr->isConstantArray() && idx[k] < arr->mallocKey.size) {
+			v[k] = arr->getValue(idx[k])->getZExtValue();
+			continue;
+		}
+
+		b = binds[slot * BATCH_LANES + k];
+		if (b != NULL && idx[k] < b->size()) {
+			v[k] = (*b)[idx[k]];
+			continue;
+		}
+
+		if (frees[k])
+			bad[k] = 1;
+		v[k] = 0;
+	}
+}
+
+void BatchEvaluator::runBatch(
+	const Assignment* const* as, unsigned n, bool* sat)
+{
+	uint8_t	bad[BATCH_LANES] = { 0 };
+	unsigned	na = store.getNumArrays();
+
+	batch_c++;
+	vals.resize(store.size() * BATCH_LANES);
+	scratch.resize(store.size());
+	binds.assign(na * BATCH_LANES, NULL);
+	frees.assign(BATCH_LANES, 0);
+
+	for (unsigned k = 0; k < n; k++) {
+		frees[k] = as[k]->allowFreeValues;
+		for (unsigned s = 0; s < na; s++)
+			binds[s * BATCH_LANES + k] =
+				as[k]->getBinding(store.getArrayAt(s));
+	}
+
+	for (ExprStore::id_ty i = 0; i < store.size(); i++) {
+		uint64_t	*v = &vals[i * BATCH_LANES];
+		const uint64_t	*l = NULL, *r = NULL, *c = NULL;
+		Expr::Width	w = store.getWidth(i), kw = w;
+		unsigned	nk = store.getNumKids(i);
+
+		if (nk > 0) {
+			l = &vals[store.getKid(i, 0) * BATCH_LANES];
+			kw = store.getWidth(store.getKid(i, 0));
+		}
+		if (nk > 1) r = &vals[store.getKid(i, 1) * BATCH_LANES];
+		if (nk > 2) c = &vals[store.getKid(i, 2) * BATCH_LANES];
+
+		switch (store.getKind(i)) {
+		case Expr::Constant: LANES(v[k] = store.getAux(i)); break;
+		case Expr::NotOptimized: LANES(v[k] = l[k]); break;
+		case Expr::Read: evalReads(i, n, bad); break;
+		case Expr::Select: LANES(v[k] = (l[k]) ? r[k] : c[k]); break;
+		case Expr::Concat: {
+			unsigned	sh = store.getWidth(store.getKid(i, 1));
+			LANES(v[k] = (l[k] << sh) | r[k]);
+			break;
+		}
+		case Expr::Extract: {
+			unsigned	off = store.getAux(i);
+			LANES(v[k] = l[k] >> off);
+			break;
+		}
+		case Expr::ZExt: LANES(v[k] = l[k]); break;
+		case Expr::SExt: LANES(v[k] = ExprStore::sext(l[k], kw)); break;
+
+		case Expr::Add: LANES(v[k] = l[k] + r[k]); break;
+		case Expr::Sub: LANES(v[k] = l[k] - r[k]); break;
+		case Expr::Mul: LANES(v[k] = l[k] * r[k]); break;
+		case Expr::Not: LANES(v[k] = ~l[k]); break;
+		case Expr::And: LANES(v[k] = l[k] & r[k]); break;
+		case Expr::Or: LANES(v[k] = l[k] | r[k]); break;
+		case Expr::Xor: LANES(v[k] = l[k] ^ r[k]); break;
+		case Expr::Shl: LANES(v[k] = (r[k] >= w) ? 0 : l[k] << r[k]); break;
+		case Expr::LShr: LANES(v[k] = (r[k] >= w) ? 0 : l[k] >> r[k]); break;
+		case Expr::Eq: LANES(v[k] = l[k] == r[k]); break;
+		case Expr::Ne: LANES(v[k] = l[k] != r[k]); break;
+		case Expr::Ult: LANES(v[k] = l[k] < r[k]); break;
+		case Expr::Ule: LANES(v[k] = l[k] <= r[k]); break;
+		case Expr::Ugt: LANES(v[k] = l[k] > r[k]); break;
+		case Expr::Uge: LANES(v[k] = l[k] >= r[k]); break;
+
+		/* everything else goes lane by lane through the scalar path */
+		default:
+			for (unsigned k = 0; k < n; k++) {
+				for (unsigned j = 0; j < nk; j++) {
+					ExprStore::id_ty kid = store.getKid(i, j);
+					scratch[kid] = vals[kid * BATCH_LANES + k];
+				}
+
+				if (!store.evalNode(i, *as[k], scratch)) {
+					bad[k] = 1;
+					v[k] = 0;
+				} else
+					v[k] = scratch[i];
+			}
+			break;
+		}
+
+		LANES(v[k] = ExprStore::mask(v[k], w));
+	}
+
+	for (unsigned k = 0; k < n; k++) {
+		if (bad[k]) {
+			sat[k] = checkSlow(as[k]);
+			continue;
+		}
+
+		sat[k] = true;
+		for (auto root : roots) {
+			if (vals[root * BATCH_LANES + k] != 1) {
+				sat[k] = false;
+				break;
+			}
+		}
+	}
+}
@@ -27,6 +27,8 @@ using namespace klee;
 
 #define MAX_UPDATE_TIME	1000
 #define MAX_REPL_SIZE	1000
+/* forks between partition rebuilds */
+#define MAX_PARTITION_DEPTH	16
 
 namespace {
 	llvm::cl::opt<bool>
@@ -177,6 +179,7 @@ bool ConstraintManager::rewriteConstraints(ExprVisitor &visitor)
 
 	constraints.swap(old_c);
 	readsets.swap(old_rs);
+	partition.reset();
 	invalidateSimplifier();
 
 	assert (!Expr::errors);
@@ -431,6 +434,7 @@ bool ConstraintManager::apply(const Assignment& a)
 	invalidateSimplifier();
 	constraints.clear();
 	readsets.clear();
+	partition.reset();
 	for (auto& e : new_constrs) addConstraint(e);
 
 	return true;
@@ -483,3 +487,47 @@ ref<Expr> ConstraintManager::getConjunction(void) const
 	}
 	return e;
 }
+
+void ConstraintManager::syncPartition(void) const
+{
+	if (partition == NULL)
+		partition = std::make_shared<ConstraintPartition>();
+	else if (partition->size() > constraints.size())
+		partition = std::make_shared<ConstraintPartition>();
+
+	if (partition->size() == constraints.size())
+		return;
+
+	/* copies share the prefix they had in common; extend a delta on
+	 * top of it, or start over once lookups walk too many layers */
+	if (partition.use_count() > 1) {
+		if (partition->getDepth() >= MAX_PARTITION_DEPTH)
+			partition = std::make_shared<ConstraintPartition>();
+		else
+			partition = std::make_shared<ConstraintPartition>(
+				std::shared_ptr<const ConstraintPartition>(
+					partition));
+	}
+
+	for (unsigned i = partition->size(); i < constraints.size(); i++)
+		partition->add(i, *readsets[i]);
+}
+
+void ConstraintManager::getDependent(
+	const ref<Expr>& e, ConstraintManager& cs) const
+{
+	std::vector<unsigned>	idxs;
+	constraints_t		constrs;
+	readsets_t		rs;
+	ref<Expr>		e_tmp(e);
+
+	syncPartition();
+	partition->getDependent(*ReadSet::get(e_tmp), idxs);
+
+	for (auto i : idxs) {
+		constrs.push_back(constraints[i]);
+		rs.push_back(readsets[i]);
+	}
+
+	cs = ConstraintManager(constrs, rs);
+}
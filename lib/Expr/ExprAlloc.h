@@ -20,6 +20,8 @@ public:
 
 	static unsigned long getNumConstants(void) { return constantCount; }
 	virtual unsigned garbageCollect(void);
+	/* garbageCollect will be called periodically from now on */
+	virtual void armGC(void) {}
 
 	void printName(std::ostream& os) const override;
 protected:
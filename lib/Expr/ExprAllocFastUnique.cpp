@@ -1,3 +1,4 @@
+#include <llvm/Support/CommandLine.h>
 #include <unordered_map>
 #include <assert.h>
 #include "klee/Expr.h"
@@ -6,21 +7,51 @@
 
 using namespace klee;
 
+namespace {
+	llvm::cl::opt<unsigned>
+	ExprGCMajor(
+		"expr-gc-major",
+		llvm::cl::desc(
+			"Sweep the whole expr table every n-th GC; others only "
+			"sweep exprs made since the last GC (0 or 1=always)"),
+		llvm::cl::init(8));
+}
+
 struct hashexpr
 { unsigned operator()(const ref<Expr>& a) const { return a->hash(); } };
 
 
+/* Young generation: exprs consed since the last collection, oldest first.
+ * A minor collection only looks at these, newest first, so a dead
+ * temporary drops its refs on younger-but-older kids before they are
+ * checked and whole simplifier chains go in one pass. Survivors are
+ * promoted by forgetting them; only a major collection sees them again.
+ * Entries are raw pointers, valid because nothing but a collection
+ * takes an expr out of the tables. Nothing is tracked until a periodic
+ * collector arms it; otherwise the list would only ever grow. */
+static std::vector<Expr*>	young_exprs;
+static bool			track_young = false;
+
+template <class T, class... Args>
+static T* newYoung(Args&&... args)
+{
+	T	*e = new T(std::forward<Args>(args)...);
+	if (track_young)
+		young_exprs.push_back(e);
+	return e;
+}
+
 #define GET_OR_MK_SLOW(x)	\
 auto it(exmap_##x.find(key));	\
 if (it != exmap_##x.end()) { expr_hit_c++; return it->second; }	\
 expr_miss_c++;	\
-ref<Expr> r = new x##Expr
+ref<Expr> r = newYoung<x##Expr>
 
 #define GET_OR_MK(x)				\
 auto &r = exmap_##x[key];			\
 if (!r.isNull()) { expr_hit_c++; return r; }	\
 expr_miss_c++;					\
-r = new x##Expr
+r = newYoung<x##Expr>
 
 
 /* OP, expr, expr */
@@ -31,6 +62,7 @@ r = new x##Expr
 
 unsigned long ExprAllocFastUnique::expr_miss_c = 0;
 unsigned long ExprAllocFastUnique::expr_hit_c = 0;
+unsigned long ExprAllocFastUnique::gc_c = 0;
 
 struct hashexpr_read
 { unsigned operator()(
@@ -239,10 +271,123 @@ do {		\
 	ret += rmv_keys_##x.size();				\
 } while (0)
 	
+template <class M, class K>
+static bool eraseEntry(M& m, const K& k, const Expr* e)
+{
+	auto it(m.find(k));
+
+	if (it == m.end() || it->second.get() != e)
+		return false;
+
+	m.erase(it);
+	return true;
+}
+
+/* tables are keyed by the constructor arguments, which are the kids */
+static bool eraseExpr(Expr* e)
+{
+#define ERASE_UN(x)	\
+	case Expr::x: return eraseEntry(exmap_##x, e->getKid(0), e);
+#define ERASE_CAST(x)	\
+	case Expr::x: return eraseEntry(exmap_##x,	\
+		std::make_pair(e->getKid(0), e->getWidth()), e);
+#define ERASE_BIN(x)	\
+	case Expr::x: return eraseEntry(exmap_##x,	\
+		std::make_pair(e->getKid(0), e->getKid(1)), e);
+
+	switch (e->getKind()) {
+	case Expr::Read: {
+		ReadExpr	*re = cast<ReadExpr>(e);
+		std::pair<UpdateList&, ref<Expr> > k(re->updates, re->index);
+		return eraseEntry(exmap_Read, k, e);
+	}
+	case Expr::Select:
+		return eraseEntry(exmap_Select,
+			std::make_pair(e->getKid(0),
+				std::make_pair(e->getKid(1), e->getKid(2))),
+			e);
+	case Expr::Extract: {
+		ExtractExpr	*ee = cast<ExtractExpr>(e);
+		return eraseEntry(exmap_Extract,
+			std::make_pair(ee->expr,
+				std::make_pair(ee->offset, ee->width)),
+			e);
+	}
+	ERASE_UN(NotOptimized)
+	ERASE_UN(Not)
+	ERASE_CAST(ZExt)
+	ERASE_CAST(SExt)
+
+	ERASE_BIN(Concat)
+	ERASE_BIN(Add)
+	ERASE_BIN(Sub)
+	ERASE_BIN(Mul)
+	ERASE_BIN(UDiv)
+
+	ERASE_BIN(SDiv)
+	ERASE_BIN(URem)
+	ERASE_BIN(SRem)
+	ERASE_BIN(And)
+	ERASE_BIN(Or)
+	ERASE_BIN(Xor)
+	ERASE_BIN(Shl)
+	ERASE_BIN(LShr)
+	ERASE_BIN(AShr)
+	ERASE_BIN(Eq)
+	ERASE_BIN(Ne)
+	ERASE_BIN(Ult)
+	ERASE_BIN(Ule)
+
+	ERASE_BIN(Ugt)
+	ERASE_BIN(Uge)
+	ERASE_BIN(Slt)
+	ERASE_BIN(Sle)
+	ERASE_BIN(Sgt)
+	ERASE_BIN(Sge)
+	default: break;
+	}
+#undef ERASE_UN
+#undef ERASE_CAST
+#undef ERASE_BIN
+
+	return false;
+}
+
+unsigned ExprAllocFastUnique::collectYoung(void)
+{
+	std::vector<Expr*>	young;
+	unsigned		ret = 0;
+
+	young.swap(young_exprs);
+	for (auto it = young.rbegin(); it != young.rend(); ++it) {
+		ref<Expr>	e(*it);
+
+		/* table + 'e' => garbage; otherwise promote */
+		if (e.getRefCount() > 2)
+			continue;
+
+		if (eraseExpr(e.get()))
+			ret++;
+	}
+
+	std::cerr << "[ExprAllocFastUnique] Minor freed " << ret
+		<< " of " << young.size() << " young\n";
+
+	return ret;
+}
+
+/* called by a periodic collector after a major collection, so the
+ * young list holds everything made since the last sweep */
+void ExprAllocFastUnique::armGC(void) { track_young = ExprGCMajor > 1; }
+
 unsigned ExprAllocFastUnique::garbageCollect(void)
 {
 	unsigned ret = 0;
 
+	gc_c++;
+	if (track_young && (gc_c % ExprGCMajor) != 0)
+		return collectYoung();
+
 	/* first, GC all non-const kinds */
 
 	GC_KIND(NotOptimized);
@@ -310,6 +455,9 @@ unsigned ExprAllocFastUnique::garbageCollect(void)
 
 	std::cerr << "[ExprAllocFastUnique] Non-const freed " << ret << '\n';
 
+	/* full sweep may have freed anything in the young list */
+	young_exprs.clear();
+
 	/* GC constants */
 	ret += ExprAlloc::garbageCollect();
 
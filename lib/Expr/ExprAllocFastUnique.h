@@ -13,6 +13,9 @@ public:
 	virtual ~ExprAllocFastUnique() {}
 
 	unsigned garbageCollect(void) override;
+	void armGC(void) override;
+	/* every ExprGCMajor'th collection is a full sweep */
+	static unsigned long getNumGCs(void) { return gc_c; }
 
 	int compare(const Expr& lhs, const Expr& rhs) override
 	{ return (&lhs == &rhs) ? 0 : ((long)&lhs - (long)&rhs); }
@@ -59,8 +62,12 @@ ref<Expr> x(const ref<Expr> &LHS, const ref<Expr> &RHS) override;
 #undef DECL_BIN_REF
 private:
 	ref<Expr> toFastUnique(ref<Expr>& e);
+	/* minor collection; sweeps only exprs made since the last GC */
+	unsigned collectYoung(void);
+
 	static unsigned long expr_miss_c;
 	static unsigned long expr_hit_c;
+	static unsigned long gc_c;
 };
 }
 
@@ -0,0 +1,451 @@
+#include <stdint.h>
+#include <string.h>
+#include "static/Sugar.h"
+#include "klee/Constraints.h"
+#include "klee/util/ExprBinary.h"
+
+using namespace klee;
+
+#define EBIN_ARRAY	'A'
+#define EBIN_UPDATE	'U'
+#define EBIN_EXPR	'E'
+#define EBIN_QUERY	'Q'
+#define EBIN_RESET	'R'
+
+/* Sanity caps for lengths read off the stream. Buffers only grow as
+ * their bytes are actually read, so a bogus length runs into EOF rather
+ * than a huge allocation. */
+#define EBIN_MAX_NAME	4096
+#define EBIN_MAX_WIDTH	(1u << 24)
+
+ExprBinWriter::ExprBinWriter(std::ostream& _os)
+: os(_os)
+{ os.write(EXPR_BIN_MAGIC, 4); }
+
+void ExprBinWriter::writeVarint(uint64_t v)
+{
+	while (v >= 0x80) {
+		os.put((char)((v & 0x7f) | 0x80));
+		v >>= 7;
+	}
+	os.put((char)v);
+}
+
+void ExprBinWriter::reset(void)
+{
+	expr_ids.clear();
+	arr_ids.clear();
+	un_ids.clear();
+	arrs.clear();
+	os.put(EBIN_RESET);
+}
+
+unsigned ExprBinWriter::writeArray(const Array* arr)
+{
+	std::map<const Array*, unsigned>::const_iterator	it;
+	std::vector<ref<ConstantExpr> >				v;
+	unsigned						id;
+
+	it = arr_ids.find(arr);
+	if (it != arr_ids.end())
+		return it->second;
+
+	os.put(EBIN_ARRAY);
+	writeVarint(arr->name.size());
+	os.write(arr->name.c_str(), arr->name.size());
+	writeVarint(arr->getSize());
+	os.put(arr->isConstantArray() ? 1 : 0);
+	if (arr->isConstantArray()) {
+		arr->getConstantValues(v);
+		assert (v.size() == arr->getSize());
+		foreach (vit, v.begin(), v.end())
+			os.put((char)(*vit)->getZExtValue(8));
+	}
+
+	id = arr_ids.size();
+	arr_ids[arr] = id;
+	arrs.push_back(ARR2REF(arr));
+	return id;
+}
+
+/* returns id+1 so 0 can mean the empty list */
+unsigned ExprBinWriter::writeUpdate(const Array* root, const UpdateNode* un)
+{
+	std::map<const UpdateNode*, unsigned>::const_iterator	it;
+	unsigned	next, root_id, idx, val, id;
+
+	if (un == NULL)
+		return 0;
+
+	it = un_ids.find(un);
+	if (it != un_ids.end())
+		return it->second + 1;
+
+	/* oldest first so the reader can extend in order */
+	next = writeUpdate(root, un->next);
+	root_id = writeArray(root);
+	idx = writeExpr(un->index);
+	val = writeExpr(un->value);
+
+	os.put(EBIN_UPDATE);
+	writeVarint(root_id);
+	writeVarint(next);
+	writeVarint(idx);
+	writeVarint(val);
+
+	id = un_ids.size();
+	un_ids[un] = id;
+	return id + 1;
+}
+
+unsigned ExprBinWriter::writeExpr(const ref<Expr>& e)
+{
+	ExprHashMap<unsigned>::const_iterator	it(expr_ids.find(e));
+	std::vector<unsigned>			kids;
+	unsigned				id, arr_id = 0, ul_id = 0;
+
+	if (it != expr_ids.end())
+		return it->second;
+
+	/* dependencies go out first */
+	if (const ReadExpr* re = dyn_cast<ReadExpr>(e)) {
+		arr_id = writeArray(re->updates.getRoot().get());
+		ul_id = writeUpdate(
+			re->updates.getRoot().get(), re->updates.head);
+	}
+
+	for (unsigned i = 0; i < e->getNumKids(); i++)
+		kids.push_back(writeExpr(e->getKid(i)));
+
+	os.put(EBIN_EXPR);
+	os.put((char)e->getKind());
+	writeVarint(e->getWidth());
+
+	switch (e->getKind()) {
+	case Expr::Constant: {
+		const llvm::APInt	&v(cast<ConstantExpr>(e)->getAPValue());
+		for (unsigned i = 0; i < v.getNumWords(); i++)
+			writeVarint(v.getRawData()[i]);
+		break;
+	}
+	case Expr::Read:
+		writeVarint(arr_id);
+		writeVarint(ul_id);
+		break;
+	case Expr::Extract:
+		writeVarint(cast<ExtractExpr>(e)->offset);
+		break;
+	default:
+		break;
+	}
+
+	foreach (kit, kids.begin(), kids.end())
+		writeVarint(*kit);
+
+	id = expr_ids.size();
+	expr_ids[e] = id;
+	return id;
+}
+
+void ExprBinWriter::writeQuery(const ConstraintManager& cs, const ref<Expr>& e)
+{ writeQuery(std::vector<ref<Expr> >(cs.begin(), cs.end()), e); }
+
+void ExprBinWriter::writeQuery(
+	const std::vector<ref<Expr> >& cs, const ref<Expr>& e)
+{
+	std::vector<unsigned>	ids;
+	unsigned		q_id;
+
+	foreach (it, cs.begin(), cs.end())
+		ids.push_back(writeExpr(*it));
+	q_id = writeExpr(e);
+
+	os.put(EBIN_QUERY);
+	writeVarint(ids.size());
+	foreach (it, ids.begin(), ids.end())
+		writeVarint(*it);
+	writeVarint(q_id);
+}
+
+ExprBinReader::ExprBinReader(std::istream& _is)
+: is(_is)
+, error(false)
+, got_magic(false)
+{}
+
+void ExprBinReader::reset(void)
+{
+	exprs.clear();
+	uls.clear();
+	arrs.clear();
+}
+
+bool ExprBinReader::readVarint(uint64_t& v)
+{
+	unsigned	shift = 0;
+	int		c;
+
+	v = 0;
+	do {
+		if ((c = is.get()) == EOF || shift > 63)
+			return false;
+		v |= ((uint64_t)(c & 0x7f)) << shift;
+		shift += 7;
+	} while (c & 0x80);
+
+	return true;
+}
+
+bool ExprBinReader::getExpr(uint64_t id, ref<Expr>& e) const
+{
+	if (id >= exprs.size())
+		return false;
+	e = exprs[id];
+	return true;
+}
+
+bool ExprBinReader::readArray(void)
+{
+	uint64_t	name_len, sz;
+	std::string	name;
+	int		is_const;
+
+	if (!readVarint(name_len) || name_len > EBIN_MAX_NAME)
+		return false;
+	name.resize(name_len);
+	if (name_len && !is.read(&name[0], name_len))
+		return false;
+	/* Array::create asserts on these */
+	if (!name.empty() && name[0] >= '0' && name[0] <= '9')
+		return false;
+
+	/* MallocKey sizes are 32 bits */
+	if (!readVarint(sz) || sz > UINT32_MAX || (is_const = is.get()) == EOF)
+		return false;
+
+	if (is_const) {
+		std::vector<ref<ConstantExpr> >	v;
+		for (uint64_t i = 0; i < sz; i++) {
+			int	c = is.get();
+			if (c == EOF)
+				return false;
+			v.push_back(ConstantExpr::create(c & 0xff, 8));
+		}
+		arrs.push_back(Array::create(
+			name, MallocKey(sz), v.data(), v.data() + v.size()));
+	} else {
+		arrs.push_back(Array::create(name, MallocKey(sz)));
+	}
+
+	return true;
+}
+
+bool ExprBinReader::readUpdate(void)
+{
+	uint64_t	root_id, next, idx_id, val_id;
+	ref<Expr>	idx, val;
+	UpdateList	*ul;
+
+	if (	!readVarint(root_id) || !readVarint(next) ||
+		!readVarint(idx_id) || !readVarint(val_id))
+		return false;
+
+	if (	root_id >= arrs.size() || next > uls.size() ||
+		!getExpr(idx_id, idx) || !getExpr(val_id, val))
+		return false;
+
+	if (idx->getWidth() != Expr::Int32 || val->getWidth() != Expr::Int8)
+		return false;
+
+	ul = (next == 0)
+		? new UpdateList(arrs[root_id], NULL)
+		: new UpdateList(*uls[next - 1]);
+	ul->extend(idx, val);
+	uls.push_back(std::unique_ptr<UpdateList>(ul));
+	return true;
+}
+
+/* the builders assert on ill-typed kids; a corrupt stream must fail
+ * here instead */
+static bool checkExpr(
+	Expr::Kind k, uint64_t w, uint64_t off,
+	const std::vector<ref<Expr> >& kids)
+{
+	switch (k) {
+	case Expr::Read:
+		return w == Expr::Int8 && kids[0]->getWidth() == Expr::Int32;
+	case Expr::NotOptimized:
+	case Expr::Not:
+		return w == kids[0]->getWidth();
+	case Expr::Extract:
+		return	off < kids[0]->getWidth() &&
+			w <= kids[0]->getWidth() - off;
+	case Expr::ZExt:
+	case Expr::SExt:
+		return w >= kids[0]->getWidth();
+	case Expr::Select:
+		return	kids[0]->getWidth() == Expr::Bool &&
+			kids[1]->getWidth() == kids[2]->getWidth() &&
+			w == kids[1]->getWidth();
+	case Expr::Concat:
+		return w == kids[0]->getWidth() + kids[1]->getWidth();
+	default:
+		break;
+	}
+
+	if (kids[0]->getWidth() != kids[1]->getWidth())
+		return false;
+
+	if (k >= Expr::CmpKindFirst && k <= Expr::CmpKindLast)
+		return w == Expr::Bool;
+
+	return w == kids[0]->getWidth();
+}
+
+bool ExprBinReader::readExpr(void)
+{
+	std::vector<ref<Expr> >	kids;
+	Expr::Kind		k;
+	uint64_t		w, a = 0, b = 0;
+	ref<Expr>		e;
+	int			c;
+
+	if ((c = is.get()) == EOF || !readVarint(w))
+		return false;
+	if (w == 0 || w > EBIN_MAX_WIDTH)
+		return false;
+	k = (Expr::Kind)c;
+
+	switch (k) {
+	case Expr::Constant: {
+		std::vector<uint64_t>	words;
+		for (uint64_t i = 0; i < (w + 63) / 64; i++) {
+			uint64_t	word;
+			if (!readVarint(word))
+				return false;
+			words.push_back(word);
+		}
+		exprs.push_back(ConstantExpr::alloc(llvm::APInt(w, words)));
+		return true;
+	}
+	case Expr::Read:
+		if (!readVarint(a) || !readVarint(b))
+			return false;
+		break;
+	case Expr::Extract:
+		if (!readVarint(a))
+			return false;
+		break;
+	default:
+		break;
+	}
+
+	/* kid count is fixed by the kind */
+	switch (k) {
+	case Expr::Read:
+	case Expr::NotOptimized:
+	case Expr::Extract:
+	case Expr::ZExt:
+	case Expr::SExt:
+	case Expr::Not:
+		kids.resize(1);
+		break;
+	case Expr::Select:
+		kids.resize(3);
+		break;
+	default:
+		if (k < Expr::Concat || k > Expr::BinaryKindLast)
+			return false;
+		kids.resize(2);
+		break;
+	}
+
+	foreach (it, kids.begin(), kids.end()) {
+		uint64_t	id;
+		if (!readVarint(id) || !getExpr(id, *it))
+			return false;
+	}
+
+	if (!checkExpr(k, w, a, kids))
+		return false;
+
+	switch (k) {
+	case Expr::Read:
+		if (a >= arrs.size() || b > uls.size())
+			return false;
+		e = ReadExpr::create(
+			(b == 0) ? UpdateList(arrs[a], NULL) : *uls[b - 1],
+			kids[0]);
+		break;
+	case Expr::Extract:
+		e = ExtractExpr::create(kids[0], a, w);
+		break;
+	case Expr::Not:
+		e = NotExpr::create(kids[0]);
+		break;
+	case Expr::ZExt:
+	case Expr::SExt:
+		e = Expr::createFromKind(k, {
+			Expr::CreateArg(kids[0]), Expr::CreateArg(w) });
+		break;
+	default: {
+		std::vector<Expr::CreateArg>	args;
+		foreach (it, kids.begin(), kids.end())
+			args.push_back(Expr::CreateArg(*it));
+		e = Expr::createFromKind(k, args);
+		break;
+	}
+	}
+
+	exprs.push_back(e);
+	return true;
+}
+
+bool ExprBinReader::readQuery(std::vector<ref<Expr> >& cs, ref<Expr>& e)
+{
+	int	c;
+
+	if (!got_magic) {
+		char	m[4];
+		if (!is.read(m, 4) || memcmp(m, EXPR_BIN_MAGIC, 4))
+			goto bad;
+		got_magic = true;
+	}
+
+	while ((c = is.get()) != EOF) {
+		bool	ok = true;
+
+		switch (c) {
+		case EBIN_ARRAY: ok = readArray(); break;
+		case EBIN_UPDATE: ok = readUpdate(); break;
+		case EBIN_EXPR: ok = readExpr(); break;
+		case EBIN_RESET: reset(); break;
+		case EBIN_QUERY: {
+			uint64_t	n, id;
+
+			cs.clear();
+			if (!readVarint(n))
+				goto bad;
+			for (unsigned i = 0; i < n; i++) {
+				ref<Expr>	ce;
+				if (!readVarint(id) || !getExpr(id, ce))
+					goto bad;
+				cs.push_back(ce);
+			}
+			if (!readVarint(id) || !getExpr(id, e))
+				goto bad;
+			return true;
+		}
+		default:
+			ok = false;
+		}
+
+		if (!ok)
+			goto bad;
+	}
+
+	return false;
+bad:
+	error = true;
+	return false;
+}
@@ -0,0 +1,231 @@
+//===-- ExprStore.cpp -----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/util/ExprStore.h"
+#include "klee/util/Assignment.h"
+
+using namespace klee;
+
+ExprStore::id_ty ExprStore::add(const ref<Expr>& e)
+{
+	roots.push_back(e);
+	return intern(e.get());
+}
+
+unsigned ExprStore::getArraySlot(const ref<Array>& arr)
+{
+	auto	it(array_slots.find(arr.get()));
+
+	if (it != array_slots.end())
+		return it->second;
+
+	array_slots.insert(std::make_pair(arr.get(), arrays.size()));
+	arrays.push_back(arr);
+	return arrays.size() - 1;
+}
+
+ExprStore::id_ty ExprStore::intern(const Expr* e)
+{
+	std::vector<id_ty>	ks;
+	uint64_t		x = 0;
+	auto			it(expr_ids.find(e));
+	id_ty			id;
+
+	if (it != expr_ids.end())
+		return it->second;
+
+	if (e->getWidth() > 64)
+		wide = true;
+
+	switch (e->getKind()) {
+	case Expr::Constant: {
+		const ConstantExpr	*ce = cast<ConstantExpr>(e);
+		if (ce->getWidth() <= 64)
+			x = ce->getZExtValue();
+		break;
+	}
+	case Expr::Read: {
+		const ReadExpr	*re = cast<ReadExpr>(e);
+
+		x = getArraySlot(re->updates.getRoot());
+		ks.push_back(intern(re->index.get()));
+		for (const UpdateNode *un = re->updates.head; un; un = un->next) {
+			ks.push_back(intern(un->index.get()));
+			ks.push_back(intern(un->value.get()));
+		}
+		break;
+	}
+	case Expr::Extract:
+		x = cast<ExtractExpr>(e)->offset;
+		/* fall through */
+	default:
+		for (unsigned i = 0; i < e->getNumKids(); i++)
+			ks.push_back(intern(e->getKid(i).get()));
+		break;
+	}
+
+	id = cons(e->getKind(), e->getWidth(), e->hash(), x, ks);
+	expr_ids.insert(std::make_pair(e, id));
+	return id;
+}
+
+ExprStore::id_ty ExprStore::cons(
+	Expr::Kind k, Expr::Width w, Expr::Hash h, uint64_t x,
+	const std::vector<id_ty>& ks)
+{
+	uint64_t	key;
+	id_ty		id;
+
+	key = ((uint64_t)k << 56) ^ ((uint64_t)w << 40);
+	key ^= x * 0x9e3779b97f4a7c15ULL;
+	for (auto kid : ks)
+		key = (key ^ kid) * 0x100000001b3ULL;
+
+	auto range(cons_tab.equal_range(key));
+	for (auto it = range.first; it != range.second; ++it) {
+		id_ty	c = it->second;
+
+		if (	kinds[c] != k || widths[c] != w || aux[c] != x ||
+			getNumKids(c) != ks.size())
+			continue;
+
+		if (std::equal(ks.begin(), ks.end(), kids.begin() + kid_off[c]))
+			return c;
+	}
+
+	id = kinds.size();
+	kinds.push_back(k);
+	widths.push_back(w);
+	hashes.push_back(h);
+	aux.push_back(x);
+	kids.insert(kids.end(), ks.begin(), ks.end());
+	kid_off.push_back(kids.size());
+	cons_tab.insert(std::make_pair(key, id));
+	return id;
+}
+
+bool ExprStore::evaluate(const Assignment& a, std::vector<uint64_t>& vals) const
+{
+	if (wide)
+		return false;
+
+	vals.resize(size());
+	for (id_ty i = 0; i < size(); i++)
+		if (!evalNode(i, a, vals))
+			return false;
+
+	return true;
+}
+
+/* same order as ExprEvaluator::evalRead: updates, constant array, binding */
+uint64_t ExprStore::readByte(
+	id_ty i, uint64_t idx,
+	const Assignment& a, const std::vector<uint64_t>& vals,
+	bool& ok) const
+{
+	const Array				*arr;
+	const std::vector<unsigned char>	*b;
+	unsigned				n = getNumKids(i);
+
+	for (unsigned k = 1; k + 1 < n; k += 2)
+		if (vals[getKid(i, k)] == idx)
+			return vals[getKid(i, k + 1)];
+
+	arr = getArray(i);
+	if (arr->isConstantArray() && idx < arr->mallocKey.size)
+		return arr->getValue(idx)->getZExtValue();
+
+	b = a.getBinding(arr);
+	if (b != NULL && idx < b->size())
+		return (*b)[idx];
+
+	if (a.allowFreeValues)
+		ok = false;
+
+	return 0;
+}
+
+bool ExprStore::evalNode(
+	id_ty i, const Assignment& a, std::vector<uint64_t>& vals) const
+{
+	Expr::Width	w = widths[i], kw = w;
+	uint64_t	l = 0, r = 0, v;
+	unsigned	n = getNumKids(i);
+	bool		ok = true;
+
+	if (n > 0) {
+		l = vals[getKid(i, 0)];
+		kw = widths[getKid(i, 0)];
+	}
+	if (n > 1) r = vals[getKid(i, 1)];
+
+	switch (getKind(i)) {
+	case Expr::Constant: v = aux[i]; break;
+	case Expr::NotOptimized: v = l; break;
+	case Expr::Read: v = readByte(i, l, a, vals, ok); break;
+	case Expr::Select: v = (l) ? r : vals[getKid(i, 2)]; break;
+	case Expr::Concat:
+		v = (l << widths[getKid(i, 1)]) | r;
+		break;
+	case Expr::Extract: v = l >> aux[i]; break;
+	case Expr::ZExt: v = l; break;
+	case Expr::SExt: v = sext(l, kw); break;
+
+	case Expr::Add: v = l + r; break;
+	case Expr::Sub: v = l - r; break;
+	case Expr::Mul: v = l * r; break;
+	case Expr::UDiv:
+		if (r == 0) return false;
+		v = l / r;
+		break;
+	case Expr::URem:
+		if (r == 0) return false;
+		v = l % r;
+		break;
+	case Expr::SDiv:
+	case Expr::SRem: {
+		int64_t	sl = sext(l, w), sr = sext(r, w);
+		if (sr == 0) return false;
+		/* INT_MIN / -1 wraps, as APInt does */
+		if (sr == -1)
+			v = (getKind(i) == Expr::SDiv) ? -(uint64_t)sl : 0;
+		else
+			v = (getKind(i) == Expr::SDiv) ? sl / sr : sl % sr;
+		break;
+	}
+
+	case Expr::Not: v = ~l; break;
+	case Expr::And: v = l & r; break;
+	case Expr::Or: v = l | r; break;
+	case Expr::Xor: v = l ^ r; break;
+	case Expr::Shl: v = (r >= w) ? 0 : l << r; break;
+	case Expr::LShr: v = (r >= w) ? 0 : l >> r; break;
+	case Expr::AShr:
+		if (w == 1) v = l;
+		else v = sext(l, w) >> ((r >= w) ? w - 1 : r);
+		break;
+
+	case Expr::Eq: v = l == r; break;
+	case Expr::Ne: v = l != r; break;
+	case Expr::Ult: v = l < r; break;
+	case Expr::Ule: v = l <= r; break;
+	case Expr::Ugt: v = l > r; break;
+	case Expr::Uge: v = l >= r; break;
+	case Expr::Slt: v = sext(l, kw) < sext(r, kw); break;
+	case Expr::Sle: v = sext(l, kw) <= sext(r, kw); break;
+	case Expr::Sgt: v = sext(l, kw) > sext(r, kw); break;
+	case Expr::Sge: v = sext(l, kw) >= sext(r, kw); break;
+
+	default:
+		return false;
+	}
+
+	vals[i] = mask(v, w);
+	return ok;
+}
@@ -3,6 +3,8 @@
 #include "klee/Constraints.h"
 #include "klee/Query.h"
 
+#include <algorithm>
+
 using namespace klee;
 
 void IndependentElementSet::print(std::ostream& os) const
@@ -199,4 +201,243 @@ IndependentElementSet IndependentElementSet::getIndependentConstraints(
 	cs = ConstraintManager(constrs, rs);
 
 	return eltsClosure;
-}
\ No newline at end of file
+}
+/* 0 => ignore, 1 => concrete offset, 2 => whole array */
+static int classifyRead(
+	const ref<ReadExpr>& re, const Array* &arr, unsigned& off)
+{
+	const ConstantExpr	*ce;
+
+	arr = re->updates.getRoot().get();
+	if (arr->isConstantArray() && re->updates.head == NULL)
+		return 0;
+
+	ce = dyn_cast<ConstantExpr>(re->index);
+	if (ce == NULL)
+		return 2;
+
+	off = ce->getZExtValue(32);
+	return 1;
+}
+
+ConstraintPartition::ConstraintPartition(
+	std::shared_ptr<const ConstraintPartition> _base)
+: base(_base)
+, base_n(_base->size())
+, depth(_base->depth + 1)
+, num_groups(_base->num_groups)
+{}
+
+unsigned ConstraintPartition::getParent(unsigned i) const
+{
+	const ConstraintPartition	*cp = this;
+
+	while (i < cp->base_n) {
+		auto	it(cp->parent_delta.find(i));
+		if (it != cp->parent_delta.end())
+			return it->second;
+		cp = cp->base.get();
+	}
+
+	return cp->parent[i - cp->base_n];
+}
+
+void ConstraintPartition::setParent(unsigned i, unsigned p)
+{
+	if (i >= base_n)
+		parent[i - base_n] = p;
+	else
+		parent_delta[i] = p;
+}
+
+/* a root here was a root in every base that has it */
+unsigned ConstraintPartition::getGroupSize(unsigned root) const
+{
+	unsigned	n = 0;
+
+	for (const ConstraintPartition *cp = this; cp; cp = cp->base.get()) {
+		auto	it(cp->members.find(root));
+		if (it != cp->members.end())
+			n += it->second.size();
+		if (root >= cp->base_n)
+			break;
+	}
+
+	return n;
+}
+
+void ConstraintPartition::getMembers(
+	unsigned root, std::vector<unsigned>& ret) const
+{
+	for (const ConstraintPartition *cp = this; cp; cp = cp->base.get()) {
+		auto	it(cp->members.find(root));
+		if (it != cp->members.end())
+			ret.insert(ret.end(), it->second.begin(), it->second.end());
+		if (root >= cp->base_n)
+			break;
+	}
+}
+
+bool ConstraintPartition::getElemOwner(
+	const elem_ty& e, unsigned& owner) const
+{
+	for (const ConstraintPartition *cp = this; cp; cp = cp->base.get()) {
+		auto	it(cp->elem_owner.find(e));
+		if (it != cp->elem_owner.end()) {
+			owner = it->second;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool ConstraintPartition::getWholeOwner(
+	const Array* arr, unsigned& owner) const
+{
+	for (const ConstraintPartition *cp = this; cp; cp = cp->base.get()) {
+		auto	it(cp->arr_whole.find(arr));
+		if (it != cp->arr_whole.end()) {
+			owner = it->second;
+			return true;
+		}
+	}
+	return false;
+}
+
+/* only meaningful while the array has no whole owner */
+bool ConstraintPartition::getUsers(
+	const Array* arr, std::vector<unsigned>& ret) const
+{
+	bool	found = false;
+
+	for (const ConstraintPartition *cp = this; cp; cp = cp->base.get()) {
+		auto	it(cp->arr_users.find(arr));
+		if (it == cp->arr_users.end())
+			continue;
+		ret.insert(ret.end(), it->second.begin(), it->second.end());
+		found = true;
+	}
+
+	return found;
+}
+
+void ConstraintPartition::unite(unsigned a, unsigned b)
+{
+	a = find(a);
+	b = find(b);
+	if (a == b)
+		return;
+
+	/* union by size keeps find() logarithmic without compression */
+	if (getGroupSize(a) < getGroupSize(b))
+		std::swap(a, b);
+
+	setParent(b, a);
+	getMembers(b, members[a]);
+	members.erase(b);
+	num_groups--;
+}
+
+void ConstraintPartition::touchWhole(const Array* arr, unsigned idx)
+{
+	std::vector<unsigned>	users;
+	unsigned		owner;
+
+	if (getWholeOwner(arr, owner)) {
+		unite(owner, idx);
+		return;
+	}
+
+	/* base's users are dead once arr_whole is set; only drop ours */
+	if (getUsers(arr, users)) {
+		for (auto u : users)
+			unite(u, idx);
+		arr_users.erase(arr);
+	}
+
+	arr_whole[arr] = idx;
+}
+
+void ConstraintPartition::touchElem(
+	const Array* arr, unsigned off, unsigned idx)
+{
+	elem_ty		e(arr, off);
+	unsigned	owner;
+
+	if (getWholeOwner(arr, owner)) {
+		unite(owner, idx);
+		return;
+	}
+
+	if (getElemOwner(e, owner))
+		unite(owner, idx);
+	else
+		elem_owner[e] = idx;
+
+	/* earlier users all have smaller indices, so only ours can be idx */
+	std::vector<unsigned>	&users(arr_users[arr]);
+	if (users.empty() || users.back() != idx)
+		users.push_back(idx);
+}
+
+void ConstraintPartition::add(unsigned idx, const ReadSet& rs)
+{
+	assert (idx == size());
+
+	parent.push_back(idx);
+	members[idx].push_back(idx);
+	num_groups++;
+
+	for (const auto& re : rs) {
+		const Array	*arr;
+		unsigned	off;
+
+		switch (classifyRead(re, arr, off)) {
+		case 1: touchElem(arr, off, idx); break;
+		case 2: touchWhole(arr, idx); break;
+		default: break;
+		}
+	}
+}
+
+void ConstraintPartition::addRoots(
+	const ReadSet& rs,
+	std::unordered_set<unsigned>& roots) const
+{
+	for (const auto& re : rs) {
+		const Array	*arr;
+		unsigned	off, owner;
+		int		k;
+
+		if ((k = classifyRead(re, arr, off)) == 0)
+			continue;
+
+		if (getWholeOwner(arr, owner)) {
+			roots.insert(find(owner));
+			continue;
+		}
+
+		if (k == 2) {
+			std::vector<unsigned>	users;
+			getUsers(arr, users);
+			for (auto u : users)
+				roots.insert(find(u));
+			continue;
+		}
+
+		if (getElemOwner(elem_ty(arr, off), owner))
+			roots.insert(find(owner));
+	}
+}
+
+void ConstraintPartition::getDependent(
+	const ReadSet& rs, std::vector<unsigned>& ret) const
+{
+	std::unordered_set<unsigned>	roots;
+
+	ret.clear();
+	addRoots(rs, roots);
+	for (auto r : roots)
+		getMembers(r, ret);
+	std::sort(ret.begin(), ret.end());
+}
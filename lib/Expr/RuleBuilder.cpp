@@ -17,6 +17,7 @@
 #include "static/Sugar.h"
 #include "ExprRule.h"
 #include "RuleBuilder.h"
+#include "RuleDBImage.h"
 #include "CanonBuilder.h"
 
 using namespace klee;
@@ -55,6 +56,13 @@ namespace {
 		cl::desc("Rule database file"),
 		cl::init("brule.db"));
 
+	cl::opt<std::string>
+	RuleImageFile(
+		"rule-image",
+		cl::desc("Compiled rule image (from kopt -compile-rules) "
+			 "to map instead of loading the rule database"),
+		cl::init(""));
+
 	cl::opt<bool>
 	ApplyAllRules(
 		"try-all-rules",
@@ -87,7 +95,7 @@ const ExprRule* RuleBuilder::last_er = NULL;
 std::set<const ExprRule*> RuleBuilder::rules_used;
 
 RuleBuilder::RuleBuilder(ExprBuilder* base)
-: eb(base), depth(0), recur(0), rule_ofs(0)
+: rule_img(NULL), eb(base), depth(0), recur(0), rule_ofs(0)
 {
 	if (DumpRuleMiss)
 		mkdir("miss_dump", 0777);
@@ -112,6 +120,7 @@ RuleBuilder::~RuleBuilder()
 		delete (*it);
 
 	rules_arr.clear();
+	delete rule_img;
 	delete eb;
 }
 
@@ -144,6 +153,21 @@ void RuleBuilder::loadRules()
 	bool			ok;
 	const std::string*	load_s;
 
+	load_s = &RuleImageFile;
+	ok = loadRuleImage(RuleImageFile.c_str());
+	if (ok) {
+		std::cerr
+			<< "[RuleBuilder] Mapped " << rule_img->getNumRules()
+			<< " rules from " << *load_s << ".\n";
+		/* an image has no skeleton hash table */
+		if (ApplyRuleHash) {
+			std::cerr << "[RuleBuilder] Hash rules are off "
+				"with -rule-image; using the trie.\n";
+			ApplyRuleHash = false;
+		}
+		return;
+	}
+
 	load_s = &getDBPath();
 	ok = loadRuleDB(getDBPath().c_str());
 	if (!ok) {
@@ -268,6 +292,26 @@ bool RuleBuilder::loadRuleDB(const char* rulef)
 	return false;
 }
 
+bool RuleBuilder::loadRuleImage(const char* imgfile)
+{
+	if (*imgfile == '\0')
+		return false;
+
+	rule_img = RuleDBImage::open(imgfile);
+	return rule_img != NULL;
+}
+
+bool RuleBuilder::writeRuleImage(const char* fname) const
+{
+	std::ofstream	ofs(fname, std::ios::out | std::ios::binary);
+
+	assert (rule_img == NULL && "Recompiling a compiled image");
+	if (!ofs.good())
+		return false;
+
+	return RuleDBImage::write(ofs, rules_arr);
+}
+
 void RuleBuilder::addRule(ExprRule* er)
 {
 	if (er == NULL)
@@ -375,10 +419,12 @@ ref<Expr> RuleBuilder::tryApplyRules(const ref<Expr>& in)
 	return ret;
 }
 
+/* walks either the heap trie or a mapped RuleDBImage */
+template <class T>
 class TrieRuleIterator : public ExprPatternMatch::RuleIterator
 {
 public:
-	TrieRuleIterator(const RuleBuilder::ruletrie_ty& _rt)
+	TrieRuleIterator(const T& _rt)
 	: rt(_rt), found_rule(NULL), label_depth(0)
 	{}
 
@@ -401,7 +447,7 @@ public:
 	{
 		bool	is_matched;
 
-		if (isDone()) return false;
+		if (isDone() || it == rt.end()) return false;
 
 		it.next(v);
 		if (it.isFound())
@@ -444,22 +490,25 @@ public:
 	virtual ExprRule* getExprRule(void) const { return found_rule; }
 private:
 	/* we use this to choose whether to seek out a label or not */
-	const RuleBuilder::ruletrie_ty	&rt;
+	const T				&rt;
 	ExprRule			*found_rule;
 	std::vector<uint64_t>		last_label_v;
 	unsigned			label_depth;
-	RuleBuilder::ruletrie_ty::const_iterator	it;
+	typename T::const_iterator	it;
 };
 
-bool TrieRuleIterator::matchLabel(uint64_t& v)
+template <class T>
+bool TrieRuleIterator<T>::matchLabel(uint64_t& v)
 {
-	if (found_rule)
+	/* a leaf whose rule didn't load ends the walk too */
+	if (found_rule || it == rt.end())
 		return false;
 
 	return matchLabel(v, OP_EXT_VAR);
 }
 
-bool TrieRuleIterator::matchLabel(uint64_t& v, uint64_t mask)
+template <class T>
+bool TrieRuleIterator<T>::matchLabel(uint64_t& v, uint64_t mask)
 {
 	bool		found_label;
 	uint64_t	target_label;
@@ -499,19 +548,21 @@ bool TrieRuleIterator::matchLabel(uint64_t& v, uint64_t mask)
 	return found_label;
 }
 
-ref<Expr> RuleBuilder::tryTrieRules(const ref<Expr>& in)
+template <class T>
+static ref<Expr> applyTrie(
+	const T& t, const ref<Expr>& in, const ExprRule* &er, uint64_t& miss_c)
 {
-	TrieRuleIterator	tri(rules_trie);
+	TrieRuleIterator<T>	tri(t);
 	ref<Expr>		new_expr(0);
 
 	while (1) {
 		new_expr = ExprRule::apply(in, tri);
 		if (new_expr.isNull() == false) {
-			updateLastRule(tri.getExprRule());
+			er = tri.getExprRule();
 			return new_expr;
 		}
 
-		rule_miss_c++;
+		miss_c++;
 
 		if (tri.bumpSlot() == false)
 			break;
@@ -520,9 +571,42 @@ ref<Expr> RuleBuilder::tryTrieRules(const ref<Expr>& in)
 	return in;
 }
 
+ref<Expr> RuleBuilder::tryTrieRules(const ref<Expr>& in)
+{
+	const ExprRule	*er = NULL;
+	ref<Expr>	ret;
+
+	ret = (rule_img != NULL)
+		? applyTrie(*rule_img, in, er, rule_miss_c)
+		: applyTrie(rules_trie, in, er, rule_miss_c);
+	if (er != NULL)
+		updateLastRule(er);
+
+	return ret;
+}
+
 ref<Expr> RuleBuilder::tryAllRules(const ref<Expr>& in)
 {
 	std::cerr << "TRYING ALL RULES for " << in << "\n";
+	if (rule_img != NULL) {
+		for (unsigned i = 0; i < rule_img->getNumRules(); i++) {
+			ExprRule	*er = rule_img->getRule(i);
+			ref<Expr>	new_expr;
+
+			if (er == NULL)
+				continue;
+
+			new_expr = er->apply(in);
+			if (!new_expr.isNull()) {
+				updateLastRule(er);
+				return new_expr;
+			}
+
+			rule_miss_c++;
+		}
+		return in;
+	}
+
 	foreach (it, rules_arr.begin(), rules_arr.end()) {
 		ExprRule	*er = *it;
 		ref<Expr>	new_expr;
@@ -10,6 +10,7 @@
 namespace klee
 {
 class ExprRule;
+class RuleDBImage;
 
 class RuleBuilder : public ExprBuilder
 {
@@ -174,6 +175,10 @@ virtual ref<Expr> x(const ref<Expr> &LHS, const ref<Expr> &RHS)	\
 
 	void addRule(ExprRule* er);
 
+	/* compile loaded rules into an image for -rule-image */
+	bool writeRuleImage(const char* fname) const;
+	bool hasRuleImage(void) const { return rule_img != NULL; }
+
 	static RuleBuilder* create(ExprBuilder* b, const char* fname = NULL);
 
 	virtual void printName(std::ostream& os) const;
@@ -184,6 +189,7 @@ private:
 	bool loadRuleDir(const char* ruledir);
 	bool loadRuleDB(const char* rulefile);
 	bool loadRuleStream(std::istream& is);
+	bool loadRuleImage(const char* imgfile);
 
 	void addRuleHash(const ExprRule* er);
 	void updateLastRule(const ExprRule* er);
@@ -203,6 +209,9 @@ private:
 	ruletrie_ty		rules_trie;
 	std::vector<ExprRule*>	rules_arr;
 
+	/* mapped compiled rules; replaces the trie and the arrays */
+	RuleDBImage		*rule_img;
+
 	/* skeletal hash lookup */
 	/* XXX: this is missing buckets for collisions;
 	 * this will miss a lot of rules in the same equiv class */
@@ -0,0 +1,336 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <assert.h>
+#include <algorithm>
+#include <streambuf>
+#include <sstream>
+#include <map>
+
+#include "static/Sugar.h"
+#include "ExprRule.h"
+#include "RuleDBImage.h"
+
+using namespace klee;
+
+namespace
+{
+/* read-only istream source over one mapped rule record */
+class RecordBuf : public std::streambuf
+{
+public:
+	RecordBuf(const uint8_t* p, size_t n)
+	{
+		char	*b = const_cast<char*>((const char*)p);
+		setg(b, b, b + n);
+	}
+protected:
+	pos_type seekoff(
+		off_type off,
+		std::ios_base::seekdir dir,
+		std::ios_base::openmode which)
+	{
+		char	*p;
+
+		if (dir == std::ios_base::beg) p = eback() + off;
+		else if (dir == std::ios_base::cur) p = gptr() + off;
+		else p = egptr() + off;
+
+		if (p < eback() || p > egptr())
+			return pos_type(off_type(-1));
+
+		setg(eback(), p, egptr());
+		return pos_type(p - eback());
+	}
+
+	pos_type seekpos(pos_type pos, std::ios_base::openmode which)
+	{ return seekoff(off_type(pos), std::ios_base::beg, which); }
+};
+
+/* trie under construction; node 0 is the root */
+struct BuildNode
+{
+	std::map<uint64_t, unsigned>	kids;
+	std::map<uint64_t, unsigned>	leafs;
+};
+}
+
+RuleDBImage::RuleDBImage(const uint8_t* _base, size_t _len)
+: base(_base)
+, len(_len)
+, hdr((const Header*)_base)
+, loaded_c(0)
+{
+	nodes = (const Node*)(base + sizeof(Header));
+	kids = (const Edge*)(nodes + hdr->node_c);
+	leafs = kids + hdr->kid_c;
+	rule_offs = (const uint64_t*)(leafs + hdr->leaf_c);
+	blob = (const uint8_t*)(rule_offs + hdr->rule_c + 1);
+}
+
+RuleDBImage::~RuleDBImage()
+{
+	foreach (it, rules.begin(), rules.end())
+		delete (*it);
+	munmap(const_cast<uint8_t*>(base), len);
+}
+
+RuleDBImage* RuleDBImage::open(const char* path)
+{
+	RuleDBImage	*img;
+	struct stat	s;
+	void		*p;
+	int		fd;
+
+	fd = ::open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	if (fstat(fd, &s) != 0 || (size_t)s.st_size < sizeof(Header)) {
+		close(fd);
+		return NULL;
+	}
+
+	p = mmap(NULL, s.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED)
+		return NULL;
+
+	if (((const Header*)p)->magic != RDB_MAGIC ||
+	    ((const Header*)p)->version != RDB_VERSION)
+	{
+		munmap(p, s.st_size);
+		return NULL;
+	}
+
+	img = new RuleDBImage((const uint8_t*)p, s.st_size);
+	if (!img->validate()) {
+		std::cerr << "[RuleDBImage] Corrupt image " << path << '\n';
+		delete img;
+		return NULL;
+	}
+
+	img->rules.resize(img->hdr->rule_c, NULL);
+	img->bad_rules.resize(img->hdr->rule_c, false);
+	return img;
+}
+
+bool RuleDBImage::validate(void) const
+{
+	uint64_t	need;
+
+	need =	sizeof(Header) +
+		(uint64_t)hdr->node_c * sizeof(Node) +
+		((uint64_t)hdr->kid_c + hdr->leaf_c) * sizeof(Edge) +
+		((uint64_t)hdr->rule_c + 1) * sizeof(uint64_t) +
+		hdr->blob_len;
+	if (need > len || hdr->node_c == 0)
+		return false;
+
+	/* the iterator follows these without checking */
+	for (unsigned i = 0; i < hdr->node_c; i++) {
+		const Node	*nd = &nodes[i];
+
+		if (	(uint64_t)nd->kid_off + nd->kid_c > hdr->kid_c ||
+			(uint64_t)nd->leaf_off + nd->leaf_c > hdr->leaf_c)
+			return false;
+	}
+
+	for (unsigned i = 0; i < hdr->kid_c; i++)
+		if (kids[i].v >= hdr->node_c)
+			return false;
+
+	for (unsigned i = 0; i < hdr->leaf_c; i++)
+		if (leafs[i].v >= hdr->rule_c)
+			return false;
+
+	/* records are back to back, so a bad offset means a bad length */
+	if (rule_offs[0] != 0)
+		return false;
+	for (unsigned i = 0; i < hdr->rule_c; i++)
+		if (rule_offs[i] > rule_offs[i+1])
+			return false;
+
+	return rule_offs[hdr->rule_c] == hdr->blob_len;
+}
+
+ExprRule* RuleDBImage::getRule(unsigned idx) const
+{
+	ExprRule	*er;
+
+	if (idx >= hdr->rule_c || bad_rules[idx])
+		return NULL;
+
+	if (rules[idx] != NULL)
+		return rules[idx];
+
+	RecordBuf	rb(	blob + rule_offs[idx],
+				rule_offs[idx+1] - rule_offs[idx]);
+	std::istream	is(&rb);
+
+	/* offsets were checked at open(); the records weren't */
+	er = ExprRule::loadBinaryRule(is);
+	if (er == NULL) {
+		std::cerr << "[RuleDBImage] Corrupt rule " << idx << '\n';
+		bad_rules[idx] = true;
+		return NULL;
+	}
+
+	rules[idx] = er;
+	loaded_c++;
+	return er;
+}
+
+const RuleDBImage::Edge* RuleDBImage::lowerBound(
+	const Edge* e, unsigned c, uint64_t k) const
+{
+	return std::lower_bound(e, e + c, k,
+		[] (const Edge& a, uint64_t b) { return a.k < b; });
+}
+
+void RuleDBImage::const_iterator::next(uint64_t k)
+{
+	const Node	*nd;
+	const Edge	*e;
+
+	assert (n != RDB_NONE);
+	nd = &img->nodes[n];
+
+	e = img->lowerBound(img->kids + nd->kid_off, nd->kid_c, k);
+	if (e != img->kids + nd->kid_off + nd->kid_c && e->k == k) {
+		n = e->v;
+		depth++;
+		return;
+	}
+
+	e = img->lowerBound(img->leafs + nd->leaf_off, nd->leaf_c, k);
+	if (e != img->leafs + nd->leaf_off + nd->leaf_c && e->k == k) {
+		found = true;
+		rule = e->v;
+		depth++;
+	}
+
+	n = RDB_NONE;
+}
+
+bool RuleDBImage::const_iterator::tryNextMin(uint64_t k, uint64_t& found_k)
+{
+	const Node	*nd;
+	const Edge	*e;
+
+	assert (n != RDB_NONE);
+	nd = &img->nodes[n];
+
+	e = img->lowerBound(img->kids + nd->kid_off, nd->kid_c, k);
+	if (e != img->kids + nd->kid_off + nd->kid_c) {
+		found_k = e->k;
+		n = e->v;
+		depth++;
+		return true;
+	}
+
+	e = img->lowerBound(img->leafs + nd->leaf_off, nd->leaf_c, k);
+	if (e != img->leafs + nd->leaf_off + nd->leaf_c) {
+		found_k = e->k;
+		found = true;
+		rule = e->v;
+		n = RDB_NONE;
+		depth++;
+		return true;
+	}
+
+	return false;
+}
+
+ExprRule* RuleDBImage::const_iterator::get(void) const
+{
+	assert (found);
+	return img->getRule(rule);
+}
+
+void RuleDBImage::const_iterator::dump(std::ostream& os) const
+{
+	os << "[RuleDBImageIt] depth: " << depth << " node: " << n << '\n';
+	if (found)
+		os << "[RuleDBImageIt] rule: " << rule << '\n';
+}
+
+bool RuleDBImage::write(std::ostream& os, const std::vector<ExprRule*>& rs)
+{
+	std::vector<BuildNode>	bn(1);
+	std::vector<Node>	out_nodes;
+	std::vector<Edge>	out_kids, out_leafs;
+	std::vector<uint64_t>	offs;
+	std::stringstream	blob_ss;
+	std::string		blob_s;
+	Header			h;
+
+	for (unsigned i = 0; i < rs.size(); i++) {
+		flatrule_ty	k(rs[i]->getFromPattern().stripConstExamples());
+		unsigned	cur = 0;
+
+		offs.push_back(blob_ss.tellp());
+		rs[i]->printBinaryRule(blob_ss);
+
+		if (k.empty())
+			continue;
+
+		for (unsigned j = 0; j < k.size() - 1; j++) {
+			std::map<uint64_t, unsigned>::iterator	it;
+
+			it = bn[cur].kids.find(k[j]);
+			if (it != bn[cur].kids.end()) {
+				cur = it->second;
+				continue;
+			}
+
+			bn[cur].kids[k[j]] = bn.size();
+			cur = bn.size();
+			bn.push_back(BuildNode());
+		}
+
+		/* first rule with a key wins, like Trie::add */
+		bn[cur].leafs.insert(std::make_pair(k.back(), i));
+	}
+	offs.push_back(blob_ss.tellp());
+	blob_s = blob_ss.str();
+
+	foreach (it, bn.begin(), bn.end()) {
+		Node	nd;
+
+		nd.kid_off = out_kids.size();
+		nd.kid_c = it->kids.size();
+		nd.leaf_off = out_leafs.size();
+		nd.leaf_c = it->leafs.size();
+		out_nodes.push_back(nd);
+
+		foreach (it2, it->kids.begin(), it->kids.end()) {
+			Edge	e = { it2->first, it2->second, 0 };
+			out_kids.push_back(e);
+		}
+
+		foreach (it2, it->leafs.begin(), it->leafs.end()) {
+			Edge	e = { it2->first, it2->second, 0 };
+			out_leafs.push_back(e);
+		}
+	}
+
+	h.magic = RDB_MAGIC;
+	h.version = RDB_VERSION;
+	h.rule_c = rs.size();
+	h.node_c = out_nodes.size();
+	h.kid_c = out_kids.size();
+	h.leaf_c = out_leafs.size();
+	h.pad = 0;
+	h.blob_len = blob_s.size();
+
+	os.write((const char*)&h, sizeof(h));
+	os.write((const char*)out_nodes.data(), out_nodes.size()*sizeof(Node));
+	os.write((const char*)out_kids.data(), out_kids.size()*sizeof(Edge));
+	os.write((const char*)out_leafs.data(), out_leafs.size()*sizeof(Edge));
+	os.write((const char*)offs.data(), offs.size()*sizeof(uint64_t));
+	os.write(blob_s.data(), blob_s.size());
+
+	return os.good();
+}
@@ -0,0 +1,116 @@
+#ifndef RULEDBIMAGE_H
+#define RULEDBIMAGE_H
+
+#include <stdint.h>
+#include <iostream>
+#include <vector>
+
+namespace klee
+{
+class ExprRule;
+
+/* Compiled rule database, written by kopt and mapped read-only by
+ * RuleBuilder.
+ *
+ * The image is the rule trie flattened into offset-linked arrays, followed
+ * by every rule's binary record. Nothing in it is a pointer, so all
+ * processes mapping the same file share one copy in the page cache. A rule
+ * is only parsed into an ExprRule the first time the trie hands it out,
+ * so loading costs one mmap and one pass over the trie and the rule
+ * offsets to check every index; that pass grows with the image, but no
+ * rule is parsed at load. A record that fails to parse reads as no rule.
+ *
+ * Each node keeps its child edges and its leaf edges in two separate sorted
+ * arrays, because the matcher looks in the children first and only then
+ * in the leaves. Trie tails become chains of single-child nodes. */
+#define RDB_MAGIC	0x314244454c55524bULL	/* "KRULEDB1" */
+#define RDB_VERSION	1
+#define RDB_NONE	(~0U)
+
+class RuleDBImage
+{
+public:
+	static RuleDBImage* open(const char* path);
+	static bool write(
+		std::ostream& os, const std::vector<ExprRule*>& rules);
+	virtual ~RuleDBImage();
+
+	unsigned getNumRules(void) const { return hdr->rule_c; }
+	unsigned getNumLoaded(void) const { return loaded_c; }
+	/* NULL if idx is out of range or its record is corrupt */
+	ExprRule* getRule(unsigned idx) const;
+
+	class const_iterator
+	{
+	public:
+		const_iterator(const RuleDBImage* _img = 0, unsigned _n = RDB_NONE)
+		: img(_img), n(_n), depth(0), found(false), rule(RDB_NONE) {}
+
+		bool operator ==(const const_iterator& it) const
+		{ return n == it.n; }
+		bool operator !=(const const_iterator& it) const
+		{ return n != it.n; }
+
+		void next(uint64_t k);
+		bool tryNextMin(uint64_t k, uint64_t& found_k);
+		bool isFound(void) const { return found; }
+		ExprRule* get(void) const;
+		void dump(std::ostream& os) const;
+	private:
+		const RuleDBImage	*img;
+		unsigned		n;
+		unsigned		depth;
+		bool			found;
+		unsigned		rule;
+	};
+
+	const_iterator begin(void) const { return const_iterator(this, 0); }
+	const_iterator end(void) const { return const_iterator(this); }
+private:
+	struct Header
+	{
+		uint64_t	magic;
+		uint32_t	version;
+		uint32_t	rule_c;
+		uint32_t	node_c;
+		uint32_t	kid_c;
+		uint32_t	leaf_c;
+		uint32_t	pad;
+		uint64_t	blob_len;
+	};
+
+	struct Node
+	{
+		uint32_t	kid_off, kid_c;
+		uint32_t	leaf_off, leaf_c;
+	};
+
+	/* 'v' is a node index for kids, a rule index for leaves */
+	struct Edge
+	{
+		uint64_t	k;
+		uint32_t	v;
+		uint32_t	pad;
+	};
+
+	RuleDBImage(const uint8_t* _base, size_t _len);
+	bool validate(void) const;
+
+	const Edge* lowerBound(const Edge* e, unsigned c, uint64_t k) const;
+
+	const uint8_t		*base;
+	size_t			len;
+	const Header		*hdr;
+	const Node		*nodes;
+	const Edge		*kids;
+	const Edge		*leafs;
+	const uint64_t		*rule_offs;	/* rule_c + 1 entries */
+	const uint8_t		*blob;
+
+	mutable std::vector<ExprRule*>	rules;
+	mutable std::vector<bool>	bad_rules;
+	mutable unsigned		loaded_c;
+};
+}
+
+#endif
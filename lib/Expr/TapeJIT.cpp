@@ -0,0 +1,58 @@
+//===-- TapeJIT.cpp -------------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/util/TapeJIT.h"
+#include "klee/util/Assignment.h"
+
+using namespace klee;
+
+TapeJIT* TapeJIT::theJIT = NULL;
+
+TapeJIT* TapeJIT::set(TapeJIT* jit)
+{
+	TapeJIT	*old = theJIT;
+	theJIT = jit;
+	return old;
+}
+
+uint64_t TapeJIT::hashSet(const std::vector<ref<Expr> >& es)
+{
+	uint64_t	h = es.size();
+
+	for (const auto &e : es)
+		h = (h ^ e->hash()) * 0x100000001b3ULL;
+
+	return h;
+}
+
+int TapeJIT::run(const Checker* c, const Assignment& a)
+{
+	const uint8_t	*binds[TAPE_MAX_ARRAYS];
+	uint64_t	lens[TAPE_MAX_ARRAYS];
+	int		r;
+
+	assert (c->fn != NULL && c->arrays.size() <= TAPE_MAX_ARRAYS);
+
+	for (unsigned s = 0; s < c->arrays.size(); s++) {
+		const std::vector<unsigned char>	*b;
+
+		b = a.getBinding(c->arrays[s]);
+		if (b == NULL || b->empty()) {
+			binds[s] = NULL;
+			lens[s] = 0;
+			continue;
+		}
+
+		binds[s] = b->data();
+		lens[s] = b->size();
+	}
+
+	r = c->fn(binds, lens);
+	return (r > 1) ? -1 : r;
+}
@@ -13,10 +13,13 @@ public:
 	virtual void write(unsigned offset, const ref<Expr>& value);
 	void taintAccesses(ref<ShadowVal>& taint_v);
 	ref<Expr> read8(unsigned offset) const;
+	bool hasReadHook(void) const override { return !taint_v.isNull(); }
 	void taint(unsigned offset, ref<ShadowVal>& v);
 
 	bool isClean(void) const { return tainted_bytes == 0; }
 	bool isByteTainted(unsigned s) const;
+	bool isSharable(void) const override
+	{ return isClean() && UnboxingObjectState::isSharable(); }
 
 protected:
 	ShadowObjectState(unsigned size)
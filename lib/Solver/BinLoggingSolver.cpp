@@ -0,0 +1,73 @@
+//===-- BinLoggingSolver.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver.h"
+
+#include "klee/Expr.h"
+#include "SolverImplWrapper.h"
+#include "klee/util/ExprBinary.h"
+
+#include <fstream>
+
+using namespace klee;
+
+/* drop the writer's node table past this many nodes so long runs don't
+ * pin every expression ever logged */
+#define BIN_LOG_MAX_NODES	(1 << 20)
+
+namespace klee
+{
+
+/* logs queries as an ExprBinary stream; replay with kleaver -exprfmt=bin */
+class BinLoggingSolver : public SolverImplWrapper
+{
+private:
+	std::ofstream	os;
+	ExprBinWriter	writer;
+
+	void logQuery(const Query& query);
+public:
+	BinLoggingSolver(Solver *_solver, std::string path)
+	: SolverImplWrapper(_solver)
+	, os(path.c_str(), std::ios::trunc | std::ios::binary)
+	, writer(os) {}
+
+	virtual ~BinLoggingSolver() {}
+
+	bool computeSat(const Query& query)
+	{ logQuery(query); return doComputeSat(query); }
+
+	Solver::Validity computeValidity(const Query& query)
+	{ logQuery(query); return doComputeValidity(query); }
+
+	ref<Expr> computeValue(const Query& query)
+	{ logQuery(query.withFalse()); return doComputeValue(query); }
+
+	bool computeInitialValues(const Query& query, Assignment& a)
+	{ logQuery(query); return doComputeInitialValues(query, a); }
+
+	void printName(int level = 0) const
+	{
+		klee_message("%*s" "BinLoggingSolver containing:", 2*level, "");
+		wrappedSolver->printName(level + 1);
+	}
+};
+
+Solver* createBinLoggingSolver(Solver *_solver, std::string path)
+{ return new Solver(new BinLoggingSolver(_solver, path)); }
+}
+
+void BinLoggingSolver::logQuery(const Query& query)
+{
+	if (writer.getNumNodes() > BIN_LOG_MAX_NODES)
+		writer.reset();
+
+	writer.writeQuery(query.constraints, query.expr);
+	os.flush();
+}
@@ -14,14 +14,18 @@
 #include "klee/SolverStats.h"
 #include "klee/TimerStatIncrementer.h"
 #include "klee/util/Assignment.h"
+#include "klee/util/BatchEvaluator.h"
 #include "klee/util/ExprUtil.h"
 #include "klee/util/ExprVisitor.h"
-#include "klee/Internal/ADT/MapOfSets.h"
+#include "klee/Internal/ADT/SetIndex.h"
+#include "klee/util/ExprHashMap.h"
 #include "klee/Internal/ADT/RNG.h"
 #include "klee/Common.h"
 
 #include "llvm/Support/CommandLine.h"
 #include "SMTPrinter.h"
+#include "CexFile.h"
+#include <algorithm>
 
 #define MAX_BINDING_BYTES	(32*1024)
 #define MAX_CACHED_BYTES	(128*1024*1024)	/* custom alloc => hugetlb */
@@ -60,7 +64,8 @@ public:
 	CexCachingSolver(Solver *_solver)
 	: SolverImplWrapper(_solver)
 	, assignTab_bytes(0)
-	, evicted_bytes(0) { rng.seed(54321); }
+	, evicted_bytes(0)
+	, cexFile(CexFile::create()) { rng.seed(54321); }
 	virtual ~CexCachingSolver();
 
 	bool computeSat(const Query&);
@@ -79,6 +84,7 @@ private:
 
 	void evictRandom(void);
 	bool searchForAssignment(Key &key, Assignment *&result);
+	bool searchFile(Key &key, Assignment *&result);
 	bool lookupAssignment(
 		const Query& query, Key &key, Assignment *&result);
 	bool lookupAssignment(const Query& query, Assignment *&result)
@@ -90,13 +96,19 @@ private:
 	bool getAssignment(const Query& query, Assignment *&result);
 	Assignment* addToTable(std::unique_ptr<Assignment> binding);
 
-	MapOfSets<ref<Expr>, Assignment*>	cache;
+	SetIndex<
+		ref<Expr>, Assignment*,
+		util::ExprHash, util::ExprCmp>	cache;
 
 	typedef std::set<Assignment*, AssignmentLessThan> assignTab_ty;
 	assignTab_ty	assignTab; // memo table
+	/* assignTab in insertion order; what the try-all scan walks */
+	std::vector<const Assignment*>	assignList;
 	unsigned int	assignTab_bytes;
 	unsigned int	evicted_bytes;
 	RNG		rng;
+
+	std::unique_ptr<CexFile>	cexFile;
 };
 
 struct NullAssignment { bool operator()(Assignment *a) const { return !a; } };
@@ -159,22 +171,57 @@ bool CexCachingSolver::searchForAssignment(Key &key, Assignment *&result)
 	if (CexCacheTryAll) {
 		// Otherwise, iterate through the set of current assignments 
 		// to see if one of them satisfies the query.
-		for (const auto &a : assignTab) {
-			if (a->satisfies(key.begin(), key.end())) {
-				// cache result for deterministic reconstitution
-				result = a;
-				cache.insert(key, result);
-				++stats::cexCacheHits;
-				return true;
+		// Past one batch, the key is compiled once and run over the
+		// table instead of walking the DAG per assignment.
+		int	idx = -1;
+
+		if (assignList.size() < BATCH_LANES) {
+			for (unsigned i = 0; i < assignList.size(); i++) {
+				if (assignList[i]->satisfies(
+					key.begin(), key.end()))
+				{
+					idx = i;
+					break;
+				}
 			}
+		} else {
+			BatchEvaluator	be(key.begin(), key.end());
+			idx = be.findSatisfying(assignList);
+		}
+
+		if (idx >= 0) {
+			// cache result for deterministic reconstitution
+			result = const_cast<Assignment*>(assignList[idx]);
+			cache.insert(key, result);
+			++stats::cexCacheHits;
+			return true;
 		}
 	}
 
+	if (searchFile(key, result)) {
+		++stats::cexCacheHits;
+		return true;
+	}
 
 	++stats::cexCacheMisses;
 	return false;
 }
 
+/* fall back to counterexamples saved by this or earlier runs */
+bool CexCachingSolver::searchFile(Key &key, Assignment *&result)
+{
+	Assignment	*a;
+
+	if (!cexFile || !cexFile->lookup(key, a))
+		return false;
+
+	result = (a != NULL)
+		? addToTable(std::unique_ptr<Assignment>(a))
+		: NULL;
+	cache.insert(key, result);
+	return true;
+}
+
 /// lookupAssignment - Lookup a cached result for the given \arg query.
 ///
 /// \param query - The query to lookup.
@@ -204,8 +251,7 @@ bool CexCachingSolver::lookupAssignment(
 
 void CexCachingSolver::evictRandom(void)
 {
-	std::set<Assignment*>				as_to_del;
-	std::vector<std::pair<Key, Assignment*> >	expr_sets;
+	std::set<Assignment*>	as_to_del;
 
 	/* collect assignments to trash */
 	for (const auto &a : assignTab) {
@@ -214,18 +260,9 @@ void CexCachingSolver::evictRandom(void)
 			as_to_del.insert(a);
 	}
 
-	/* save non-matching references from ref=>Assignment cache */
-	for (const auto &cp : cache ) {
-		Assignment	*cur_a = cp.second;
-		if (!as_to_del.count(cur_a))
-			expr_sets.push_back(cp);
-	}
-
-	/* clear, rebuild */
-	cache.clear();
-	for (const auto &ep : expr_sets)
-		cache.insert(ep.first, ep.second);
-	expr_sets.clear();
+	/* drop keys mapping to trashed assignments */
+	cache.eraseIf([&as_to_del] (Assignment* a)
+		{ return a != NULL && as_to_del.count(a) != 0; });
 
 	/* delete all */
 	for (const auto &a : as_to_del) {
@@ -239,6 +276,13 @@ void CexCachingSolver::evictRandom(void)
 		delete a;
 	}
 
+	assignList.erase(
+		std::remove_if(assignList.begin(), assignList.end(),
+			[&as_to_del] (const Assignment* a)
+			{ return as_to_del.count(
+				const_cast<Assignment*>(a)) != 0; }),
+		assignList.end());
+
 	std::cerr
 		<< "[CexCache] Total Evicted Bytes: "
 		<< evicted_bytes << '\n';
@@ -263,6 +307,7 @@ Assignment* CexCachingSolver::addToTable(std::unique_ptr<Assignment> binding)
 		if (!new_bytes)
 			new_bytes = binding->getBindingBytes();
 		assignTab_bytes += new_bytes;
+		assignList.push_back(binding.get());
 
 		binding.release();
 		return *res.first;
@@ -310,6 +355,10 @@ bool CexCachingSolver::getAssignment(const Query& query, Assignment* &result)
 	result = createBinding(query, key);
 
 	if (failed()) return false;
+
+	if (cexFile)
+		cexFile->save(key, result);
+
 	if (result == NULL) return true;
 
 	cache.insert(key, result);
@@ -0,0 +1,658 @@
+#include "llvm/Support/CommandLine.h"
+#include <algorithm>
+#include <iostream>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <sstream>
+
+#include "static/Sugar.h"
+#include "klee/util/Assignment.h"
+#include "klee/util/ExprUtil.h"
+#include "klee/util/ExprBinary.h"
+#include "klee/Internal/ADT/MemFile.h"
+#include "klee/Common.h"
+#include "CexFile.h"
+
+using namespace klee;
+using namespace llvm;
+
+#define TAG		"[CexFile] "
+#define CEX_MAGIC	0x32584543	/* 'CEX2' */
+/* superset candidates checked against the query per lookup */
+#define MAX_SAT_CANDIDATES	32
+
+namespace
+{
+	cl::opt<std::string>
+	CexCacheFDir(
+		"cex-cache-fdir",	/* cex.cache */
+		cl::desc("Directory with compacted counterexample cache "
+			"(default: the pending directory)."),
+		cl::init(""));
+
+	cl::opt<std::string>
+	CexCachePendingDir(
+		"cex-cache-pending",	/* cex.pending */
+		cl::desc("Dir for counterexamples shared across runs."),
+		cl::init(""));
+
+	cl::opt<unsigned>
+	CexCacheCompactBytes(
+		"cex-cache-compact-bytes",
+		cl::desc("Fold the pending log into cex.cache at exit "
+			"once it is this large (0 = never)."),
+		cl::init(8*1024*1024));
+}
+
+/* record layout; the sorted key hashes come next, then either the
+ * arrays (sat) or expr_bytes of encoded constraints (unsat) */
+struct CexRecordHdr
+{
+	uint32_t	magic;
+	uint32_t	n_keys;
+	uint32_t	n_arrays;	/* 0 => unsat */
+	uint32_t	rec_bytes;	/* including header */
+	uint32_t	expr_bytes;
+	uint32_t	pad;
+};
+
+struct CexArrayHdr
+{
+	uint32_t	name_len;
+	uint32_t	size;
+};
+
+CexFile* CexFile::create(void)
+{
+	char	path[256];
+	int	fd;
+
+	if (CexCachePendingDir.empty())
+		return NULL;
+
+	snprintf(path, 256, "%s/cex.pending", CexCachePendingDir.c_str());
+	fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+	if (fd == -1) {
+		klee_warning("Could not open cex cache '%s'", path);
+		return NULL;
+	}
+
+	snprintf(path, 256, "%s/cex.cache",
+		(CexCacheFDir.empty() ? CexCachePendingDir : CexCacheFDir)
+			.c_str());
+
+	return new CexFile(path, fd);
+}
+
+CexFile::CexFile(const std::string& _cache_path, int _pend_fd)
+: cache_path(_cache_path)
+, pend_fd(_pend_fd)
+, pend_off(0)
+, pend_bad(false)
+, hits(0)
+, misses(0)
+{
+	loadCache();
+	refresh();
+	std::cerr << TAG"Loaded " << entries.size() << " entries\n";
+}
+
+CexFile::~CexFile()
+{
+	std::cerr << TAG"Hits=" << hits << ". Misses=" << misses << '\n';
+	compact();
+	close(pend_fd);
+	foreach (it, entries.begin(), entries.end())
+		delete *it;
+}
+
+void CexFile::loadCache(void)
+{
+	std::unique_ptr<MemFile>	mf(MemFile::create(cache_path.c_str()));
+	unsigned			n;
+	bool				bad = false;
+
+	if (mf == NULL)
+		return;
+
+	n = entries.size();
+	loadRecords((const uint8_t*)mf->getBuf(), mf->getNumBytes(), bad);
+	std::cerr << TAG"MemFile has " << entries.size() - n << " records\n";
+}
+
+/* decode one record that fits in len bytes; NULL if it is malformed */
+CexFile::Entry* CexFile::loadRecord(const uint8_t* buf, unsigned len)
+{
+	const CexRecordHdr	*hdr = (const CexRecordHdr*)buf;
+	std::unique_ptr<Entry>	ent(new Entry());
+	uint64_t		cur, need;
+
+	need =	sizeof(*hdr) +
+		(uint64_t)hdr->n_keys * sizeof(Expr::Hash) +
+		hdr->expr_bytes;
+	if (need > len || hdr->n_keys == 0)
+		return NULL;
+
+	/* unsat records carry the exprs; sat records carry the arrays */
+	if ((hdr->n_arrays == 0) != (hdr->expr_bytes != 0))
+		return NULL;
+
+	ent->sat = hdr->n_arrays != 0;
+	ent->decoded = false;
+	ent->bad = false;
+	cur = sizeof(*hdr);
+	ent->keys.resize(hdr->n_keys);
+	memcpy(ent->keys.data(), buf + cur, hdr->n_keys * sizeof(Expr::Hash));
+	cur += hdr->n_keys * sizeof(Expr::Hash);
+
+	/* postings and subset counting rely on strictly sorted keys */
+	for (unsigned i = 1; i < ent->keys.size(); i++)
+		if (ent->keys[i-1] >= ent->keys[i])
+			return NULL;
+
+	/* decoded only on a hash match; reject the obvious junk now */
+	if (	!ent->sat &&
+		(hdr->expr_bytes <= strlen(EXPR_BIN_MAGIC) ||
+		memcmp(buf + cur, EXPR_BIN_MAGIC, strlen(EXPR_BIN_MAGIC))))
+		return NULL;
+
+	ent->exprs_bin.assign((const char*)buf + cur, hdr->expr_bytes);
+	cur += hdr->expr_bytes;
+
+	for (unsigned i = 0; i < hdr->n_arrays; i++) {
+		const CexArrayHdr	*ahdr;
+		const char		*name;
+		const uint8_t		*v;
+
+		if (cur + sizeof(*ahdr) > len)
+			return NULL;
+
+		ahdr = (const CexArrayHdr*)(buf + cur);
+		cur += sizeof(*ahdr);
+		if (cur + (uint64_t)ahdr->name_len + ahdr->size > len)
+			return NULL;
+
+		name = (const char*)(buf + cur);
+		v = (const uint8_t*)(name + ahdr->name_len);
+		ent->arrays.push_back(std::make_pair(
+			std::string(name, ahdr->name_len),
+			std::vector<unsigned char>(v, v + ahdr->size)));
+		cur += ahdr->name_len + ahdr->size;
+	}
+
+	if (cur != len)
+		return NULL;
+
+	return ent.release();
+}
+
+/* returns bytes consumed; a partial record at the end is left for
+ * later, anything unreadable sets 'bad' */
+unsigned CexFile::loadRecords(const uint8_t* buf, unsigned len, bool& bad)
+{
+	unsigned	off = 0;
+
+	while (off + sizeof(CexRecordHdr) <= len) {
+		const CexRecordHdr	*hdr;
+		Entry			*ent;
+
+		hdr = (const CexRecordHdr*)(buf + off);
+		if (hdr->magic != CEX_MAGIC || hdr->rec_bytes < sizeof(*hdr)) {
+			klee_warning("Bad cex cache record at %u", off);
+			bad = true;
+			break;
+		}
+
+		/* partial write from some other process; try again later */
+		if (hdr->rec_bytes > len - off)
+			break;
+
+		ent = loadRecord(buf + off, hdr->rec_bytes);
+		off += hdr->rec_bytes;
+
+		/* the length is sane, so skip just this record */
+		if (ent == NULL) {
+			klee_warning_once(0, "Skipping corrupt cex cache record");
+			continue;
+		}
+
+		if (!saved_keys.insert(hashKeyHashes(ent->keys)).second) {
+			delete ent;
+			continue;
+		}
+
+		addEntry(ent);
+	}
+
+	return off;
+}
+
+/* pick up records appended by other runs */
+void CexFile::refresh(void)
+{
+	struct stat		s;
+	std::vector<uint8_t>	buf;
+	ssize_t			br;
+
+	if (pend_bad || fstat(pend_fd, &s) != 0)
+		return;
+
+	/* another run compacted the log into cex.cache */
+	if (s.st_size < pend_off) {
+		pend_off = 0;
+		loadCache();
+	}
+
+	if (s.st_size <= pend_off)
+		return;
+
+	buf.resize(s.st_size - pend_off);
+	br = pread(pend_fd, buf.data(), buf.size(), pend_off);
+	if (br <= 0)
+		return;
+
+	pend_off += loadRecords(buf.data(), br, pend_bad);
+	if (!pend_bad || s.st_size == br)
+		return;
+
+	/* the log was compacted and refilled past our offset, so we
+	 * landed mid-record; start over (known keys are skipped) */
+	pend_bad = false;
+	pend_off = 0;
+	loadCache();
+	refresh();
+}
+
+/* Rewrite cex.cache with every entry this run knows, then empty the
+ * pending log. Writers hold a shared lock on the log while appending,
+ * so the exclusive lock here sees every finished record. */
+void CexFile::compact(void)
+{
+	std::string		tmp_path(cache_path + ".tmp");
+	std::vector<uint8_t>	buf;
+	struct stat		s;
+	FILE			*f;
+	bool			ok = true;
+
+	if (CexCacheCompactBytes == 0 || pend_bad)
+		return;
+
+	if (fstat(pend_fd, &s) != 0 || s.st_size < CexCacheCompactBytes)
+		return;
+
+	if (flock(pend_fd, LOCK_EX | LOCK_NB) != 0)
+		return;
+
+	refresh();
+
+	f = fopen(tmp_path.c_str(), "wb");
+	if (f == NULL) {
+		flock(pend_fd, LOCK_UN);
+		return;
+	}
+
+	foreach (it, entries.begin(), entries.end()) {
+		/* don't carry a corrupt record into the new cache */
+		if ((*it)->bad)
+			continue;
+		encodeRecord(**it, buf);
+		if (fwrite(buf.data(), buf.size(), 1, f) != 1) {
+			ok = false;
+			break;
+		}
+	}
+
+	if (fflush(f) != 0 || fsync(fileno(f)) != 0)
+		ok = false;
+	fclose(f);
+
+	if (ok && rename(tmp_path.c_str(), cache_path.c_str()) == 0) {
+		if (ftruncate(pend_fd, 0) == 0)
+			pend_off = 0;
+		std::cerr << TAG"Compacted " << entries.size()
+			<< " entries\n";
+	} else {
+		unlink(tmp_path.c_str());
+		klee_warning("Could not compact cex cache '%s'",
+			cache_path.c_str());
+	}
+
+	flock(pend_fd, LOCK_UN);
+}
+
+void CexFile::addEntry(Entry* ent)
+{
+	unsigned	idx = entries.size();
+
+	entries.push_back(ent);
+	foreach (it, ent->keys.begin(), ent->keys.end())
+		postings[*it].push_back(idx);
+}
+
+/* Expr hashes ignore array names, so two constraints over different
+ * arrays of the same size would look alike; mix in the names (and
+ * contents for constant arrays) of everything the constraint reads. */
+Expr::Hash CexFile::hashConstraint(const ref<Expr>& e)
+{
+	ExprHashMap<Expr::Hash>::const_iterator	it(hash_memo.find(e));
+	std::vector<ref<ReadExpr> >		reads;
+	std::set<std::string>			names;
+	std::set<const Array*>			seen;
+	Expr::Hash				h;
+
+	if (it != hash_memo.end())
+		return it->second;
+
+	h = e->hash();
+	ExprUtil::findReads(e, true, reads);
+	foreach (rit, reads.begin(), reads.end()) {
+		const Array	*arr = (*rit)->updates.getRoot().get();
+		std::vector<ref<ConstantExpr> >	v;
+
+		if (!seen.insert(arr).second)
+			continue;
+
+		names.insert(arr->name);
+		if (!arr->isConstantArray())
+			continue;
+
+		arr->getConstantValues(v);
+		foreach (vit, v.begin(), v.end()) {
+			uint8_t	c = (*vit)->getZExtValue(8);
+			h = Expr::hashImpl(&c, 1, h);
+		}
+	}
+
+	foreach (nit, names.begin(), names.end())
+		h = Expr::hashImpl(nit->c_str(), nit->size(), h);
+
+	hash_memo[e] = h;
+	return h;
+}
+
+void CexFile::getKeyHashes(const Key& key, std::vector<Expr::Hash>& hs)
+{
+	hs.clear();
+	foreach (it, key.begin(), key.end())
+		hs.push_back(hashConstraint(*it));
+	std::sort(hs.begin(), hs.end());
+	hs.erase(std::unique(hs.begin(), hs.end()), hs.end());
+}
+
+Expr::Hash CexFile::hashKeyHashes(const std::vector<Expr::Hash>& hs) const
+{ return Expr::hashImpl(hs.data(), hs.size() * sizeof(Expr::Hash), 0); }
+
+bool CexFile::findUnsatSubset(
+	const Key& key, const std::vector<Expr::Hash>& hs)
+{
+	std::unordered_map<unsigned, unsigned>	counts;
+
+	/* hs and every entry's keys are unique, so counts can't overshoot */
+	foreach (it, hs.begin(), hs.end()) {
+		auto	pit = postings.find(*it);
+
+		if (pit == postings.end())
+			continue;
+
+		foreach (eit, pit->second.begin(), pit->second.end()) {
+			Entry	*ent = entries[*eit];
+
+			if (ent->sat || ent->bad)
+				continue;
+
+			/* every hash matched; now check the exprs */
+			if (	++counts[*eit] == ent->keys.size() &&
+				unsatMatches(key, *ent))
+				return true;
+		}
+	}
+
+	return false;
+}
+
+/* The record passed the length checks when it was loaded, but its
+ * exprs may still be garbage. Accept them only if the stream is exactly
+ * one well-formed query of boolean constraints whose hashes are the
+ * record's keys; anything else marks the entry bad for good. */
+bool CexFile::decodeExprs(Entry& ent)
+{
+	std::istringstream	is(ent.exprs_bin);
+	ExprBinReader		r(is);
+	std::vector<Expr::Hash>	hs;
+	ref<Expr>		e;
+
+	ent.decoded = true;
+	if (!r.readQuery(ent.exprs, e) || is.peek() != EOF)
+		goto bad;
+
+	if (	ent.exprs.empty() || e->getWidth() != Expr::Bool ||
+		!e->isFalse())
+		goto bad;
+
+	foreach (it, ent.exprs.begin(), ent.exprs.end()) {
+		if ((*it)->getWidth() != Expr::Bool)
+			goto bad;
+		hs.push_back(hashConstraint(*it));
+	}
+
+	std::sort(hs.begin(), hs.end());
+	hs.erase(std::unique(hs.begin(), hs.end()), hs.end());
+	if (hs != ent.keys)
+		goto bad;
+
+	return true;
+bad:
+	klee_warning_once(0, "Skipping corrupt cex cache record");
+	ent.exprs.clear();
+	ent.bad = true;
+	return false;
+}
+
+/* hashes can collide or drift between builds; only a structural match
+ * of every stored constraint makes the query unsat */
+bool CexFile::unsatMatches(const Key& key, Entry& ent)
+{
+	if (!ent.decoded && !decodeExprs(ent))
+		return false;
+
+	if (ent.bad)
+		return false;
+
+	foreach (it, ent.exprs.begin(), ent.exprs.end())
+		if (key.count(*it) == 0)
+			return false;
+
+	return true;
+}
+
+Assignment* CexFile::findSatSuperset(
+	const Key& key, const std::vector<Expr::Hash>& hs)
+{
+	const std::vector<unsigned>	*cands = NULL;
+	unsigned			tried = 0;
+
+	/* scan from the rarest constraint */
+	foreach (it, hs.begin(), hs.end()) {
+		auto	pit = postings.find(*it);
+
+		if (pit == postings.end())
+			return NULL;
+
+		if (cands == NULL || pit->second.size() < cands->size())
+			cands = &pit->second;
+	}
+
+	if (cands == NULL)
+		return NULL;
+
+	foreach (it, cands->begin(), cands->end()) {
+		const Entry	*ent = entries[*it];
+		Assignment	*a;
+
+		if (!ent->sat)
+			continue;
+
+		if (!std::includes(
+			ent->keys.begin(), ent->keys.end(),
+			hs.begin(), hs.end()))
+			continue;
+
+		a = buildAssignment(key, *ent);
+		if (a != NULL)
+			return a;
+
+		if (++tried >= MAX_SAT_CANDIDATES)
+			break;
+	}
+
+	return NULL;
+}
+
+Assignment* CexFile::buildAssignment(const Key& key, const Entry& ent)
+{
+	std::vector<const Array*>	objs;
+	Assignment			*a;
+
+	ExprUtil::findSymbolicObjects(key.begin(), key.end(), objs);
+	a = new Assignment(objs);
+	foreach (it, objs.begin(), objs.end()) {
+		const Array	*arr = *it;
+
+		foreach (ait, ent.arrays.begin(), ent.arrays.end()) {
+			if (	ait->first == arr->name &&
+				ait->second.size() == arr->getSize())
+			{
+				a->bindFree(arr, ait->second);
+				break;
+			}
+		}
+	}
+	a->bindFreeToZero();
+
+	/* hash collisions, renamed arrays, etc. */
+	if (!a->satisfies(key.begin(), key.end())) {
+		delete a;
+		return NULL;
+	}
+
+	return a;
+}
+
+bool CexFile::lookup(const Key& key, Assignment* &result)
+{
+	std::vector<Expr::Hash>	hs;
+
+	getKeyHashes(key, hs);
+	for (unsigned i = 0; i < 2; i++) {
+		if (findUnsatSubset(key, hs)) {
+			result = NULL;
+			hits++;
+			return true;
+		}
+
+		result = findSatSuperset(key, hs);
+		if (result != NULL) {
+			hits++;
+			return true;
+		}
+
+		/* some other run may have solved it already */
+		if (i == 0) {
+			unsigned	old_sz = entries.size();
+			refresh();
+			if (entries.size() == old_sz)
+				break;
+		}
+	}
+
+	misses++;
+	return false;
+}
+
+void CexFile::encodeRecord(const Entry& ent, std::vector<uint8_t>& buf) const
+{
+	CexRecordHdr	hdr;
+
+	hdr.magic = CEX_MAGIC;
+	hdr.n_keys = ent.keys.size();
+	hdr.n_arrays = ent.arrays.size();
+	hdr.rec_bytes = 0;
+	hdr.expr_bytes = ent.exprs_bin.size();
+	hdr.pad = 0;
+
+	buf.clear();
+	buf.resize(sizeof(hdr));
+	buf.insert(buf.end(),
+		(const uint8_t*)ent.keys.data(),
+		(const uint8_t*)(ent.keys.data() + ent.keys.size()));
+	buf.insert(buf.end(), ent.exprs_bin.begin(), ent.exprs_bin.end());
+	foreach (it, ent.arrays.begin(), ent.arrays.end()) {
+		CexArrayHdr	ahdr;
+
+		ahdr.name_len = it->first.size();
+		ahdr.size = it->second.size();
+		buf.insert(buf.end(),
+			(const uint8_t*)&ahdr,
+			(const uint8_t*)(&ahdr + 1));
+		buf.insert(buf.end(), it->first.begin(), it->first.end());
+		buf.insert(buf.end(), it->second.begin(), it->second.end());
+	}
+
+	hdr.rec_bytes = buf.size();
+	memcpy(buf.data(), &hdr, sizeof(hdr));
+}
+
+void CexFile::save(const Key& key, const Assignment* a)
+{
+	std::vector<Expr::Hash>	hs;
+	std::vector<uint8_t>	buf;
+	Entry			*ent;
+
+	/* n_arrays == 0 marks unsat, so sat needs at least one binding */
+	if (a != NULL && a->getNumBindings() == 0)
+		return;
+
+	getKeyHashes(key, hs);
+	if (hs.empty() || !saved_keys.insert(hashKeyHashes(hs)).second)
+		return;
+
+	ent = new Entry();
+	ent->keys = hs;
+	ent->sat = (a != NULL);
+	ent->decoded = false;
+	ent->bad = false;
+	if (a != NULL) {
+		foreach (it, a->bindingsBegin(), a->bindingsEnd())
+			ent->arrays.push_back(std::make_pair(
+				it->first->name, it->second));
+	} else {
+		std::ostringstream	os;
+		ExprBinWriter		w(os);
+
+		w.writeQuery(
+			std::vector<ref<Expr> >(key.begin(), key.end()),
+			ConstantExpr::create(0, Expr::Bool));
+		ent->exprs_bin = os.str();
+	}
+
+	encodeRecord(*ent, buf);
+
+	/* the constraints are at hand; no need to decode them later */
+	if (a == NULL) {
+		ent->exprs.assign(key.begin(), key.end());
+		ent->decoded = true;
+	}
+
+	addEntry(ent);
+
+	/* single O_APPEND write so concurrent runs don't interleave;
+	 * the shared lock keeps it out of a compaction */
+	flock(pend_fd, LOCK_SH);
+	if (write(pend_fd, buf.data(), buf.size()) != (ssize_t)buf.size())
+		klee_warning_once(0, "Could not append to cex cache");
+	flock(pend_fd, LOCK_UN);
+}
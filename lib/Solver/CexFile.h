@@ -0,0 +1,100 @@
+#ifndef CEXFILE_H
+#define CEXFILE_H
+
+#include "klee/Expr.h"
+#include "klee/util/ExprHashMap.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <string>
+#include <vector>
+#include <set>
+
+namespace klee
+{
+class Assignment;
+
+/* On-disk counterexample cache shared across runs.
+ *
+ * Every solved key (constraint set + negated query) is written as a
+ * record holding the sorted hashes of its constraints. A satisfiable
+ * key also stores the bytes of every array in its assignment; an
+ * unsatisfiable one stores the constraints themselves in the binary
+ * expr format. Records live in a read-only compacted file (mmapped) and
+ * an append-only pending file; concurrent runs append to the same
+ * pending file and pick up each other's records on a miss. When the
+ * pending file outgrows -cex-cache-compact-bytes, the run exiting folds
+ * it into the compacted file.
+ *
+ * Hashes only pick candidates. A SAT record whose key is a superset of
+ * the query key gives an assignment that is checked against the query
+ * before use. An UNSAT record counts only if every one of its decoded
+ * constraints is structurally in the query key. */
+class CexFile
+{
+public:
+	typedef std::set< ref<Expr> > Key;
+
+	static CexFile* create(void);
+	virtual ~CexFile();
+
+	/* returns true on hit; result is NULL for UNSAT */
+	bool lookup(const Key& key, Assignment* &result);
+	void save(const Key& key, const Assignment* a);
+
+	unsigned getNumEntries(void) const { return entries.size(); }
+private:
+	struct Entry
+	{
+		std::vector<Expr::Hash>	keys;	/* sorted, unique */
+		bool			sat;
+		/* (name, bytes) */
+		std::vector<std::pair<std::string,
+			std::vector<unsigned char> > >	arrays;
+		/* unsat only: the key's exprs, encoded, then decoded lazily */
+		std::string		exprs_bin;
+		std::vector<ref<Expr> >	exprs;
+		bool			decoded;
+		/* exprs failed to decode or didn't match the keys */
+		bool			bad;
+	};
+
+	CexFile(const std::string& _cache_path, int _pend_fd);
+
+	Expr::Hash hashConstraint(const ref<Expr>& e);
+	void getKeyHashes(const Key& key, std::vector<Expr::Hash>& hs);
+	Expr::Hash hashKeyHashes(const std::vector<Expr::Hash>& hs) const;
+
+	unsigned loadRecords(const uint8_t* buf, unsigned len, bool& bad);
+	Entry* loadRecord(const uint8_t* buf, unsigned len);
+	void encodeRecord(const Entry& ent, std::vector<uint8_t>& buf) const;
+	void loadCache(void);
+	void refresh(void);
+	void compact(void);
+	void addEntry(Entry* ent);
+
+	bool findUnsatSubset(
+		const Key& key, const std::vector<Expr::Hash>& hs);
+	bool decodeExprs(Entry& ent);
+	bool unsatMatches(const Key& key, Entry& ent);
+	Assignment* findSatSuperset(
+		const Key& key, const std::vector<Expr::Hash>& hs);
+	Assignment* buildAssignment(const Key& key, const Entry& ent);
+
+	std::string			cache_path;
+	int				pend_fd;
+	off_t				pend_off;
+	/* stop reading the pending file after a corrupt record */
+	bool				pend_bad;
+
+	std::vector<Entry*>		entries;
+	/* constraint hash => entries using it */
+	std::unordered_map<Expr::Hash, std::vector<unsigned> >	postings;
+	std::unordered_set<Expr::Hash>	saved_keys;
+
+	ExprHashMap<Expr::Hash>		hash_memo;
+
+	unsigned			hits, misses;
+};
+}
+
+#endif
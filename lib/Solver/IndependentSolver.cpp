@@ -29,13 +29,26 @@ namespace {
   	"randomize-independent-solver",
 	cl::desc("Randomize unconstrained values in independent solver"),
 	cl::init(false));
+
+  cl::opt<bool> UseIndepPartition(
+	"indep-partition",
+	cl::desc("Use constraint manager's incremental independence groups"),
+	cl::init(true));
+}
+
+static void getDependentConstraints(const Query& query, ConstraintManager& cs)
+{
+	if (UseIndepPartition) {
+		query.constraints.getDependent(query.expr, cs);
+		return;
+	}
+
+	IndependentElementSet::getIndependentConstraints(query, cs);
 }
 
 #define SETUP_CONSTRAINTS_			\
 	ConstraintManager	cs;		\
-	IndependentElementSet eltsClosure;	\
-	eltsClosure = IndependentElementSet::getIndependentConstraints(	\
-		query, cs);			\
+	getDependentConstraints(query, cs);	\
 	ConstraintManager cs2;
 
 //#define PARANOIA
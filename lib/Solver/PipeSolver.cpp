@@ -17,6 +17,8 @@
 #include "klee/util/Assignment.h"
 #include <llvm/Support/CommandLine.h>
 #include "klee/klee.h"
+#include "klee/Internal/System/Time.h"
+#include <algorithm>
 #include <iostream>
 
 #include "klee/Solver.h"
@@ -78,8 +80,43 @@ namespace {
 		"prefork-solver",
 		cl::desc("exec() new solver at query fini."),
 		cl::init(true));
+
+	cl::opt<unsigned>
+	PipeSolverPool(
+		"pipe-solver-pool",
+		cl::desc("Solver processes kept ready per query type. "
+			"With two or more, both halves of a validity check "
+			"run at once. Also caps queries in flight for "
+			"-async-solver."),
+		cl::init(1));
+
+	cl::opt<unsigned>
+	PortfolioWarmup(
+		"portfolio-warmup",
+		cl::desc("Races per query shape before routing to one solver"),
+		cl::init(8));
+
+	cl::opt<unsigned>
+	PortfolioRoutePct(
+		"portfolio-route-pct",
+		cl::desc("Win percentage a solver needs to get a shape alone"),
+		cl::init(75));
+
+	cl::opt<unsigned>
+	PortfolioExplore(
+		"portfolio-explore",
+		cl::desc("Race every Nth query of a routed shape anyway"),
+		cl::init(32));
+
+	cl::opt<bool>
+	PortfolioDumpStats(
+		"portfolio-dump-stats",
+		cl::desc("Print per-shape portfolio wins on exit"),
+		cl::init(false));
 }
 
+namespace llvm { extern cl::opt<bool> DoubleCheckValidity; }
+
 static void dump_badquery(const Query& q, const char* prefix)
 {
 	char			fname[256];
@@ -99,6 +136,18 @@ void PipeSolver::setTimeout(double in_timeout)
 	static_cast<PipeSolverImpl*>(impl)->setTimeout(in_timeout);
 }
 
+bool PipeSolver::submitAsync(const Query& q)
+{ return static_cast<PipeSolverImpl*>(impl)->submitAsync(q); }
+
+void PipeSolver::pollAsync(std::vector<PipeAnswer>& done, bool block)
+{ static_cast<PipeSolverImpl*>(impl)->pollAsync(done, block); }
+
+void PipeSolver::cancelAsync(void)
+{ static_cast<PipeSolverImpl*>(impl)->cancelAsync(); }
+
+unsigned PipeSolver::numAsync(void) const
+{ return static_cast<PipeSolverImpl*>(impl)->numAsync(); }
+
 PipeSolverImpl::PipeSolverImpl(PipeFormat* in_fmt)
 : fmt(in_fmt)
 , timeout(-1.0)
@@ -121,22 +170,32 @@ public:
 	static PipeSolverSession* create(const char* solver_fname, const char **argv);
 	virtual ~PipeSolverSession(void) { stop(); }
 	void stop();
+	void release();
+	bool isOwner(void) const { return owner_pid == getpid(); }
 	bool getSAT(const Query& q, PipeFormat* fmt, double timeout);
+	bool send(const Query& q);
+	bool sendSAT(const Query& q);
+	bool recvSAT(const Query& q, PipeFormat* fmt, double timeout);
+	bool recvModel(const Query& q, PipeFormat* fmt, double timeout);
 	bool getModel(const Query& q, PipeFormat* fmt, double timeout);
+	int getReadFD(void) const { return fd_child_stdout; }
 protected:
 	PipeSolverSession(int child_stdin, int child_stdout, int cpid)
 	: fd_child_stdin(child_stdin), fd_child_stdout(child_stdout)
 	, child_pid(cpid)
+	, owner_pid(getpid())
 	{}
 	bool writeQuery(const Query& q);
 	bool writeQueryToChild(const Query& q);
 	bool waitOnSolver(const Query& q) const;
 	std::istream* writeRecvQuery(const Query& q);
+	std::istream* recvQuery(const Query& q);
 	void doneWriting(void);
 private:
 	int		fd_child_stdin;
 	int		fd_child_stdout;
 	pid_t		child_pid;
+	pid_t		owner_pid;
 	std::unique_ptr<__gnu_cxx::stdio_filebuf<char>> stdout_buf;
 	double		timeout;
 };
@@ -159,6 +218,58 @@ bool PipeSolverSession::getSAT(const Query& q, PipeFormat* fmt, double to)
 	return parse_ok;
 }
 
+/* write a SAT query without waiting on the answer; the solver works
+ * on it in the background until recvSAT() */
+bool PipeSolverSession::sendSAT(const Query& q)
+{
+	++stats::queries;
+	return send(q.negateExpr());
+}
+
+/* write query as-is, no stats; pair with recvSAT or recvModel */
+bool PipeSolverSession::send(const Query& q)
+{
+	timeout = 0.0;
+	if (writeQuery(q))
+		return true;
+	stop();
+	return false;
+}
+
+bool PipeSolverSession::recvSAT(const Query& q, PipeFormat* fmt, double to)
+{
+	bool		parse_ok;
+	std::istream	*is;
+
+	timeout = to;
+	if (!(is = recvQuery(q.negateExpr()))) {
+		stop();
+		return false;
+	}
+
+	parse_ok = fmt->parseSAT(*is);
+	delete is;
+	stop();
+	return parse_ok;
+}
+
+bool PipeSolverSession::recvModel(const Query& q, PipeFormat* fmt, double to)
+{
+	bool		parse_ok;
+	std::istream	*is;
+
+	timeout = to;
+	if (!(is = recvQuery(q))) {
+		stop();
+		return false;
+	}
+
+	parse_ok = fmt->parseModel(*is);
+	delete is;
+	stop();
+	return parse_ok;
+}
+
 bool PipeSolverSession::getModel(const Query& q, PipeFormat* fmt, double to)
 {
 	std::istream *is;
@@ -312,6 +423,11 @@ std::istream* PipeSolverSession::writeRecvQuery(const Query& q)
 
 	if (!wrote_query) return nullptr;
 
+	return recvQuery(q);
+}
+
+std::istream* PipeSolverSession::recvQuery(const Query& q)
+{
 	assert (stdout_buf == NULL);
 
 	/* wait for data to become available on the pipe.
@@ -342,6 +458,17 @@ void PipeSolverSession::stop(void)
 	fd_child_stdout = -1;
 }
 
+/* drop a session inherited through fork() without touching the solver
+ * process; it belongs to (and is reaped by) the process that made it */
+void PipeSolverSession::release(void)
+{
+	if (fd_child_stdin != -1) close(fd_child_stdin);
+	if (fd_child_stdout != -1) close(fd_child_stdout);
+	child_pid = -1;
+	fd_child_stdin = -1;
+	fd_child_stdout = -1;
+}
+
 /* create solver child process with stdin/stdout pipes
  * for sending/receiving query expressions/models
  */
@@ -528,31 +655,591 @@ bool PipeSolverImpl::computeSat(const Query& q)
 	return is_sat;
 }
 
+/* Both polarities of the query go to separate solver processes before
+ * waiting on either, so the validity check costs one solver latency
+ * instead of two. The caller still blocks until both answer; only the
+ * two halves of this one query overlap. */
+Solver::Validity PipeSolverImpl::computeValidity(const Query& q)
+{
+	TimerStatIncrementer	t(stats::queryTime);
+	PipeSolverSession	*pss[2];
+	bool			is_sat[2], ok;
+	double			deadline;
+
+	if (PipeSolverPool < 2)
+		return SolverImpl::computeValidity(q);
+
+	pss[0] = setupCachedSolver(fmt->getArgvSAT());
+	pss[1] = setupCachedSolver(fmt->getArgvSAT());
+	if (pss[0] == NULL || pss[1] == NULL) {
+		std::cerr << TAG"FAILED RACED VALIDITY QUERY SETUP\n";
+		delete pss[0];
+		delete pss[1];
+		failQuery();
+		return Solver::Unknown;
+	}
+
+	++stats::queriesRaced;
+	ok = pss[0]->sendSAT(q) && pss[1]->sendSAT(q.negateExpr());
+
+	deadline = util::getWallTime() + timeout;
+	for (unsigned i = 0; i < 2 && ok; i++) {
+		double	remaining = 0.0;
+
+		if (timeout > 0.0) {
+			/* never 0.0; that would wait forever */
+			remaining = std::max(
+				deadline - util::getWallTime(), 1e-3);
+		}
+
+		ok = pss[i]->recvSAT(
+			(i == 0) ? q : q.negateExpr(), fmt, remaining);
+		is_sat[i] = fmt->isSAT();
+
+		if (i == 0 && ok) {
+			if (is_sat[0])	++stats::queriesValid;
+			else		++stats::queriesInvalid;
+		}
+
+		/* unsat expr => false; don't wait on the negation */
+		if (i == 0 && ok && !is_sat[0] && !DoubleCheckValidity) {
+			delete pss[0];
+			delete pss[1];
+			return Solver::False;
+		}
+	}
+
+	delete pss[0];
+	delete pss[1];
+
+	if (!ok) {
+		std::cerr << TAG"BAD RACED VALIDITY ("
+			<< (void*)q.hash() << ")\n";
+		failQuery();
+		return Solver::Unknown;
+	}
+
+	if (is_sat[1])	++stats::queriesValid;
+	else		++stats::queriesInvalid;
+
+	if (!is_sat[0] && !is_sat[1]) {
+		SMTPrinter::dump(q, "incons");
+		klee_warning("Inconsistent Model. Killing Solver");
+		failQuery();
+		return Solver::Unknown;
+	}
+
+	if (!is_sat[0]) return Solver::False;
+	if (!is_sat[1]) return Solver::True;
+	return Solver::Unknown;
+}
+
+/* Same as the raced computeValidity, except nothing waits here. The
+ * executor parks the state that asked and picks the answer up with
+ * pollAsync() once a solver process writes it. */
+bool PipeSolverImpl::submitAsync(const Query& q)
+{
+	Expr::Hash	key(q.hash());
+	AsyncQuery	aq;
+
+	if (async_queries.count(key))
+		return true;
+
+	if (async_queries.size() >= std::max(1U, (unsigned)PipeSolverPool))
+		return false;
+
+	aq.pss[0] = setupCachedSolver(fmt->getArgvSAT());
+	aq.pss[1] = setupCachedSolver(fmt->getArgvSAT());
+	if (	aq.pss[0] == NULL || aq.pss[1] == NULL ||
+		!aq.pss[0]->sendSAT(q) ||
+		!aq.pss[1]->sendSAT(q.negateExpr()))
+	{
+		delete aq.pss[0];
+		delete aq.pss[1];
+		return false;
+	}
+
+	aq.expr = q.expr;
+	aq.deadline = (timeout > 0.0)
+		? util::getWallTime() + timeout
+		: 0.0;
+	aq.done[0] = aq.done[1] = false;
+	aq.is_sat[0] = aq.is_sat[1] = false;
+	async_queries[key] = aq;
+	return true;
+}
+
+bool PipeSolverImpl::recvAsync(AsyncQuery& aq, unsigned i)
+{
+	Query	q(aq.expr);
+	bool	ok;
+
+	/* readable; the solver has started writing its answer */
+	ok = aq.pss[i]->recvSAT((i == 0) ? q : q.negateExpr(), fmt, 1.0);
+	aq.done[i] = true;
+	aq.is_sat[i] = fmt->isSAT();
+	if (!ok)
+		return false;
+
+	if (aq.is_sat[i])	++stats::queriesValid;
+	else			++stats::queriesInvalid;
+	return true;
+}
+
+/* true once 'ans' holds the query's final answer */
+bool PipeSolverImpl::finishAsync(AsyncQuery& aq, PipeAnswer& ans)
+{
+	ans.ok = true;
+
+	if (aq.done[0] && !aq.is_sat[0] && !DoubleCheckValidity) {
+		ans.v = Solver::False;
+		return true;
+	}
+
+	if (!aq.done[0] || !aq.done[1])
+		return false;
+
+	if (!aq.is_sat[0] && !aq.is_sat[1]) {
+		klee_warning("Inconsistent async model; querying again");
+		ans.ok = false;
+		return true;
+	}
+
+	if (!aq.is_sat[0]) ans.v = Solver::False;
+	else if (!aq.is_sat[1]) ans.v = Solver::True;
+	else ans.v = Solver::Unknown;
+
+	return true;
+}
+
+void PipeSolverImpl::pollAsync(std::vector<PipeAnswer>& done, bool block)
+{
+	do {
+		struct timeval	tv, *tvp;
+		fd_set		rdset;
+		int		max_fd = -1;
+		double		now = util::getWallTime(), wait = -1.0;
+
+		FD_ZERO(&rdset);
+		foreach (it, async_queries.begin(), async_queries.end()) {
+			AsyncQuery	&aq(it->second);
+
+			for (unsigned i = 0; i < 2; i++) {
+				int	fd;
+
+				if (aq.done[i])
+					continue;
+				fd = aq.pss[i]->getReadFD();
+				FD_SET(fd, &rdset);
+				max_fd = std::max(max_fd, fd);
+			}
+
+			if (aq.deadline > 0.0) {
+				double	left(std::max(aq.deadline - now, 0.0));
+				wait = (wait < 0.0) ? left : std::min(wait, left);
+			}
+		}
+
+		if (max_fd < 0)
+			return;
+
+		/* no deadline => block until some solver writes */
+		tvp = NULL;
+		if (!block || wait >= 0.0) {
+			if (!block) wait = 0.0;
+			tv.tv_sec = (time_t)wait;
+			tv.tv_usec = (wait - tv.tv_sec)*1000000;
+			tvp = &tv;
+		}
+
+		if (select(max_fd+1, &rdset, NULL, NULL, tvp) < 0) {
+			if (errno == EINTR)
+				continue;
+			return;
+		}
+
+		now = util::getWallTime();
+		for (auto it = async_queries.begin(); it != async_queries.end();) {
+			AsyncQuery	&aq(it->second);
+			PipeAnswer	ans;
+			bool		ok = true;
+
+			ans.key = it->first;
+			for (unsigned i = 0; i < 2 && ok; i++) {
+				if (aq.done[i])
+					continue;
+				if (!FD_ISSET(aq.pss[i]->getReadFD(), &rdset))
+					continue;
+				ok = recvAsync(aq, i);
+			}
+
+			if (ok && aq.deadline > 0.0 && now > aq.deadline) {
+				if (DumpSnooze)
+					SMTPrinter::dump(Query(aq.expr), "snooze");
+				ok = false;
+			}
+
+			if (ok && !finishAsync(aq, ans)) {
+				++it;
+				continue;
+			}
+
+			/* failed => the executor asks again, synchronously */
+			if (!ok)
+				ans.ok = false;
+
+			delete aq.pss[0];
+			delete aq.pss[1];
+			done.push_back(ans);
+			it = async_queries.erase(it);
+		}
+	} while (block && done.empty() && !async_queries.empty());
+}
+
+void PipeSolverImpl::cancelAsync(void)
+{
+	for (auto &p : async_queries) {
+		delete p.second.pss[0];
+		delete p.second.pss[1];
+	}
+	async_queries.clear();
+}
+
 PipeSolverSession* PipeSolverImpl::setupCachedSolver(const char** argv)
 {
+	PipeSolverSession	*session = NULL;
+
 	/* no preforked solver => no cached solver; create fresh solver */
 	if (PreforkSolver == false)
 		return PipeSolverSession::create(fmt->getExec(), argv);
 
-	/* no preforked solver process; create fresh solver */
-	auto it(cached_sessions.find(argv));
-	if (it == cached_sessions.end() || !it->second) {
+	auto &pool(cached_sessions[argv]);
+
+	/* forked executor workers must not share preforked solvers */
+	for (auto it = pool.begin(); it != pool.end(); ) {
+		if ((*it)->isOwner()) {
+			++it;
+			continue;
+		}
+		(*it)->release();
+		delete *it;
+		it = pool.erase(it);
+	}
+
+	if (!pool.empty()) {
+		prefork_hits++;
+		session = pool.front();
+		pool.pop_front();
+	} else {
+		/* no preforked solver process; create fresh solver */
 		prefork_misses++;
-		cached_sessions[argv] = PipeSolverSession::create(fmt->getExec(), argv);
-		return PipeSolverSession::create(fmt->getExec(), argv);
+		session = PipeSolverSession::create(fmt->getExec(), argv);
 	}
 
-	prefork_hits++;
+	/* keep the pool full; the new solvers start up in the background */
+	while (pool.size() < std::max(1U, (unsigned)PipeSolverPool)) {
+		PipeSolverSession	*pss;
+		pss = PipeSolverSession::create(fmt->getExec(), argv);
+		if (pss == NULL) break;
+		pool.push_back(pss);
+	}
 
-	/* return cached session for immediate use; fork off another session in bg */
-	PipeSolverSession* session(it->second);
-	cached_sessions[argv] = PipeSolverSession::create(fmt->getExec(), argv);
 	return session;
 }
 
 PipeSolverImpl::~PipeSolverImpl(void)
 {
-	for (auto& p : cached_sessions) delete p.second;
+	cancelAsync();
+	for (auto& p : cached_sessions) {
+		for (auto pss : p.second) {
+			if (!pss->isOwner())
+				pss->release();
+			delete pss;
+		}
+	}
 	cached_sessions.clear();
 	delete fmt;
 }
+
+PipePortfolio::PipePortfolio(const std::vector<PipeFormat*>& fmts)
+: TimedSolver(new PipePortfolioImpl(fmts))
+{}
+
+void PipePortfolio::setTimeout(double in_timeout)
+{
+	static_cast<PipePortfolioImpl*>(impl)->setTimeout(in_timeout);
+}
+
+PipePortfolioImpl::PipePortfolioImpl(const std::vector<PipeFormat*>& fmts)
+: timeout(-1.0)
+{
+	assert (!fmts.empty());
+	for (auto fmt : fmts)
+		backends.push_back(new PipeSolverImpl(fmt));
+}
+
+PipePortfolioImpl::~PipePortfolioImpl(void)
+{
+	if (PortfolioDumpStats)
+		dumpStats(std::cerr);
+	for (auto be : backends)
+		delete be;
+}
+
+void PipePortfolioImpl::setTimeout(double in_timeout)
+{
+	timeout = in_timeout;
+	for (auto be : backends)
+		be->setTimeout(in_timeout);
+}
+
+void PipePortfolioImpl::printName(int level) const
+{
+	std::string	names;
+
+	for (auto be : backends) {
+		if (!names.empty()) names += ",";
+		names += be->fmt->getName();
+	}
+
+	klee_message(
+		(std::string("%*s PipePortfolioImpl(") + names + ")").c_str(),
+		2*level, "");
+}
+
+static unsigned log2_bucket(unsigned x)
+{
+	unsigned	r = 0;
+	while (x >>= 1) r++;
+	return r;
+}
+
+uint32_t PipePortfolioImpl::getShape(const Query& q, bool model)
+{
+	unsigned	n_reads = 0;
+
+	for (unsigned i = 0; i < q.constraints.size(); i++)
+		n_reads += q.constraints.getReadset(i)->size();
+
+	return	(model ? 1 : 0) |
+		(log2_bucket(q.constraints.size() + 1) << 1) |
+		(log2_bucket(n_reads + 1) << 8);
+}
+
+void PipePortfolioImpl::pickBackends(
+	ShapeStats& ss, std::vector<unsigned>& which) const
+{
+	unsigned	best = 0;
+
+	which.clear();
+
+	if (	ss.races >= PortfolioWarmup &&
+		(ss.races + ss.routed) % std::max(1U, (unsigned)PortfolioExplore))
+	{
+		for (unsigned i = 1; i < ss.wins.size(); i++)
+			if (ss.wins[i] > ss.wins[best])
+				best = i;
+
+		if (ss.wins[best] * 100 >= ss.races * PortfolioRoutePct) {
+			which.push_back(best);
+			return;
+		}
+	}
+
+	for (unsigned i = 0; i < backends.size(); i++)
+		which.push_back(i);
+}
+
+/* returns index of the backend that answered first, -1 if none did */
+int PipePortfolioImpl::race(
+	const Query& q, bool model, const std::vector<unsigned>& which)
+{
+	std::vector<PipeSolverSession*>	pss(backends.size(), NULL);
+	unsigned			live = 0;
+	double				deadline;
+	int				winner = -1;
+
+	for (auto i : which) {
+		PipeFormat	*fmt = backends[i]->fmt;
+
+		pss[i] = backends[i]->setupCachedSolver(
+			model ? fmt->getArgvModel() : fmt->getArgvSAT());
+		if (pss[i] == NULL)
+			continue;
+
+		if (!pss[i]->send(model ? q : q.negateExpr())) {
+			delete pss[i];
+			pss[i] = NULL;
+			continue;
+		}
+
+		live++;
+	}
+
+	deadline = util::getWallTime() + timeout;
+	while (winner < 0 && live > 0) {
+		struct timeval	tv, *tvp = NULL;
+		fd_set		rdset;
+		int		max_fd = -1, rc;
+
+		FD_ZERO(&rdset);
+		for (auto s : pss) {
+			if (s == NULL) continue;
+			FD_SET(s->getReadFD(), &rdset);
+			max_fd = std::max(max_fd, s->getReadFD());
+		}
+
+		if (timeout > 0.0) {
+			double	remaining = deadline - util::getWallTime();
+			if (remaining <= 0.0)
+				break;
+			tv.tv_sec = (time_t)remaining;
+			tv.tv_usec = (remaining - tv.tv_sec)*1000000;
+			tvp = &tv;
+		}
+
+		rc = select(max_fd + 1, &rdset, NULL, NULL, tvp);
+		if (rc == -1 && errno == EINTR)
+			continue;
+		if (rc <= 0)
+			break;
+
+		for (unsigned i = 0; i < pss.size(); i++) {
+			double	to = 0.0;
+			bool	ok;
+
+			if (pss[i] == NULL || !FD_ISSET(pss[i]->getReadFD(), &rdset))
+				continue;
+
+			/* readable isn't finished; never 0.0, which waits forever */
+			if (timeout > 0.0)
+				to = std::max(deadline - util::getWallTime(), 1e-3);
+
+			ok = model
+				? pss[i]->recvModel(q, backends[i]->fmt, to)
+				: pss[i]->recvSAT(q, backends[i]->fmt, to);
+			if (ok) {
+				winner = i;
+				break;
+			}
+
+			std::cerr << TAG"PORTFOLIO DROPPED "
+				<< backends[i]->fmt->getName() << " ("
+				<< (void*)q.hash() << ")\n";
+			delete pss[i];
+			pss[i] = NULL;
+			live--;
+		}
+	}
+
+	/* kills the losers */
+	for (auto s : pss)
+		delete s;
+
+	return winner;
+}
+
+PipeFormat* PipePortfolioImpl::runQuery(const Query& q, bool model)
+{
+	std::vector<unsigned>	which;
+	uint32_t		shape;
+	double			start;
+	int			w;
+
+	shape = getShape(q, model);
+	auto it = shapes.find(shape);
+	if (it == shapes.end())
+		it = shapes.insert(
+			std::make_pair(shape, ShapeStats(backends.size()))).first;
+
+	ShapeStats	&ss(it->second);
+
+	pickBackends(ss, which);
+
+	start = util::getWallTime();
+	w = race(q, model, which);
+	if (w < 0) {
+		/* favorite let us down; relearn this shape */
+		if (which.size() == 1)
+			ss = ShapeStats(backends.size());
+		return NULL;
+	}
+
+	if (which.size() > 1) {
+		ss.races++;
+		ss.wins[w]++;
+	} else
+		ss.routed++;
+	ss.win_time[w] += util::getWallTime() - start;
+
+	return backends[w]->fmt;
+}
+
+bool PipePortfolioImpl::computeSat(const Query& q)
+{
+	TimerStatIncrementer	t(stats::queryTime);
+	PipeFormat		*fmt;
+	bool			is_sat;
+
+	++stats::queries;
+	if ((fmt = runQuery(q, false)) == NULL) {
+		std::cerr << TAG"PORTFOLIO FAILED SAT ("
+			<< (void*)q.hash() << ")\n";
+		failQuery();
+		return false;
+	}
+
+	is_sat = fmt->isSAT();
+	if (is_sat)	++stats::queriesValid;
+	else		++stats::queriesInvalid;
+
+	return is_sat;
+}
+
+bool PipePortfolioImpl::computeInitialValues(const Query& q, Assignment& a)
+{
+	TimerStatIncrementer	t(stats::queryTime);
+	PipeFormat		*fmt;
+	bool			is_sat;
+
+	++stats::queries;
+	if ((fmt = runQuery(q, true)) == NULL) {
+		std::cerr << TAG"PORTFOLIO FAILED MODEL ("
+			<< (void*)q.hash() << ")\n";
+		failQuery();
+		return false;
+	}
+
+	is_sat = fmt->isSAT();
+	if (is_sat) ++stats::queriesValid;
+	else ++stats::queriesInvalid;
+
+	if (is_sat) {
+		forall_drain (it, a.freeBegin(), a.freeEnd()) {
+			std::vector<unsigned char>	v;
+			fmt->readArray(*it, v);
+			a.bindFree(*it, v);
+		}
+	}
+
+	return is_sat;
+}
+
+void PipePortfolioImpl::dumpStats(std::ostream& os) const
+{
+	for (const auto& p : shapes) {
+		const ShapeStats	&ss(p.second);
+
+		os << TAG"shape " << ((p.first & 1) ? "model" : "sat")
+			<< " cons~2^" << ((p.first >> 1) & 0x7f)
+			<< " reads~2^" << (p.first >> 8)
+			<< ": races=" << ss.races
+			<< " routed=" << ss.routed;
+		for (unsigned i = 0; i < backends.size(); i++) {
+			os << ' ' << backends[i]->fmt->getName()
+				<< '=' << ss.wins[i]
+				<< '/' << ss.win_time[i] << 's';
+		}
+		os << '\n';
+	}
+}
@@ -7,16 +7,35 @@
 #include "PipeFormat.h"
 #include <ext/stdio_filebuf.h>
 #include <list>
+#include <map>
 #include <set>
+#include <vector>
 
 namespace klee
 {
+/* answer to a validity query sent with PipeSolver::submitAsync */
+struct PipeAnswer
+{
+	Expr::Hash		key;
+	bool			ok;
+	Solver::Validity	v;
+};
+
 class PipeSolver : public TimedSolver /* XXX: timing lipservice */
 {
 public:
 	PipeSolver(PipeFormat* fmt);
 	virtual ~PipeSolver(void);
 	virtual void setTimeout(double in_timeout);
+
+	/* Starts a validity check on the solver pool and returns without
+	 * waiting. The answer is keyed by q.hash(). False if the pool is
+	 * busy or the query could not be sent. */
+	bool submitAsync(const Query& q);
+	/* collects finished answers; 'block' waits for at least one */
+	void pollAsync(std::vector<PipeAnswer>& done, bool block);
+	void cancelAsync(void);
+	unsigned numAsync(void) const;
 };
 
 class PipeSolverSession;
@@ -28,6 +47,7 @@ public:
 	PipeSolverImpl(PipeFormat* fmt);
 	~PipeSolverImpl();
 
+	virtual Solver::Validity computeValidity(const Query&);
 	virtual bool computeSat(const Query&);
 	virtual bool computeInitialValues(const Query&, Assignment&);
 
@@ -40,13 +60,81 @@ public:
 	}
 
 	void setTimeout(double in_timeout) { timeout = in_timeout; }
+
+	bool submitAsync(const Query& q);
+	void pollAsync(std::vector<PipeAnswer>& done, bool block);
+	void cancelAsync(void);
+	unsigned numAsync(void) const { return async_queries.size(); }
 private:
+	friend class PipePortfolioImpl;
+
+	/* both polarities of an async validity check */
+	struct AsyncQuery
+	{
+		PipeSolverSession	*pss[2];
+		ref<Expr>		expr;
+		double			deadline;
+		bool			done[2];
+		bool			is_sat[2];
+	};
+
 	PipeSolverSession* setupCachedSolver(const char** argv);
+	bool recvAsync(AsyncQuery& aq, unsigned i);
+	bool finishAsync(AsyncQuery& aq, PipeAnswer& ans);
 	PipeFormat	*fmt;
-	std::map<const char**, PipeSolverSession*> cached_sessions;
+	std::map<const char**, std::list<PipeSolverSession*>> cached_sessions;
+	std::map<Expr::Hash, AsyncQuery>	async_queries;
 	double		timeout;
 	static uint64_t	prefork_misses;
 	static uint64_t prefork_hits;
 };
+
+/* races several pipe solvers on a query; first answer wins */
+class PipePortfolio : public TimedSolver
+{
+public:
+	PipePortfolio(const std::vector<PipeFormat*>& fmts);
+	virtual ~PipePortfolio(void) {}
+	virtual void setTimeout(double in_timeout);
+};
+
+/* Every backend gets its own solver process per query; the first to
+ * answer wins and the rest are killed. Wins are tallied per query
+ * shape (query type, constraint count and read count, log2-bucketed)
+ * so once a shape has a clear favorite, its queries go only to that
+ * backend, with an occasional full race to keep the tally honest. */
+class PipePortfolioImpl : public SolverImpl
+{
+public:
+	PipePortfolioImpl(const std::vector<PipeFormat*>& fmts);
+	~PipePortfolioImpl();
+
+	virtual bool computeSat(const Query&);
+	virtual bool computeInitialValues(const Query&, Assignment&);
+
+	virtual void printName(int level = 0) const;
+
+	void setTimeout(double in_timeout);
+	void dumpStats(std::ostream& os) const;
+private:
+	struct ShapeStats
+	{
+		ShapeStats(unsigned n)
+		: races(0), routed(0), wins(n, 0), win_time(n, 0.0) {}
+		unsigned		races;
+		unsigned		routed;
+		std::vector<unsigned>	wins;
+		std::vector<double>	win_time;
+	};
+
+	static uint32_t getShape(const Query& q, bool model);
+	void pickBackends(ShapeStats& ss, std::vector<unsigned>& which) const;
+	int race(const Query& q, bool model, const std::vector<unsigned>& which);
+	PipeFormat* runQuery(const Query& q, bool model);
+
+	std::vector<PipeSolverImpl*>		backends;
+	std::map<uint32_t, ShapeStats>		shapes;
+	double					timeout;
+};
 }
 #endif
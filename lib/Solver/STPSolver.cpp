@@ -22,6 +22,8 @@
 using namespace llvm;
 using namespace klee;
 
+extern bool IncrementalSolver;
+
 namespace
 {
   cl::opt<bool>
@@ -171,6 +173,7 @@ static void initVC(VC& vc)
 STPSolverImpl::STPSolverImpl(STPSolver *_solver, bool _useForkedSTP)
 : timeout(0.0)
 , useForkedSTP(_useForkedSTP)
+, incremental(IncrementalSolver)
 {
 	initVC(vc);
 	assert(vc && "unable to create validity checker");
@@ -190,16 +193,37 @@ STPSolverImpl::STPSolverImpl(STPSolver *_solver, bool _useForkedSTP)
 
 STPSolverImpl::~STPSolverImpl()
 {
+	popAsserted(asserted.size());
 	delete builder;
 	vc_Destroy(vc);
 }
 
 /***/
 
-STPSolver::STPSolver(bool useForkedSTP, sockaddr_in_opt stpServer)
-: TimedSolver(stpServer.null()
-	? new STPSolverImpl(this, useForkedSTP)
-	: new ServerSTPSolverImpl(this, useForkedSTP, stpServer))
+static SolverImpl* createSTPImpl(
+	STPSolver* s,
+	bool useForkedSTP,
+	sockaddr_in_opt& stpServer,
+	const char* stpServerShm)
+{
+	if (stpServerShm != NULL) {
+		SolverShmRing	*ring = solverShmOpen(stpServerShm, false);
+		if (ring == NULL)
+			klee_error("cannot open solverd ring '%s'", stpServerShm);
+		return new ShmSTPSolverImpl(s, useForkedSTP, ring);
+	}
+
+	if (!stpServer.null())
+		return new ServerSTPSolverImpl(s, useForkedSTP, stpServer);
+
+	return new STPSolverImpl(s, useForkedSTP);
+}
+
+STPSolver::STPSolver(
+	bool useForkedSTP,
+	sockaddr_in_opt stpServer,
+	const char* stpServerShm)
+: TimedSolver(createSTPImpl(this, useForkedSTP, stpServer, stpServerShm))
 {}
 
 void STPSolver::setTimeout(double timeout)
@@ -281,9 +305,6 @@ bool ServerSTPSolverImpl::talkToServer(
   stpRequest.timeout_sec = floor(timeout);
   stpRequest.timeout_usec = floor(1000000 * (timeout - floor(timeout)));
   stpRequest.length = qlen;
-  std::vector< std::vector<unsigned char> >	values;
-  std::vector< const Array* >			objects(a.getObjectVector());
-
 
   // prepare TCP socket
   class FileDescriptor
@@ -343,6 +364,22 @@ bool ServerSTPSolverImpl::talkToServer(
   // receive and parse counter-example if necessary
   if (!hasSolution) return true;
 
+  // receive counter-examples
+  std::vector<CexItem> items(cexHeader.rows);
+  if (!recvall(fd, items.data(), items.size() * sizeof(CexItem), timeout, tExpire))
+    return false;
+
+  bindServerCex(a, items.data(), items.size());
+  return true;
+}
+
+/* rows are in network order, as solverd sends them */
+void ServerSTPSolverImpl::bindServerCex(
+	Assignment& a, const CexItem* items, unsigned rows)
+{
+  std::vector< std::vector<unsigned char> >	values;
+  std::vector< const Array* >			objects(a.getObjectVector());
+
   // initialize all counter-example values to 0
   ResultHolder_Vector rh(values);
   rh.reserve(objects.size());
@@ -355,11 +392,8 @@ bool ServerSTPSolverImpl::talkToServer(
       rh.newByte(0);
   }
 
-  // receive counter-examples
-  for (unsigned i = 0; i < cexHeader.rows; i++) {
-    CexItem cex;
-    if (!recvall(fd, &cex, sizeof(cex), timeout, tExpire))
-      return false;
+  for (unsigned i = 0; i < rows; i++) {
+    CexItem cex = items[i];
     cex.id = ntohl(cex.id);
     cex.offset = ntohl(cex.offset);
 
@@ -388,8 +422,66 @@ bool ServerSTPSolverImpl::talkToServer(
 
   for (unsigned i = 0; i < objects.size(); i++)
   	a.bindFree(objects[i], values[i]);
+}
 
-  return true;
+bool ShmSTPSolverImpl::talkToServer(
+	double timeout, const char* qstr, unsigned long qlen,
+	Assignment& a,
+	bool &hasSolution)
+{
+	SolverShmSlot		*slot;
+	STPReqHdr		req;
+	const STPResHdr		*res;
+	unsigned		wait_ms;
+	uint32_t		st;
+
+	slot = solverShmClaim(ring);
+	if (slot == NULL) {
+		/* more queries in flight than slots; shouldn't happen */
+		klee_warning_once(0, "solverd ring full");
+		return false;
+	}
+
+	if (sizeof(req) + qlen > sizeof(slot->data)) {
+		klee_warning_once(0, "query too large for solverd ring");
+		slot->state = SHM_SLOT_FREE;
+		return false;
+	}
+
+	/* written once, straight into the slot; host order */
+	req.timeout_sec = floor(timeout);
+	req.timeout_usec = floor(1000000 * (timeout - floor(timeout)));
+	req.length = qlen;
+	memcpy(slot->data, &req, sizeof(req));
+	memcpy(slot->data + sizeof(req), qstr, qlen);
+	slot->len = sizeof(req) + qlen;
+	solverShmPost(ring, slot);
+
+	/* leave solverd a second past the solver timeout */
+	wait_ms = (timeout > 0) ? (unsigned)(1000*timeout) + 1000 : 0;
+	while ((st = slot->state) == SHM_SLOT_REQ || st == SHM_SLOT_BUSY) {
+		if (!solverShmWait(&slot->state, st, wait_ms)) {
+			klee_warning("solverd ring query timed out");
+			solverShmAbandon(slot);
+			return false;
+		}
+	}
+
+	if (st != SHM_SLOT_RES) {
+		slot->state = SHM_SLOT_FREE;
+		return false;
+	}
+
+	res = (const STPResHdr*)slot->data;
+	if (res->result != 'V' && res->result != 'I')
+		klee_error("Invalid query result");
+
+	hasSolution = (res->result == 'I');
+	if (hasSolution)
+		bindServerCex(a, (const CexItem*)(res + 1), ntohl(res->rows));
+
+	slot->state = SHM_SLOT_FREE;
+	return true;
 }
 
 bool ServerSTPSolverImpl::computeInitialValues(
@@ -408,7 +500,7 @@ bool ServerSTPSolverImpl::computeInitialValues(
 
 	vc_printQueryStateToBuffer(vc, stp_e, &qstr, &qlen, false);
 
-	vc_pop(vc);
+	finishVCQuery(true);
 
 	// don't send null terminator (STP's yacc rejects it)
 	qlen--;
@@ -532,14 +624,61 @@ static bool recvall(int fd, void* vp, size_t sz, bool timeout, timeval& tExpire)
 }
 
 
+void STPSolverImpl::popAsserted(unsigned n)
+{
+	assert (n <= asserted.size());
+	for (unsigned i = 0; i < n; i++)
+		vc_pop(vc);
+	asserted.resize(asserted.size() - n);
+}
+
+/* States along a path share their constraint prefix; keep each
+ * constraint on its own push level so the next query only pops back
+ * to where it diverges instead of re-asserting everything. */
+void STPSolverImpl::syncAsserted(const ConstraintManager& cs)
+{
+	ConstraintManager::constraint_iterator	it(cs.begin());
+	unsigned				n = 0;
+
+	while (	n < asserted.size() && it != cs.end() &&
+		asserted[n] == *it)
+	{
+		n++;
+		++it;
+	}
+
+	popAsserted(asserted.size() - n);
+
+	for (; it != cs.end(); ++it) {
+		vc_push(vc);
+		vc_assertFormula(vc, builder->construct(*it));
+		asserted.push_back(*it);
+	}
+}
+
+void STPSolverImpl::finishVCQuery(bool success)
+{
+	if (!incremental) {
+		vc_pop(vc);
+		return;
+	}
+
+	/* don't trust the context after a bad query */
+	if (!success)
+		popAsserted(asserted.size());
+}
+
 void STPSolverImpl::setupVCQuery(
 	const Query& query, ExprHandle& stp_e, std::ostream& os)
 {
-	vc_push(vc);
+	if (incremental) {
+		syncAsserted(query.constraints);
+	} else {
+		vc_push(vc);
+		foreach (it, query.constraints.begin(), query.constraints.end())
+			vc_assertFormula(vc, builder->construct(*it));
+	}
 
-	foreach (it, query.constraints.begin(), query.constraints.end())
-		vc_assertFormula(vc, builder->construct(*it));
-	
 	++stats::queries;
 	++stats::queryCounterexamples;
 
@@ -587,7 +726,7 @@ bool STPSolverImpl::computeInitialValues(
 		failQuery();
 	}
 
-	vc_pop(vc);
+	finishVCQuery(success);
 
 	if (DebugPrintQueries)
 		printDebugQueries(os, t.check(), a, hasSolution);
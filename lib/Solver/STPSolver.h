@@ -4,6 +4,7 @@
 #include "klee/Solver.h"
 #include "SolverImpl.h"
 #include "STPBuilder.h"
+#include "klee/SolverShm.h"
 
 namespace klee
 {
@@ -21,7 +22,13 @@ protected:
   STPBuilder *builder;
   double timeout;
   bool useForkedSTP;
+  bool incremental;
+  /* constraint asserted at each push level, when incremental */
+  std::vector< ref<Expr> > asserted;
   void setupVCQuery(const Query& query, ExprHandle& stp_e, std::ostream& os);
+  void finishVCQuery(bool success);
+  void syncAsserted(const ConstraintManager& cs);
+  void popAsserted(unsigned n);
   void printDebugQueries(
 	std::ostream& os,
 	double t_check,
@@ -54,11 +61,39 @@ public:
     klee_message("%*s" "ServerSTPSolverImpl", 2*level, "");
   }
 
-private:
-  bool talkToServer(
+protected:
+  virtual bool talkToServer(
+  	double timeout, const char* query, unsigned long qlen,
+	Assignment& a,
+	bool &hasSolution);
+  void bindServerCex(
+	Assignment& a,
+	const CexItem* items,
+	unsigned rows);
+};
+
+/* solverd on the same host, reached through a shared memory ring;
+ * the query is the same CVC text ServerSTPSolverImpl sends */
+class ShmSTPSolverImpl : public ServerSTPSolverImpl
+{
+public:
+  ShmSTPSolverImpl(
+  	STPSolver *_solver, bool _useForkedSTP, SolverShmRing* _ring)
+  : ServerSTPSolverImpl(_solver, _useForkedSTP, sockaddr_in_opt())
+  , ring(_ring) {}
+  virtual ~ShmSTPSolverImpl() { solverShmClose(ring); }
+
+  void printName(int level = 0) const {
+    klee_message("%*s" "ShmSTPSolverImpl", 2*level, "");
+  }
+
+protected:
+  virtual bool talkToServer(
   	double timeout, const char* query, unsigned long qlen,
 	Assignment& a,
 	bool &hasSolution);
+private:
+  SolverShmRing	*ring;
 };
 
 }
@@ -39,6 +39,7 @@
 #include <vector>
 #include <iostream>
 #include <string>
+#include <sstream>
 
 #include <netdb.h>
 #include <errno.h>
@@ -52,27 +53,42 @@ using namespace llvm;
 bool	UseFastCexSolver;
 bool	UseHashSolver;
 double	MaxSTPTime;
+bool	IncrementalSolver;
 
 uint64_t SolverImpl::impliedValid_c = 0;
 uint64_t Solver::getVal_c = 0;
 
-namespace {
-  cl::opt<bool> DebugValidateSolver("debug-validate-solver");
-
-  cl::opt<bool>
-  UseHashCmp("use-hash-cmp", cl::desc("Compare two hashes on queries."));
-
+namespace llvm {
+  /* ExeWorkers rejects it alongside -exe-workers */
   cl::opt<bool>
   UseForkedSTP("use-forked-stp", cl::desc("Run STP in forked process"));
 
+  /* PipeSolver's raced validity check honors it too */
   cl::opt<bool>
   DoubleCheckValidity("double-check-validity",
   	cl::desc("Check for SAT on expr and NOT-expr even if one is unsat"));
+}
+
+namespace {
+  cl::opt<bool> DebugValidateSolver("debug-validate-solver");
+
+  cl::opt<bool>
+  UseHashCmp("use-hash-cmp", cl::desc("Compare two hashes on queries."));
 
   cl::opt<sockaddr_in_opt> STPServer("stp-server", cl::value_desc("host:port"));
 
+  cl::opt<std::string>
+  STPServerShm(
+	"stp-server-shm",
+	cl::desc("Shared memory ring of a solverd on this host (solverd -shm)"),
+	cl::init(""));
+
   cl::opt<bool> UseSTPQueryPCLog("use-stp-query-pc-log");
   cl::opt<bool> UseSMTQueryLog("use-smt-log");
+  cl::opt<bool>
+  UseBinQueryLog(
+	"use-bin-query-log",
+	cl::desc("Log solver queries in compact binary (kleaver -exprfmt=bin)"));
 
   cl::opt<bool> UseRandomGetValue("randomize-getvalue");
 
@@ -95,6 +111,13 @@ namespace {
 	cl::location(MaxSTPTime),
         cl::init(5.0));
 
+  cl::opt<bool, true>
+  ProxyIncrementalSolver(
+	"solver-incremental",
+	cl::desc("Keep constraint prefixes asserted between queries (STP)"),
+	cl::location(IncrementalSolver),
+	cl::init(false));
+
   cl::opt<bool>
   UseFastRangeSolver(
 	"use-fast-range-solver", cl::desc("Use the fast range solver."));
@@ -136,6 +159,11 @@ namespace {
   	cl::init(true),
   	cl::desc("Run solver through forked pipe."));
 
+  cl::opt<std::string>
+  SolverPortfolio("solver-portfolio",
+	cl::desc("Race these pipe solvers on each query (e.g. stp,z3,boolector)"),
+	cl::init(""));
+
   cl::opt<bool>
   UseIndependentSolver("use-independent-solver",
                        cl::init(true),
@@ -155,7 +183,10 @@ namespace {
 }
 
 namespace klee
-{ extern Solver *createSMTLoggingSolver(Solver *_solver, std::string path); }
+{
+extern Solver *createSMTLoggingSolver(Solver *_solver, std::string path);
+extern Solver *createBinLoggingSolver(Solver *_solver, std::string path);
+}
 
 extern ExprBuilder *createXChkBuilder(
 	Solver& solver,
@@ -180,6 +211,8 @@ Solver* Solver::createChainWithTimedSolver(
 		solver = createPCLoggingSolver(solver, stpQueryPCLogPath);
 	else if (UseSMTQueryLog && stpQueryPCLogPath.size())
 		solver = createSMTLoggingSolver(solver, stpQueryPCLogPath);
+	else if (UseBinQueryLog && stpQueryPCLogPath.size())
+		solver = createBinLoggingSolver(solver, stpQueryPCLogPath);
 
 	if (UseTautologyChecker) {
 		taut_checker = new TautologyChecker(solver);
@@ -486,8 +519,48 @@ void SolverImpl::failQuery(void)
 	has_failed = true;
 }
 
+static PipeFormat* createPipeFormat(const std::string& name)
+{
+	if (name == "stp") return new PipeSTP();
+	if (name == "z3") return new PipeZ3();
+	if (name == "boolector") return new PipeBoolector();
+	if (name == "cvc4") return new PipeCVC4();
+	if (name == "yices") return new PipeYices();
+	if (name == "yices2") return new PipeYices2();
+	return NULL;
+}
+
+static TimedSolver* createPortfolio(void)
+{
+	std::vector<PipeFormat*>	fmts;
+	std::stringstream		ss(SolverPortfolio);
+	std::string			name;
+
+	while (std::getline(ss, name, ',')) {
+		PipeFormat	*fmt;
+
+		if (name.empty())
+			continue;
+
+		if ((fmt = createPipeFormat(name)) == NULL) {
+			klee_warning("unknown portfolio solver '%s'", name.c_str());
+			continue;
+		}
+
+		fmts.push_back(fmt);
+	}
+
+	if (fmts.empty())
+		klee_error("no usable solvers in -solver-portfolio");
+
+	return new PipePortfolio(fmts);
+}
+
 TimedSolver* TimedSolver::create(void)
 {
+	if (!SolverPortfolio.empty())
+		return createPortfolio();
+
 	if (UsePipeSolver) {
 		if (UseYices) return new PipeSolver(new PipeYices());
 		if (UseYices2) return new PipeSolver(new PipeYices2());
@@ -512,5 +585,8 @@ TimedSolver* TimedSolver::create(void)
 #else
 	assert (!UseZ3 && "Set configure flag --with-z3");
 #endif
-	return new STPSolver(UseForkedSTP, STPServer);
+	return new STPSolver(
+		UseForkedSTP,
+		STPServer,
+		STPServerShm.empty() ? NULL : STPServerShm.c_str());
 }
@@ -19,6 +19,9 @@ Statistic stats::queriesTopLevel("QueriesTopLevel", "QTL");
 Statistic stats::queriesInvalid("QueriesInvalid", "Qiv");
 Statistic stats::queriesValid("QueriesValid", "Qv");
 Statistic stats::queriesFailed("QueriesFailed", "Qf");
+Statistic stats::queriesRaced("QueriesRaced", "Qrace");
+Statistic stats::queriesAsync("QueriesAsync", "Qasync");
+Statistic stats::queriesAsyncHits("QueriesAsyncHits", "Qasynchits");
 Statistic stats::queryCacheHits("QueryCacheHits", "QChits") ;
 Statistic stats::queryCacheMisses("QueryCacheMisses", "QCmisses");
 Statistic stats::queryConstructTime("QueryConstructTime", "QBtime") ;
@@ -0,0 +1,71 @@
+#!/bin/bash
+#
+# Replays a corpus of query logs through several solver chain configs.
+# Usage: bench_solver.sh [corpus_dir [out_dir [baseline_dir]]]
+#
+# The default corpus is scripts/solver-corpus, a small fixed set of logs
+# checked into the tree so runs from different builds compare directly.
+#
+# Each config gets out_dir/<config>.txt with the kleaver -bench output
+# for every log. If baseline_dir is given, total times are compared and
+# configs that got more than 10% slower are reported.
+
+CORPUS="$1"
+OUTDIR="$2"
+BASEDIR="$3"
+KLEAVER=${KLEAVER:-kleaver}
+
+if [ -z "$CORPUS" ]; then
+	CORPUS=`dirname "$0"`/solver-corpus
+fi
+
+if [ ! -d "$CORPUS" ]; then
+	echo "usage: $0 [corpus_dir [out_dir [baseline_dir]]]"
+	exit 1
+fi
+
+if [ -z "$OUTDIR" ]; then
+	OUTDIR="solver-bench"
+fi
+mkdir -p "$OUTDIR"
+
+CONFIGS=(
+"default:"
+"nocex:-use-cex-cache=false"
+"nocache:-use-cache=false -use-cex-cache=false"
+"noindep:-use-independent-solver=false"
+"fastrange:-use-fast-range-solver"
+"hash:-use-hash-solver"
+"stp:-pipe-solver=false"
+"stp-incr:-pipe-solver=false -solver-incremental"
+"z3:-use-z3"
+"boolector:-use-boolector"
+"portfolio:-solver-portfolio=stp,z3,boolector" )
+
+ret=0
+for cfg in "${CONFIGS[@]}"; do
+	name=`echo "$cfg" | cut -f1 -d':'`
+	flags=`echo "$cfg" | cut -f2- -d':'`
+	out="$OUTDIR/$name.txt"
+
+	rm -f "$out"
+	for pc in `ls "$CORPUS"/*.pc | sort`; do
+		echo "== $pc" >>"$out"
+		$KLEAVER -bench $flags "$pc" >>"$out" 2>/dev/null
+	done
+
+	t=`grep "^total time" "$out" | cut -f2 -d'=' | tr -d 's ' | paste -sd+ | bc`
+	echo "$name: $t s"
+
+	if [ -z "$BASEDIR" ] || [ ! -f "$BASEDIR/$name.txt" ]; then
+		continue
+	fi
+
+	bt=`grep "^total time" "$BASEDIR/$name.txt" | cut -f2 -d'=' | tr -d 's ' | paste -sd+ | bc`
+	if [ `echo "$t > $bt * 1.1" | bc` -eq 1 ]; then
+		echo "$name: REGRESSION $bt s -> $t s"
+		ret=1
+	fi
+done
+
+exit $ret
@@ -0,0 +1,22 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t.bc
+// RUN: %klee --pipe-solver --async-solver --pipe-solver-pool=4 %t.bc > %t.log
+// RUN: ls klee-last/ | grep -c "ktest.gz" | grep -w 16
+// RUN: sort %t.log | uniq -c | grep -c " 1 " | grep -w 16
+// RUN: grep "done: async queries" klee-last/info
+// RUN: grep "done: async queries" klee-last/info | not grep "answers used: 0)"
+
+#include <stdio.h>
+
+int main(int argc, char **argv) {
+  unsigned char c;
+  unsigned i, n = 0;
+
+  klee_make_symbolic(&c, sizeof(c));
+  for (i = 0; i < 4; i++) {
+    if (c & (1 << i))
+      n |= 1 << i;
+  }
+
+  printf("%u\n", n);
+  return 0;
+}
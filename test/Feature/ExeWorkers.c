@@ -0,0 +1,26 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t.bc
+// RUN: %klee --exe-workers=2 --exe-workers-min-states=2 %t.bc > %t.log
+// RUN: ls klee-last/ | grep -c "ktest.gz" | grep -w 16
+// RUN: sort %t.log | uniq -c | grep -c " 1 " | grep -w 16
+// RUN: grep -c "done: total instructions" klee-last/info | grep -w 1
+// RUN: grep "done: generated tests = 16" klee-last/info
+// RUN: grep "done: completed paths = 16" klee-last/info
+// RUN: grep "done: explored paths = 16" klee-last/info
+// RUN: not %klee --exe-workers=2 --use-forked-stp %t.bc 2> %t.err
+// RUN: grep "cannot be used with -use-forked-stp" %t.err
+
+#include <stdio.h>
+
+int main(int argc, char **argv) {
+  unsigned char c;
+  unsigned i, n = 0;
+
+  klee_make_symbolic(&c, sizeof(c));
+  for (i = 0; i < 4; i++) {
+    if (c & (1 << i))
+      n |= 1 << i;
+  }
+
+  printf("%u\n", n);
+  return 0;
+}
@@ -0,0 +1,40 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t.bc
+// RUN: %klee --objdedup-timer=0.1 %t.bc > %t.log 2> %t.err
+// RUN: grep -E "\[ObjDedup\] merged [1-9]" %t.err
+// RUN: grep -c "^ok" %t.log | grep -w 2
+// RUN: not grep "^bad" %t.log
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+int main(int argc, char **argv) {
+  char *buf = malloc(4096);
+  unsigned char c;
+  int id, i;
+  struct timeval t0, t;
+
+  memset(buf, 'x', 4096);
+  klee_make_symbolic(&c, sizeof(c));
+  id = (c & 1) ? 1 : 2;
+
+  /* the first state to run copies buf without changing it, so it matches
+   * the copy the other state still holds until the timer merges them */
+  buf[1] = 'x';
+  /* timers are checked every 0.25s; give the 0.1s one a few chances */
+  gettimeofday(&t0, NULL);
+  do {
+    gettimeofday(&t, NULL);
+  } while ((t.tv_sec - t0.tv_sec) * 1000000 +
+           (t.tv_usec - t0.tv_usec) < 600000);
+
+  /* a merged copy must split again on write */
+  buf[0] = id;
+  for (i = 1; i < 4096; i++)
+    if (buf[i] != 'x')
+      break;
+
+  printf("%s %d\n", (buf[0] == id && i == 4096) ? "ok" : "bad", id);
+  return 0;
+}
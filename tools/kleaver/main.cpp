@@ -14,7 +14,14 @@
 #include "klee/util/ExprPPrinter.h"
 #include "klee/util/ExprVisitor.h"
 #include "klee/util/Assignment.h"
+#include "klee/util/ExprHashMap.h"
+#include "klee/util/ExprBinary.h"
+#include "klee/Internal/ADT/MapOfSets.h"
+#include "klee/Internal/ADT/SetIndex.h"
+#include "klee/Internal/System/Time.h"
+#include "../../lib/Solver/SolverImpl.h"
 #include <unistd.h>
+#include <sstream>
 
 #include <llvm/ADT/StringExtras.h>
 #include <llvm/Support/CommandLine.h>
@@ -32,6 +39,7 @@ enum ExprFormatEnum
 {
 	EXPR_FMT_SMT,
 	EXPR_FMT_KLEE,
+	EXPR_FMT_BIN,
 	EXPR_FMT_END
 };
 
@@ -43,7 +51,9 @@ namespace {
   enum ToolActions {
     PrintTokens,
     PrintAST,
-    Evaluate
+    Evaluate,
+    BenchCexIndex,
+    BenchSolver
   };
 
   static llvm::cl::opt<ToolActions>
@@ -56,6 +66,10 @@ namespace {
                         "Print parsed AST nodes from the input file."),
              clEnumValN(Evaluate, "evaluate",
                         "Print parsed AST nodes from the input file."),
+             clEnumValN(BenchCexIndex, "bench-cex-index",
+                        "Replay query keys through the cex cache indexes."),
+             clEnumValN(BenchSolver, "bench",
+                        "Replay the query log through the solver chain."),
              clEnumValEnd));
 
   static llvm::cl::opt<ExprBuilder::BuilderKind>
@@ -80,6 +94,12 @@ namespace {
   cl::opt<bool>
   UseDummySolver("use-dummy-solver", cl::init(false));
 
+  cl::opt<unsigned>
+  BenchPasses(
+	"bench-passes",
+	cl::desc("Times to replay the log with -bench (warm caches)"),
+	cl::init(1));
+
 	cl::opt<ExprFormatEnum>
 	FmtKind(
 		"exprfmt",
@@ -88,9 +108,40 @@ namespace {
 		llvm::cl::values(
 		clEnumValN(EXPR_FMT_SMT, "smt", "SMTLIB Parser"),
 		clEnumValN(EXPR_FMT_KLEE, "klee", "KLEE Parser"),
+		clEnumValN(EXPR_FMT_BIN, "bin", "Binary query log"),
 		clEnumValEnd));
 }
 
+/* feeds -use-bin-query-log streams to the query commands */
+class BinParser : public Parser
+{
+public:
+	BinParser(const MemoryBuffer *MB)
+	: ss(std::string(MB->getBufferStart(), MB->getBufferSize()))
+	, reader(ss) {}
+	virtual ~BinParser() {}
+
+	void SetMaxErrors(unsigned N) {}
+	unsigned GetNumErrors() const { return reader.hasError() ? 1 : 0; }
+
+	Decl *ParseTopLevelDecl()
+	{
+		std::vector<ref<Expr> >	cs;
+		ref<Expr>		e;
+
+		if (!reader.readQuery(cs, e))
+			return NULL;
+
+		return new QueryCommand(
+			cs, e,
+			std::vector<ExprHandle>(),
+			std::vector<const Array*>());
+	}
+private:
+	std::istringstream	ss;
+	ExprBinReader		reader;
+};
+
 static Parser* createParser(
 	const char *Filename,
 	const MemoryBuffer *MB,
@@ -101,6 +152,8 @@ static Parser* createParser(
 	if(FmtKind == EXPR_FMT_KLEE ) {
 		P = Parser::Create(Filename, MB, Builder);
 		P->SetMaxErrors(20);
+	} else if (FmtKind == EXPR_FMT_BIN) {
+		P = new BinParser(MB);
 	} else {
 		P = SMTParser::Parse(Filename, Builder);
 	}
@@ -318,6 +371,232 @@ static bool EvaluateInputAST(
 	return true;
 }
 
+typedef std::set<ref<Expr> > CexKey;
+
+struct AnyValue { bool operator()(unsigned v) const { return true; } };
+
+/* cex cache access pattern: exact, superset, subset, then insert */
+template<class T>
+static double benchIndex(
+	T& idx, const std::vector<CexKey>& keys, std::vector<int>& hits)
+{
+	double	start = util::getWallTime();
+
+	hits.clear();
+	for (unsigned i = 0; i < keys.size(); i++) {
+		const CexKey	&k(keys[i]);
+		int		hit = 0;
+
+		if (idx.lookup(k))
+			hit = 1;
+		else if (idx.findSuperset(k, AnyValue()))
+			hit = 2;
+		else if (idx.findSubset(k, AnyValue()))
+			hit = 3;
+		else
+			idx.insert(k, i);
+		hits.push_back(hit);
+	}
+
+	return util::getWallTime() - start;
+}
+
+static bool BenchCexIndexAST(
+	const char *Filename,
+	const MemoryBuffer *MB,
+	ExprBuilder *Builder)
+{
+	std::vector<Decl*>	Decls;
+	std::vector<CexKey>	keys;
+	std::vector<int>	mos_hits, idx_hits;
+	unsigned		hit_c[4] = {0, 0, 0, 0}, mismatches = 0;
+	Parser			*P;
+	double			mos_t, idx_t;
+
+	P = createParser(Filename, MB, Builder);
+	while (Decl *D = P->ParseTopLevelDecl())
+		Decls.push_back(D);
+
+	if (unsigned N = P->GetNumErrors()) {
+		std::cerr	<< Filename << ": parse failure: "
+				<< N << " errors.\n";
+		return false;
+	}
+
+	/* same key CexCachingSolver builds */
+	foreach (it, Decls.begin(), Decls.end()) {
+		QueryCommand	*QC = dyn_cast<QueryCommand>(*it);
+		ref<Expr>	neg;
+
+		if (QC == NULL) continue;
+
+		keys.push_back(CexKey(
+			QC->Constraints.begin(), QC->Constraints.end()));
+		neg = Expr::createIsZero(QC->Query);
+		if (!isa<ConstantExpr>(neg))
+			keys.back().insert(neg);
+	}
+
+	MapOfSets<ref<Expr>, unsigned>	mos;
+	SetIndex<ref<Expr>, unsigned, util::ExprHash, util::ExprCmp>	idx;
+
+	mos_t = benchIndex(mos, keys, mos_hits);
+	idx_t = benchIndex(idx, keys, idx_hits);
+
+	for (unsigned i = 0; i < keys.size(); i++) {
+		hit_c[idx_hits[i]]++;
+		if (mos_hits[i] != idx_hits[i])
+			mismatches++;
+	}
+
+	std::cout
+	<< "keys = " << keys.size() << "\n"
+	<< "exact = " << hit_c[1] << "\n"
+	<< "superset = " << hit_c[2] << "\n"
+	<< "subset = " << hit_c[3] << "\n"
+	<< "miss = " << hit_c[0] << "\n"
+	<< "mismatches = " << mismatches << "\n"
+	<< "MapOfSets time = " << mos_t << "s\n"
+	<< "SetIndex time = " << idx_t << "s\n";
+
+	foreach (it, Decls.begin(), Decls.end())
+		delete *it;
+
+	delete P;
+	return mismatches == 0;
+}
+
+/* issue the query the way doQuery would, minus the printing;
+ * false means the solver failed, not that the query was unsat */
+static bool benchQuery(Solver* S, QueryCommand* QC, unsigned& unsat)
+{
+	ConstraintManager	cm(QC->Constraints);
+	Query			q(cm, QC->Query);
+
+	if (QC->Values.empty() && QC->Objects.empty()) {
+		bool	mbt;
+		return S->mustBeTrue(q, mbt);
+	}
+
+	if (!QC->Values.empty()) {
+		ref<ConstantExpr>	result;
+		return S->getValue(Query(cm, QC->Values[0]), result);
+	}
+
+	/* getInitialValues() says false for both unsat and failure and
+	 * acks the failure, so ask the impl directly */
+	Assignment	a(QC->Objects);
+	if (S->impl->computeInitialValues(q, a))
+		return !S->failed();
+
+	if (S->failed())
+		return false;
+
+	unsat++;
+	return true;
+}
+
+static void printBenchStats(void)
+{
+	static const char* hit_stats[][3] = {
+		{ "CexCache", "CexCacheHits", "CexCacheMisses" },
+		{ "QueryCache", "QueryCacheHits", "QueryCacheMisses" },
+		{ NULL, NULL, NULL } };
+
+	for (unsigned i = 0; hit_stats[i][0] != NULL; i++) {
+		uint64_t	hits, misses;
+
+		hits = *theStatisticManager->getStatisticByName(hit_stats[i][1]);
+		misses = *theStatisticManager->getStatisticByName(
+			hit_stats[i][2]);
+		if (hits + misses == 0)
+			continue;
+
+		std::cout	<< hit_stats[i][0] << " hit rate = "
+				<< (100.0 * hits) / (hits + misses) << "%\n";
+	}
+
+	/* everything the chain's layers counted */
+	for (unsigned i = 0; i < theStatisticManager->getNumStatistics(); i++) {
+		const Statistic	&st(theStatisticManager->getStatistic(i));
+
+		if (st.getValue() == 0)
+			continue;
+
+		std::cout << "stat " << st.getName() << " = "
+			<< st.getValue() << "\n";
+	}
+}
+
+static bool BenchSolverAST(
+	const char *Filename,
+	const MemoryBuffer *MB,
+	ExprBuilder *Builder)
+{
+	std::vector<Decl*>	Decls;
+	std::vector<double>	lat;
+	Parser			*P;
+	Solver			*S;
+	unsigned		failures = 0, unsat = 0;
+	double			total, start;
+
+	P = createParser(Filename, MB, Builder);
+	while (Decl *D = P->ParseTopLevelDecl())
+		Decls.push_back(D);
+
+	if (unsigned N = P->GetNumErrors()) {
+		std::cerr	<< Filename << ": parse failure: "
+				<< N << " errors.\n";
+		return false;
+	}
+
+	S = buildSolver();
+	S->printName();
+
+	start = util::getWallTime();
+	for (unsigned pass = 0; pass < BenchPasses; pass++) {
+		foreach (it, Decls.begin(), Decls.end()) {
+			QueryCommand	*QC = dyn_cast<QueryCommand>(*it);
+			double		t;
+
+			if (QC == NULL) continue;
+
+			t = util::getWallTime();
+			if (!benchQuery(S, QC, unsat))
+				failures++;
+			lat.push_back(util::getWallTime() - t);
+		}
+	}
+	total = util::getWallTime() - start;
+
+	std::sort(lat.begin(), lat.end());
+
+	std::cout
+	<< "queries = " << lat.size() << "\n"
+	<< "failures = " << failures << "\n"
+	<< "unsat = " << unsat << "\n"
+	<< "total time = " << total << "s\n";
+
+	if (!lat.empty()) {
+		static const unsigned	pcts[] = {50, 90, 99};
+		for (unsigned i = 0; i < 3; i++) {
+			std::cout << "latency p" << pcts[i] << " = "
+				<< 1e6*lat[((lat.size() - 1)*pcts[i])/100]
+				<< "us\n";
+		}
+		std::cout << "latency max = " << 1e6*lat.back() << "us\n";
+	}
+
+	printBenchStats();
+
+	foreach (it, Decls.begin(), Decls.end())
+		delete *it;
+
+	delete P;
+	delete S;
+	return true;
+}
+
 int main(int argc, char **argv)
 {
 	bool success = true;
@@ -349,6 +628,18 @@ int main(int argc, char **argv)
 			mb.get().get(),
 			Builder);
 		break;
+	case BenchSolver:
+		success = BenchSolverAST(
+			InputFile=="-" ? "<stdin>" : InputFile.c_str(),
+			mb.get().get(),
+			Builder);
+		break;
+	case BenchCexIndex:
+		success = BenchCexIndexAST(
+			InputFile=="-" ? "<stdin>" : InputFile.c_str(),
+			mb.get().get(),
+			Builder);
+		break;
 #if 0
 	default:
 		std::cerr << argv[0] << ": error: Unknown program action!\n";
@@ -85,6 +85,11 @@ namespace
 		"keep-dead-stack",
 		cl::desc("Keep registers in dead stack frames"));
 
+	cl::opt<bool> LazyGuestMem(
+		"lazy-guest-mem",
+		cl::desc("Read guest pages from the snapshot until written."),
+		cl::init(true));
+
 	cl::opt<bool,true> SymRegsProxy(
 		"symregs",
 		cl::desc("Mark initial register file as symbolic"),
@@ -480,9 +485,23 @@ void ExecutorVex::bindMappingPage(
 #endif
 
 	mmap_os = nullptr;
-	for (i = 0; i < PAGE_SIZE; i++) {
+
+	/* backed objects point into the guest's mapping, so only the
+	 * executor's guest, which outlives every state, can back them;
+	 * other guests are copied in. Pages are backed without looking for
+	 * zeroes first, so snapshot pages the guest never reads are never
+	 * faulted in; a zero page just reads as zeroes from its backing. */
+	if (LazyGuestMem && g == gs) {
+		mmap_os = ObjectState::createBacked(
+			PAGE_SIZE, (const uint8_t*)buf_base);
+		state->rebindObject(mmap_mo, mmap_os);
+		i = PAGE_SIZE;
+	}
+
+	for (; i < PAGE_SIZE; i++) {
 		/* can keep zero page? */
 		if (!data[i]) continue;
+
 		/* can't keep zero page */
 		mmap_os = state->addressSpace.getWriteable(mmap_mo, mmap_os_c);
 		mmap_os->resetCopyDepth();
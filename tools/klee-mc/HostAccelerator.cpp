@@ -558,13 +558,15 @@ bool HostAccelerator::xchk(const ExecutionState& es_hw, ExecutionState& es_klee)
 		std::cerr << "=====Interpreter vs Hardware====\n";
 		os->printDiff(*os2);
 		if (os2->getSize() == AMD64CPUState::REGFILE_BYTES) {
-#define get_amd64(x)	\
-	(const VexGuestAMD64State*)((const void*)(x)->getConcreteBuf())
-			AMD64CPUState	cpu;
+			AMD64CPUState		cpu;
+			std::vector<uint8_t>	regs(os2->getSize());
+
 			std::cerr << "Interpreter RegDump:\n";
-			cpu.print(std::cerr, get_amd64(os));
+			os->readConcrete(regs.data(), regs.size());
+			cpu.print(std::cerr, regs.data());
 			std::cerr << "Guest RegDump:\n";
-			cpu.print(std::cerr, get_amd64(os2));
+			os2->readConcrete(regs.data(), regs.size());
+			cpu.print(std::cerr, regs.data());
 		}
 		std::cerr << "=========================\n";
 		ret = false;
@@ -582,19 +584,32 @@ bool HostAccelerator::xchk(const ExecutionState& es_hw, ExecutionState& es_klee)
 void HostAccelerator::fixupHWShadow(
 	const ExecutionState& hw, ExecutionState& shadow)
 {
-	VexGuestAMD64State	*v;
+	VexGuestAMD64State	v;
+	ObjectState		*regs(GETREGOBJ(shadow));
 	ref<Expr>		new_pc_e;
 	uint64_t		rflags;
 	uint64_t		x_reg(~0ULL);
 
+	regs->readConcrete((uint8_t*)&v, sizeof(v));
+
 	/* rflags is jiggled a bit in ptrace->vex, so replicate behavior */
-	v = (VexGuestAMD64State*)GETREGOBJ(shadow)->getConcreteBuf();
-	rflags = AMD64CPUState::getRFLAGS(*v);
-	v->guest_DFLAG = (rflags & (1 << 10)) ? -1 :1;
-	v->guest_CC_OP = 0 /* AMD64G_CC_OP_COPY */;
-	v->guest_CC_DEP1 = rflags & (0xff | (3 << 10));
-	v->guest_CC_DEP2 = 0;
-	v->guest_CC_NDEP = v->guest_CC_DEP1;
+	rflags = AMD64CPUState::getRFLAGS(v);
+	v.guest_DFLAG = (rflags & (1 << 10)) ? -1 :1;
+	v.guest_CC_OP = 0 /* AMD64G_CC_OP_COPY */;
+	v.guest_CC_DEP1 = rflags & (0xff | (3 << 10));
+	v.guest_CC_DEP2 = 0;
+	v.guest_CC_NDEP = v.guest_CC_DEP1;
+
+	/* shadow state will return *after* syscall (since it's on sc_enter);
+	 * accel returns *at* syscall (since it's abotu to call sc_enter) */
+	v.guest_RIP -= 2;
+
+	/* VEX will generate EMNOTEs but not hardware! */
+	x_reg = 0;
+	AS_COPY2(hw, &x_reg, VexGuestAMD64State, guest_EMNOTE, 4);
+	v.guest_EMNOTE = x_reg;
+
+	regs->writeConcrete((const uint8_t*)&v, sizeof(v));
 
 	/* rcx and r11 are clobbered, so use cpu results */
 	AS_COPY2(hw, &x_reg, VexGuestAMD64State, guest_RCX, 8);
@@ -606,13 +621,4 @@ void HostAccelerator::fixupHWShadow(
 	char	ymm16[32];
 	AS_COPY2(hw, &ymm16, VexGuestAMD64State, guest_YMM16, 32);
 	AS_COPYOUT(shadow, &ymm16, VexGuestAMD64State, guest_YMM16, 32);
-
-	/* shadow state will return *after* syscall (since it's on sc_enter);
-	 * accel returns *at* syscall (since it's abotu to call sc_enter) */
-	v->guest_RIP -= 2;
-
-	/* VEX will generate EMNOTEs but not hardware! */
-	x_reg = 0;
-	AS_COPY2(hw, &x_reg, VexGuestAMD64State, guest_EMNOTE, 4);
-	v->guest_EMNOTE = x_reg;
 }
@@ -164,11 +164,13 @@ static bool apply_ossfx_regs(
 	char		path[512];
 	ExeStateVex	&esv(es2esv(es));
 	uint8_t		*regs_pre, *regs_post;
+	std::vector<uint8_t>	regs_klee;
 	struct stat	s;
 	ObjectState	*regs;
 	FILE		*f;
 	Guest		*gs(esv.getBaseGuest());
-	VexGuestAMD64State	*v1, *v2;
+	VexGuestAMD64State	*v1;
+	const VexGuestAMD64State	*v2;
 
 	/* load register files for pre and post snapshots */
 	sprintf(path, "%s/%d/regs.pre", OSSFxDir.c_str(), seq_nr);
@@ -192,13 +194,17 @@ static bool apply_ossfx_regs(
 
 	/* hurrr fixups */
 	v1 = (VexGuestAMD64State*)regs_pre;
-	v2 = (VexGuestAMD64State*)regs->getConcreteBuf();
+	regs_klee.resize(regs->getSize());
+	regs->readConcrete(regs_klee.data(), regs_klee.size());
+	v2 = (const VexGuestAMD64State*)(const void*)regs_klee.data();
 
 	/* clobbered by kernel; rcx = rip, r11 = rflags */
 	v1->guest_RCX = v2->guest_RCX;
 	v1->guest_R11 = v2->guest_R11;
 
-	v2->guest_RIP = v1->guest_RIP;
+	/* regs are replaced by regs_post below, so only the compare
+	 * needs RIP to agree */
+	v1->guest_RIP = v2->guest_RIP;
 	v1->guest_CC_OP = v2->guest_CC_OP;
 	v1->guest_CC_DEP1 = v2->guest_CC_DEP1;
 	v1->guest_CC_DEP2 = v2->guest_CC_DEP2;
@@ -215,10 +221,10 @@ static bool apply_ossfx_regs(
 		gs->getCPUState()->print(std::cerr, regs_pre);
 
 		std::cerr << "KLEE REGS:\n";
-		gs->getCPUState()->print(std::cerr, regs->getConcreteBuf());
+		gs->getCPUState()->print(std::cerr, regs_klee.data());
 
-		for (unsigned i = 0; i < s.st_size; i++) {
-			if (regs_pre[i] != regs->getConcreteBuf()[i])
+		for (unsigned i = 0; i < s.st_size && i < regs_klee.size(); i++) {
+			if (regs_pre[i] != regs_klee[i])
 				std::cerr << "Mismatch Index: " << i << '\n';
 		}
 		assert (0 == 1 && "DID NOT MATCH PRE REGS!");
@@ -62,6 +62,12 @@ namespace llvm
 		cl::desc("Apply given rule file to input smt"),
 		cl::init(""));
 
+	cl::opt<std::string>
+	CompileRules(
+		"compile-rules",
+		cl::desc("Compile rule database into a mappable rule image"),
+		cl::init(""));
+
 	cl::opt<int>
 	SplitDB(
 		"split-db",
@@ -864,6 +870,19 @@ static void splitDB(std::string& prefix, int num_chunks)
 	delete [] ofs;
 }
 
+static void compileRules(const std::string& fname)
+{
+	auto rb = RuleBuilder::create(ExprBuilder::create(BuilderKind));
+	assert (rb != NULL);
+
+	if (rb->writeRuleImage(fname.c_str()) == false)
+		std::cerr << "[kopt] Could not write rule image " << fname << '\n';
+	else
+		std::cout << "Compiled " << rb->size() << " rules.\n";
+
+	delete rb;
+}
+
 static void dumpRuleHashes(void)
 {
 	auto rb = RuleBuilder::create(ExprBuilder::create(BuilderKind));
@@ -917,7 +936,9 @@ int main(int argc, char **argv)
 		return -3;
 	}
 
-	if (!ExtractByHashes.empty()) {
+	if (!CompileRules.empty()) {
+		compileRules(CompileRules);
+	} else if (!ExtractByHashes.empty()) {
 		extractRuleHashes(ExtractByHashes);
 	} else if (DumpRuleHashes) {
 		dumpRuleHashes();
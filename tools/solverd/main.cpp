@@ -24,6 +24,7 @@
 #include <arpa/inet.h>
 
 #include "klee/SolverFormat.h"
+#include "klee/SolverShm.h"
 
 #define SOLVED_BACKLOG     100
 
@@ -40,11 +41,13 @@ int verbose_level;
 const char* stp_bin_path;
 const char* stp_bin_name;
 const char* cache_dir;
+const char* shm_name;
 
 // global parameters obtained during run-time
 pid_t listen_pid;
 int listen_fd; // listening socket; global so that quit() can close it
 int shmid;
+SolverShmRing* shm_ring;
 
 struct timeval query_started;
 
@@ -99,6 +102,8 @@ void quit(int x) {
   if (getpid() == listen_pid) {
     if (shmctl(shmid, IPC_RMID, NULL) < 0)
       perror("shmctl(IPC_RMID)");
+    if (shm_name && shm_unlink(shm_name) < 0)
+      perror("shm_unlink()");
   }
   exit(EXIT_OKAY);
 }
@@ -395,7 +400,7 @@ bool cacheInsert(const char *path, const std::vector<char>& contents) {
   return true;
 }
 
-bool calculateHash(const std::vector<char>& str, unsigned char* hash, unsigned int& hashlen)
+bool calculateHash(const char* str, size_t len, unsigned char* hash, unsigned int& hashlen)
 {
   bool success = false;
   EVP_MD_CTX mdctx;
@@ -405,7 +410,7 @@ bool calculateHash(const std::vector<char>& str, unsigned char* hash, unsigned i
     fprintf(stderr, "EVP_DigestInit_ex() failed\n");
     goto exit;
   }
-  if (!EVP_DigestUpdate(&mdctx, str.data(), str.size())) {
+  if (!EVP_DigestUpdate(&mdctx, str, len)) {
     fprintf(stderr, "EVP_DigestUpdate() failed\n");
     goto exit;
   }
@@ -420,8 +425,8 @@ exit:
   return success;
 }
 
-int talkToChild(pid_t pid, int infd, int outfd, int sockfd, const timeval& tTimeout,
-    const std::vector<char>& query, std::vector<char>& response)
+int talkToChild(pid_t pid, int infd, int outfd, const timeval& tTimeout,
+    const char* query, size_t qlen, std::vector<char>& response)
 {
   timeval tNow, tExpire;
   gettimeofday(&tNow, NULL);
@@ -430,8 +435,8 @@ int talkToChild(pid_t pid, int infd, int outfd, int sockfd, const timeval& tTime
   // we have to send the query to STP, but
   // we don't want to overflow STP's STDIN buffer
 
-  const char* head = query.data();
-  size_t left = query.size();
+  const char* head = query;
+  size_t left = qlen;
   std::string stpOutput;
   const int maxfd = std::max(infd, outfd);
 
@@ -494,11 +499,10 @@ int talkToChild(pid_t pid, int infd, int outfd, int sockfd, const timeval& tTime
       else if (n == 0) { // STP terminated (EOF)
         if (!parseResult(stpOutput, response)) {
           fprintf(stderr, "cannot parse STP output:\n*****\n%s\n*****\n" \
-            "On query:\n%.*s\n----------\n", stpOutput.c_str(), static_cast<int>(query.size()), query.data());
+            "On query:\n%.*s\n----------\n", stpOutput.c_str(), static_cast<int>(qlen), query);
           return EXIT_ERROR;
         }
 
-        sendall(sockfd, response.data(), response.size());
         close(infd);
         return EXIT_OKAY;
       }
@@ -509,108 +513,159 @@ int talkToChild(pid_t pid, int infd, int outfd, int sockfd, const timeval& tTime
   }
 }
 
-// main request handler; called after accept()
-void processRequest(int fd) {
-  // receive length of query
-  STPReqHdr stpRequest;
-  recvall(fd, &stpRequest, sizeof(stpRequest));
-  stpRequest.timeout_sec = ntohl(stpRequest.timeout_sec);
-  stpRequest.timeout_usec = ntohl(stpRequest.timeout_usec);
-  stpRequest.length = ntohl(stpRequest.length);
-
-  // receive query
-  std::vector<char> query(stpRequest.length);
-  recvall(fd, query.data(), query.size());
-
+// answers a query from the cache or by running STP; returns exit code
+int solveQuery(const STPReqHdr& stpRequest, const char* query, size_t qlen,
+    std::vector<char>& response)
+{
   // calculate md5 hash
   unsigned char hash[EVP_MAX_MD_SIZE];
   unsigned int hashlen;
-  if (!calculateHash(query, hash, hashlen)) {
-    close(fd);
-    exit(EXIT_ERROR);
-  }
+  if (!calculateHash(query, qlen, hash, hashlen))
+    return EXIT_ERROR;
   const char *path = printHexHashPath(hash, hashlen);
 
   gettimeofday(&query_started, NULL);
-  std::vector<char> cache;
-  if (cacheLookup(path, cache)) {
+  if (cacheLookup(path, response)) {
     ++stats->nCacheHit;
     printResult("Cache Hit");
-    sendall(fd, cache.data(), cache.size());
+    return EXIT_OKAY;
   }
-  else {
-    // restore default signal handler before forking
-    signal(SIGCHLD, SIG_DFL);
-
-    // prepare pipes to STP process
-    // The parent writes to p2c[1], which the child reads from p2c[0].
-    // The child writes to c2p[1], which the parent reads from c2p[0].
-    int p2c[2], c2p[2];
-    if (pipe(p2c) < 0 || pipe(c2p) < 0) {
-      perror("pipe()");
-      close(fd);
+
+  // restore default signal handler before forking
+  signal(SIGCHLD, SIG_DFL);
+
+  // prepare pipes to STP process
+  // The parent writes to p2c[1], which the child reads from p2c[0].
+  // The child writes to c2p[1], which the parent reads from c2p[0].
+  int p2c[2], c2p[2];
+  if (pipe(p2c) < 0 || pipe(c2p) < 0) {
+    perror("pipe()");
+    return EXIT_ERROR;
+  }
+
+  // fork STP process
+  pid_t pid = fork();
+  if (pid < 0) {
+    perror("fork()");
+    return EXIT_ERROR;
+  }
+  else if (pid == 0) { // child process
+    // close child's unused ends of the pipes
+    close(p2c[1]);
+    close(c2p[0]);
+
+    // redirect stderr to /dev/null
+    if (!freopen("/dev/null", "w", stderr)) {
+      perror("freopen()");
       exit(EXIT_ERROR);
     }
 
-    // fork STP process
-    pid_t pid = fork();
-    if (pid < 0) {
-      perror("fork()");
-      close(fd);
+    // point STDIN/STDOUT to pipes
+    if (dup2(p2c[0], STDIN_FILENO) < 0 || dup2(c2p[1], STDOUT_FILENO) < 0) {
+      perror("dup2()");
       exit(EXIT_ERROR);
     }
-    else if (pid == 0) { // child process
-      // close child's unused ends of the pipes
-      close(p2c[1]);
-      close(c2p[0]);
 
-      // redirect stderr to /dev/null
-      if (!freopen("/dev/null", "w", stderr)) {
+    // run STP; never returns
+    if (execl(stp_bin_path, stp_bin_name, "-c", "-p", NULL) < 0) {
+      // restore stderr so we can see this error
+      if (!freopen( "/dev/tty", "w", stderr)) {
         perror("freopen()");
         exit(EXIT_ERROR);
       }
-
-      // point STDIN/STDOUT to pipes
-      if (dup2(p2c[0], STDIN_FILENO) < 0 || dup2(c2p[1], STDOUT_FILENO) < 0) {
-        perror("dup2()");
-        exit(EXIT_ERROR);
-      }
-
-      // run STP; never returns
-      if (execl(stp_bin_path, stp_bin_name, "-c", "-p", NULL) < 0) {
-        // restore stderr so we can see this error
-        if (!freopen( "/dev/tty", "w", stderr)) {
-          perror("freopen()");
-          exit(EXIT_ERROR);
-        }
-        perror("execl()");
-        exit(EXIT_ERROR);
-      }
-
-      // we should never get here
+      perror("execl()");
       exit(EXIT_ERROR);
     }
-    else { // parent process
-      // close parent's unused ends of the pipes
-      close(p2c[0]);
-      close(c2p[1]);
-
-      // prepare timeout
-      timeval tTimeout;
-      tTimeout.tv_sec = stpRequest.timeout_sec;
-      tTimeout.tv_usec = stpRequest.timeout_usec;
-
-      std::vector<char> response;
-      int r = talkToChild(pid, c2p[0], p2c[1], fd, tTimeout, query, response);
-      if (r == EXIT_OKAY)
-        cacheInsert(path, response);
-      close(fd);
-      exit(r);
-    }
+
+    // we should never get here
+    exit(EXIT_ERROR);
   }
 
+  // parent process
+  // close parent's unused ends of the pipes
+  close(p2c[0]);
+  close(c2p[1]);
+
+  // prepare timeout
+  timeval tTimeout;
+  tTimeout.tv_sec = stpRequest.timeout_sec;
+  tTimeout.tv_usec = stpRequest.timeout_usec;
+
+  int r = talkToChild(pid, c2p[0], p2c[1], tTimeout, query, qlen, response);
+  if (r == EXIT_OKAY)
+    cacheInsert(path, response);
+  return r;
+}
+
+// main request handler; called after accept()
+void processRequest(int fd) {
+  // receive length of query
+  STPReqHdr stpRequest;
+  recvall(fd, &stpRequest, sizeof(stpRequest));
+  stpRequest.timeout_sec = ntohl(stpRequest.timeout_sec);
+  stpRequest.timeout_usec = ntohl(stpRequest.timeout_usec);
+  stpRequest.length = ntohl(stpRequest.length);
+
+  // receive query
+  std::vector<char> query(stpRequest.length);
+  recvall(fd, query.data(), query.size());
+
+  std::vector<char> response;
+  int r = solveQuery(stpRequest, query.data(), query.size(), response);
+  if (r == EXIT_OKAY)
+    sendall(fd, response.data(), response.size());
+
   close(fd);
-  exit(EXIT_OKAY);
+  exit(r);
+}
+
+// shared memory request handler; query is read in place from the slot
+void processShmRequest(SolverShmSlot* slot) {
+  // header is in host order; no one else touches the slot until we finish
+  STPReqHdr stpRequest;
+  memcpy(&stpRequest, slot->data, sizeof(stpRequest));
+
+  std::vector<char> response;
+  int r = EXIT_ERROR;
+  if (sizeof(stpRequest) + stpRequest.length <= slot->len)
+    r = solveQuery(stpRequest, slot->data + sizeof(stpRequest),
+        stpRequest.length, response);
+
+  if (r == EXIT_OKAY && response.size() <= sizeof(slot->data)) {
+    memcpy(slot->data, response.data(), response.size());
+    slot->len = response.size();
+    solverShmFinish(slot, true);
+  } else {
+    solverShmFinish(slot, false);
+  }
+
+  exit(r);
+}
+
+// serves clients on the same host through the shared memory ring
+void shmLoop(void)
+{
+  while (true) {
+    uint32_t bell = shm_ring->doorbell;
+
+    for (unsigned i = 0; i < shm_ring->nslots; i++) {
+      SolverShmSlot* slot = &shm_ring->slots[i];
+
+      if (!__sync_bool_compare_and_swap(
+          &slot->state, SHM_SLOT_REQ, SHM_SLOT_BUSY))
+        continue;
+
+      pid_t pid = fork();
+      if (pid < 0) {
+        perror("fork()");
+        solverShmFinish(slot, false);
+      }
+      else if (pid == 0) // child process
+        processShmRequest(slot); // never returns
+    }
+
+    solverShmWait(&shm_ring->doorbell, bell, 0);
+  }
 }
 
 bool parse_args(int argc, char** argv, uint16_t& port)
@@ -620,11 +675,13 @@ bool parse_args(int argc, char** argv, uint16_t& port)
   if (argc <= 0)
     return false;
 
-  if ((*argv)[0] == '-') {
+  while (argc > 0 && (*argv)[0] == '-') {
     if (strcmp(*argv, "-vv") == 0)
       verbose_level = 2;
     else if (strcmp(*argv, "-v") == 0)
       verbose_level = 1;
+    else if (strcmp(*argv, "-shm") == 0 && argc > 1)
+      shm_name = *++argv, --argc;
     else
       return false;
     ++argv, --argc;
@@ -667,7 +724,7 @@ int main(int argc, char **argv)
   
   // parse command-line arguments
   if (!parse_args(argc, argv, port)) {
-    fprintf(stderr, "Usage: %s [-v|-vv] <port> <stp_bin_path> <cache_dir>\n", argv[0]);
+    fprintf(stderr, "Usage: %s [-v|-vv] [-shm <name>] <port> <stp_bin_path> <cache_dir>\n", argv[0]);
     exit(EXIT_ERROR);
   }
 
@@ -738,6 +795,23 @@ int main(int argc, char **argv)
   // prevent children from becoming zombies
   signal(SIGCHLD, SIG_IGN);
 
+  // same-host clients; served by a sibling of the accept loop
+  if (shm_name) {
+    shm_ring = solverShmOpen(shm_name, true);
+    if (shm_ring == NULL) {
+      perror("shm_open()");
+      exit(EXIT_ERROR);
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+      perror("fork()");
+      exit(EXIT_ERROR);
+    }
+    else if (pid == 0)
+      shmLoop(); // never returns
+  }
+
   // main loop; never breaks
   while (true) {
     // accept incoming connection
@@ -0,0 +1,439 @@
+//===-- CoreTest.cpp ------------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include <iostream>
+#include "gtest/gtest.h"
+
+#include <vector>
+#include "CowSegArray.h"
+#include "SlabAlloc.h"
+#include "SymByteMap.h"
+#include "Memory.h"
+#include "TLB.h"
+#include "PageTable.h"
+#include "Context.h"
+#include "ConstraintJIT.h"
+#include "klee/util/Assignment.h"
+
+using namespace klee;
+
+namespace {
+
+TEST(CoreTest, CowSegArrayShare) {
+  CowSegArray<uint8_t> a(4*COW_SEG_ELEMS + 10);
+  uint8_t buf[3*COW_SEG_ELEMS];
+
+  for (unsigned i = 0; i < sizeof(buf); i++)
+    buf[i] = i;
+  a.copyIn(5, buf, sizeof(buf));
+
+  /* a copy shares every line; one write clones one line */
+  CowSegArray<uint8_t> b(a);
+  uint64_t clones = CowSegArray<uint8_t>::getNumClones();
+  EXPECT_EQ(0, b.cmp(a, 4*COW_SEG_ELEMS + 10));
+
+  b.getMut(COW_SEG_ELEMS + 1) = 0xff;
+  EXPECT_EQ(clones + 1, CowSegArray<uint8_t>::getNumClones());
+  EXPECT_EQ(buf[COW_SEG_ELEMS - 4], a.get(COW_SEG_ELEMS + 1));
+  EXPECT_EQ(0xff, b.get(COW_SEG_ELEMS + 1));
+  EXPECT_NE(0, b.cmp(a, 4*COW_SEG_ELEMS + 10));
+
+  /* the clone is private now; writing it again doesn't clone */
+  b.getMut(COW_SEG_ELEMS + 2) = 0xfe;
+  EXPECT_EQ(clones + 1, CowSegArray<uint8_t>::getNumClones());
+
+  /* copyOut crosses lines and reads never-written lines as zero */
+  uint8_t out[4*COW_SEG_ELEMS + 10];
+  a.copyOut(out, 0, sizeof(out));
+  for (unsigned i = 0; i < sizeof(out); i++) {
+    uint8_t v = (i >= 5 && i < 5 + sizeof(buf)) ? buf[i - 5] : 0;
+    EXPECT_EQ(v, out[i]);
+  }
+  EXPECT_EQ(0, a.cmp(out + 3, 3, COW_SEG_ELEMS + 7));
+  EXPECT_TRUE(a.isSegEmpty(4));
+
+  /* reset on an unwritten line must not materialize it */
+  a.reset(4*COW_SEG_ELEMS + 1);
+  EXPECT_TRUE(a.isSegEmpty(4));
+}
+
+TEST(CoreTest, CowSegArrayLineHash) {
+  CowSegArray<uint8_t> a(2*COW_SEG_ELEMS), zero(2*COW_SEG_ELEMS);
+
+  /* equal contents hash equal, whether or not the line exists */
+  a.getMut(0) = 0;
+  EXPECT_EQ(zero.hashLine(0), a.hashLine(0));
+
+  a.getMut(0) = 1;
+  uint32_t h = a.hashLine(0);
+  EXPECT_NE(zero.hashLine(0), h);
+
+  /* a copy shares the cached hash; a write drops only its own */
+  CowSegArray<uint8_t> b(a);
+  EXPECT_EQ(h, b.hashLine(0));
+  b.getMut(1) = 2;
+  EXPECT_NE(h, b.hashLine(0));
+  EXPECT_EQ(h, a.hashLine(0));
+  b.getMut(1) = 0;
+  EXPECT_EQ(h, b.hashLine(0));
+
+  /* only lines nobody else holds are private */
+  CowSegArray<uint8_t> c(a);
+  EXPECT_EQ(0U, c.getPrivateBytes());
+  c.getMut(COW_SEG_ELEMS) = 3;
+  EXPECT_EQ((uint64_t)COW_SEG_ELEMS, c.getPrivateBytes());
+  c.getMut(0) = 3;
+  EXPECT_EQ((uint64_t)2*COW_SEG_ELEMS, c.getPrivateBytes());
+  /* b and c both split off line 0, so a holds it alone */
+  EXPECT_EQ((uint64_t)COW_SEG_ELEMS, a.getPrivateBytes());
+}
+
+TEST(CoreTest, CowSegArrayBacked) {
+  uint8_t backing[2*COW_SEG_ELEMS];
+  for (unsigned i = 0; i < sizeof(backing); i++)
+    backing[i] = i ^ 0x5a;
+
+  CowSegArray<uint8_t> a(2*COW_SEG_ELEMS);
+  a.setBacking(backing);
+  EXPECT_TRUE(a.isBacked());
+  EXPECT_EQ(backing[70], a.get(70));
+
+  /* first write copies the line out of the backing buffer */
+  a.getMut(3) = 0;
+  EXPECT_EQ(0, a.get(3));
+  EXPECT_EQ(backing[4], a.get(4));
+  EXPECT_EQ(3 ^ 0x5a, backing[3]);
+
+  CowSegArray<uint8_t> b(a);
+  EXPECT_EQ(0, a.cmp(b, 2*COW_SEG_ELEMS));
+  EXPECT_EQ(0, b.cmp(backing + COW_SEG_ELEMS, COW_SEG_ELEMS, COW_SEG_ELEMS));
+
+  a.clear();
+  EXPECT_FALSE(a.isBacked());
+  EXPECT_EQ(0, a.get(70));
+
+  /* a zero snapshot page reads through its backing; copying the lines
+   * out leaves them empty */
+  std::vector<uint8_t> zeroes(2*COW_SEG_ELEMS, 0);
+  CowSegArray<uint8_t> z(2*COW_SEG_ELEMS);
+  z.setBacking(zeroes.data());
+  EXPECT_EQ(0, z.get(COW_SEG_ELEMS + 5));
+  z.unback();
+  EXPECT_TRUE(z.isSegEmpty(0));
+  EXPECT_TRUE(z.isSegEmpty(1));
+}
+
+TEST(CoreTest, CowSegArraySpill) {
+  CowSegArray<uint8_t> a(3*COW_SEG_ELEMS);
+  for (unsigned i = 0; i < 2*COW_SEG_ELEMS; i++)
+    a.getMut(i) = i + 1;
+
+  /* line 1 is shared, line 2 was never written */
+  CowSegArray<uint8_t> b(a);
+  b.getMut(0) = 0xff;
+  EXPECT_EQ(COW_SEG_ELEMS, a.getPrivateBytes());
+
+  /* only the private line moves */
+  std::vector<uint8_t> spill(3*COW_SEG_ELEMS, 0);
+  EXPECT_EQ(COW_SEG_ELEMS, a.spillTo(spill.data()));
+  EXPECT_EQ(spill.data(), a.getBacking());
+  EXPECT_EQ(0U, a.getPrivateBytes());
+  EXPECT_EQ(5, spill[4]);
+  EXPECT_EQ(0, spill[COW_SEG_ELEMS + 4]);
+  for (unsigned i = 0; i < 2*COW_SEG_ELEMS; i++)
+    EXPECT_EQ((uint8_t)(i + 1), a.get(i));
+  EXPECT_EQ(0, a.get(2*COW_SEG_ELEMS + 1));
+
+  /* a copy can outlive the extent, so it takes its own lines */
+  {
+    CowSegArray<uint8_t> c(a);
+    EXPECT_TRUE(a.isSpilled());
+    EXPECT_FALSE(c.isBacked());
+    EXPECT_EQ(0, c.cmp(a, 3*COW_SEG_ELEMS));
+    EXPECT_TRUE(c.isSegEmpty(2));
+    std::vector<uint8_t> saved(spill);
+    std::fill(spill.begin(), spill.end(), 0xee);
+    EXPECT_EQ(5, c.get(4));
+    spill = saved;
+  }
+
+  /* lines come back out; empty ones stay empty */
+  a.unback();
+  EXPECT_FALSE(a.isBacked());
+  std::fill(spill.begin(), spill.end(), 0xee);
+  EXPECT_EQ(COW_SEG_ELEMS, a.getPrivateBytes());
+  EXPECT_EQ(5, a.get(4));
+  EXPECT_EQ(COW_SEG_ELEMS + 5, a.get(COW_SEG_ELEMS + 4));
+  EXPECT_EQ(0, a.get(2*COW_SEG_ELEMS + 1));
+  EXPECT_TRUE(a.isSegEmpty(2));
+}
+
+TEST(CoreTest, SlabAllocReturnsSlabs) {
+  /* earlier tests freed everything they allocated unpooled */
+  SlabAlloc::setup();
+  ASSERT_TRUE(SlabAlloc::isEnabled());
+
+  uint64_t slabs = SlabAlloc::getNumSlabs();
+  uint64_t in_use = SlabAlloc::getBytesInUse();
+  std::vector<void*> blocks;
+
+  /* three slabs' worth of 100-byte (112-byte class) blocks */
+  for (unsigned i = 0; i < 3*(SLAB_BYTES / 112); i++) {
+    void *p = SlabAlloc::alloc(100);
+    EXPECT_EQ(0U, ((uintptr_t)p) % SLAB_GRAIN);
+    blocks.push_back(p);
+  }
+  EXPECT_LE(slabs + 3, SlabAlloc::getNumSlabs());
+  EXPECT_EQ(in_use + blocks.size()*112, SlabAlloc::getBytesInUse());
+
+  /* a freed block is handed out again */
+  void *p = blocks.back();
+  SlabAlloc::release(p, 100);
+  EXPECT_EQ(p, SlabAlloc::alloc(100));
+
+  /* all but one emptied slab go back to the system */
+  uint64_t freed = SlabAlloc::getNumSlabsFreed();
+  for (auto b : blocks)
+    SlabAlloc::release(b, 100);
+  EXPECT_EQ(in_use, SlabAlloc::getBytesInUse());
+  EXPECT_EQ(slabs + 1, SlabAlloc::getNumSlabs());
+  EXPECT_LE(freed + 2, SlabAlloc::getNumSlabsFreed());
+
+  /* too big for a class; passes straight through */
+  p = SlabAlloc::alloc(SLAB_MAX_BLOCK + 1);
+  SlabAlloc::release(p, SLAB_MAX_BLOCK + 1);
+  EXPECT_EQ(in_use, SlabAlloc::getBytesInUse());
+}
+
+TEST(CoreTest, SymByteMapSparseToDense) {
+  SymByteMap m(4*COW_SEG_ELEMS);
+  ref<Expr> e[SYM_SPARSE_MAX + 1];
+
+  for (unsigned i = 0; i <= SYM_SPARSE_MAX; i++)
+    e[i] = ConstantExpr::create(i + 1, 8);
+
+  /* out of order; lookups must still find every offset */
+  for (unsigned i = 0; i < SYM_SPARSE_MAX; i++)
+    m.set((i * 7) % (4*COW_SEG_ELEMS), e[i]);
+  EXPECT_FALSE(m.isDense());
+  for (unsigned i = 0; i < SYM_SPARSE_MAX; i++)
+    EXPECT_EQ(e[i], m.get((i * 7) % (4*COW_SEG_ELEMS)));
+  EXPECT_TRUE(m.get(1).isNull());
+
+  /* overwriting an offset doesn't count against the limit */
+  m.set(0, e[SYM_SPARSE_MAX]);
+  EXPECT_FALSE(m.isDense());
+  m.set(0, e[0]);
+
+  SymByteMap sparse_copy(m);
+
+  /* one more offset switches to dense and keeps every entry */
+  m.set(1, e[SYM_SPARSE_MAX]);
+  EXPECT_TRUE(m.isDense());
+  for (unsigned i = 0; i < SYM_SPARSE_MAX; i++)
+    EXPECT_EQ(e[i], m.get((i * 7) % (4*COW_SEG_ELEMS)));
+  EXPECT_EQ(e[SYM_SPARSE_MAX], m.get(1));
+
+  /* dense stays dense, even once emptied */
+  for (unsigned i = 0; i < SYM_SPARSE_MAX; i++)
+    m.reset((i * 7) % (4*COW_SEG_ELEMS));
+  m.reset(1);
+  EXPECT_TRUE(m.isDense());
+  EXPECT_TRUE(m.get(7).isNull());
+
+  /* the earlier copy is independent */
+  EXPECT_FALSE(sparse_copy.isDense());
+  EXPECT_EQ(e[1], sparse_copy.get(7));
+  EXPECT_TRUE(sparse_copy.get(1).isNull());
+  sparse_copy.reset(7);
+  EXPECT_TRUE(sparse_copy.get(7).isNull());
+}
+
+TEST(CoreTest, TLBTagsAndInvalidate) {
+  TLB tlb;
+  MemoryObject mo(0x10000, 0x2000, MallocKey(0x2000));
+  MemoryObject mo2(0x40000, 64, MallocKey(64));
+  ObjectPair op(&mo, NULL), op2(&mo2, NULL), out;
+
+  /* a translation only serves the address space tag it was put under */
+  tlb.put(1, 0x10010, op);
+  EXPECT_TRUE(tlb.get(1, 0x10800, out));
+  EXPECT_EQ(&mo, out.first);
+  EXPECT_FALSE(tlb.get(2, 0x10010, out));
+
+  /* forked states sharing a tag share the entry; many tags coexist */
+  for (uint64_t tag = 2; tag < 2 + 2*TLB_WAYS; tag++)
+    tlb.put(tag, 0x11000, op);
+  for (uint64_t tag = 2; tag < 2 + 2*TLB_WAYS; tag++)
+    EXPECT_TRUE(tlb.get(tag, 0x11000, out));
+
+  /* the page hits, but the address is past the object */
+  tlb.put(3, 0x40000, op2);
+  EXPECT_FALSE(tlb.get(3, 0x40040, out));
+  EXPECT_TRUE(tlb.get(3, 0x4003f, out));
+  EXPECT_EQ(&mo2, out.first);
+
+  /* invalidate drops the page under every tag, and nothing else */
+  tlb.invalidate(0x11abc);
+  for (uint64_t tag = 2; tag < 2 + 2*TLB_WAYS; tag++)
+    EXPECT_FALSE(tlb.get(tag, 0x11000, out));
+  EXPECT_TRUE(tlb.get(1, 0x10010, out));
+  EXPECT_TRUE(tlb.get(3, 0x40000, out));
+
+  /* refilled after invalidation */
+  tlb.put(2, 0x11000, op);
+  EXPECT_TRUE(tlb.get(2, 0x11000, out));
+}
+
+TEST(CoreTest, PageTableCopyOnWrite) {
+  PageTable pt;
+  MemoryObject mo(0x400000, 0x2000, MallocKey(0x2000));
+  MemoryObject odd(0x500010, 0x1000, MallocKey(0x1000));
+  const ObjectState *os1 = (const ObjectState*)0x1000;
+  const ObjectState *os2 = (const ObjectState*)0x2000;
+  PageTable::ent_ty ent;
+
+  /* whole pages only; everything else is left to the map */
+  EXPECT_TRUE(PageTable::isIndexable(&mo));
+  EXPECT_FALSE(PageTable::isIndexable(&odd));
+  pt.set(&odd, os1);
+  EXPECT_FALSE(pt.lookup(0x500010, ent));
+
+  pt.set(&mo, os1);
+  EXPECT_TRUE(pt.lookup(0x401fff, ent));
+  EXPECT_EQ(&mo, ent.first);
+  EXPECT_EQ(os1, ent.second);
+  EXPECT_FALSE(pt.lookup(0x402000, ent));
+
+  /* an unshared table is updated in place */
+  uint64_t copies = PageTable::getNumNodeCopies();
+  pt.set(&mo, os2);
+  EXPECT_EQ(copies, PageTable::getNumNodeCopies());
+
+  /* the first write to a shared table copies one path; later writes
+   * on that path don't */
+  PageTable fork(pt);
+  fork.set(&mo, os1);
+  EXPECT_EQ(copies + PT_LEVELS, PageTable::getNumNodeCopies());
+  fork.set(&mo, os2);
+  EXPECT_EQ(copies + PT_LEVELS, PageTable::getNumNodeCopies());
+
+  fork.set(&mo, os1);
+  EXPECT_TRUE(pt.lookup(0x400000, ent));
+  EXPECT_EQ(os2, ent.second);
+  EXPECT_TRUE(fork.lookup(0x400000, ent));
+  EXPECT_EQ(os1, ent.second);
+
+  /* removing a page that isn't mo's leaves it alone */
+  MemoryObject other(0x400000, 0x1000, MallocKey(0x1000));
+  fork.remove(&other);
+  EXPECT_TRUE(fork.lookup(0x400000, ent));
+  fork.remove(&mo);
+  EXPECT_FALSE(fork.lookup(0x400000, ent));
+  EXPECT_TRUE(pt.lookup(0x401000, ent));
+}
+
+class HookedObjectState : public ObjectState
+{
+public:
+  HookedObjectState(unsigned size) : ObjectState(size), hooked(false), reads(0) {}
+  ref<Expr> read8(unsigned offset) const {
+    reads++;
+    return ObjectState::read8(offset);
+  }
+  bool hasReadHook(void) const { return hooked; }
+
+  bool hooked;
+  mutable unsigned reads;
+};
+
+TEST(CoreTest, ObjectStateReadHook) {
+  Context::initialize(true, Expr::Int64);
+
+  HookedObjectState os(32);
+  for (unsigned i = 0; i < 32; i++)
+    os.write8(i, i);
+
+  /* concrete reads skip read8 unless it is hooked */
+  for (unsigned w = 8; w <= 256; w *= 2) {
+    os.hooked = false;
+    os.reads = 0;
+    ref<Expr> fast = os.read(0, w);
+    EXPECT_EQ(0U, os.reads);
+
+    os.hooked = true;
+    ref<Expr> slow = os.read(0, w);
+    EXPECT_EQ(w / 8, os.reads);
+    EXPECT_EQ(fast, slow);
+  }
+}
+
+static ref<Expr> readByte(const ref<Array>& arr, unsigned idx) {
+  UpdateList ul(arr, NULL);
+  return ReadExpr::create(ul, ConstantExpr::create(idx, 32));
+}
+
+TEST(CoreTest, ConstraintJITMatchesEvaluate) {
+  ref<Array> a = Array::create("jit0", MallocKey(4));
+  ref<Array> b = Array::create("jit1", MallocKey(4));
+  ref<Expr> a0 = readByte(a, 0);
+  ref<Expr> a1 = readByte(a, 1);
+  ref<Expr> b0 = readByte(b, 0);
+  ref<Expr> w16 = ConcatExpr::create(a1, a0);
+  UpdateList ul(b, NULL);
+  ul.extend(ConstantExpr::create(2, 32), a0);
+
+  ref<Expr> roots[] = {
+    SDivExpr::create(SExtExpr::create(a0, 32), ConstantExpr::create(-3, 32)),
+    SelectExpr::create(
+      SltExpr::create(a1, b0), ZExtExpr::create(b0, 16), w16),
+    ExtractExpr::create(MulExpr::create(w16, w16), 4, 8),
+    AShrExpr::create(SExtExpr::create(a1, 32), ConstantExpr::create(40, 32)),
+    ReadExpr::create(ul, ZExtExpr::create(
+      AndExpr::create(a1, ConstantExpr::create(3, 8)), 32)),
+    URemExpr::create(ZExtExpr::create(a0, 16), ZExtExpr::create(b0, 16)) };
+
+  std::vector<const Array*> objs = { a.get(), b.get() };
+  std::vector<Assignment*> as;
+  for (unsigned i = 0; i < 16; i++) {
+    std::vector<std::vector<unsigned char> > v = {
+      { (unsigned char)(i * 37 + 0xf7), (unsigned char)(i * 11 + 0x82), 0, 0 },
+      { (unsigned char)((i + 1) % 5), 0, (unsigned char)(i * 3), 0 } };
+    as.push_back(new Assignment(objs, v));
+  }
+
+  std::unique_ptr<ConstraintJIT> jit(ConstraintJIT::create());
+  unsigned decided = 0;
+
+  for (auto root : roots) {
+    /* root == its value under the first assignment */
+    std::vector<ref<Expr> > cs = {
+      EqExpr::create(root, as[0]->evaluate(root)) };
+    const TapeJIT::Checker *c = NULL;
+
+    /* cold until looked up often enough */
+    for (unsigned i = 0; i < 64 && c == NULL; i++)
+      c = jit->lookup(cs);
+    ASSERT_TRUE(c != NULL);
+    EXPECT_EQ(c, jit->lookup(cs));
+
+    for (auto asg : as) {
+      int r = TapeJIT::run(c, *asg);
+      if (r < 0)
+        continue;
+      EXPECT_EQ(asg->satisfies(cs.begin(), cs.end()), r == 1);
+      decided++;
+    }
+  }
+
+  EXPECT_GT(decided, 0U);
+  for (auto asg : as)
+    delete asg;
+}
+}
@@ -10,7 +10,21 @@
 #include <iostream>
 #include "gtest/gtest.h"
 
+#include <sstream>
 #include "klee/Expr.h"
+#include "klee/Constraints.h"
+#include "klee/Query.h"
+#include "klee/util/ExprBinary.h"
+#include "klee/util/ExprStore.h"
+#include "klee/util/BatchEvaluator.h"
+#include "klee/util/Assignment.h"
+#include "klee/util/ExprRangeEvaluator.h"
+#include "klee/util/ValueRange.h"
+#include "../../lib/Expr/ExprAllocFastUnique.h"
+#include "../../lib/Expr/RuleDBImage.h"
+#include <stdlib.h>
+#include <unistd.h>
+#include <fstream>
 
 using namespace klee;
 
@@ -110,4 +124,452 @@ TEST(ExprTest, ExtractConcat) {
   EXPECT_EQ(Expr::Extract, concat2->getKid(1)->getKind());
 }
 
+TEST(ExprTest, BinaryRoundTrip) {
+  ref<Array> array = Array::create("arr4", MallocKey(16));
+  ref<Expr> read32 = Expr::createTempRead(array, 32);
+  UpdateList ul(array, NULL);
+  ul.extend(getConstant(3, 32), getConstant(0x7f, 8));
+  ul.extend(read32, getConstant(1, 8));
+  ref<Expr> readUp = ReadExpr::create(ul, getConstant(5, 32));
+  ref<Expr> wide = ConstantExpr::alloc(llvm::APInt(128, 0x1234).shl(100));
+
+  std::vector<ref<Expr> > cs_v;
+  cs_v.push_back(UltExpr::create(read32, getConstant(100, 32)));
+  cs_v.push_back(EqExpr::create(
+    ZExtExpr::create(readUp, 32),
+    ExtractExpr::create(read32, 0, 32)));
+  ConstraintManager cs(cs_v);
+  ref<Expr> q = NeExpr::create(
+    ExtractExpr::create(ZExtExpr::create(read32, 128), 0, 128), wide);
+
+  std::stringstream ss;
+  ExprBinWriter w(ss);
+  w.writeQuery(cs, q);
+  w.reset();
+  w.writeQuery(cs, q);
+
+  ExprBinReader r(ss);
+  for (unsigned i = 0; i < 2; i++) {
+    std::vector<ref<Expr> > cs_r;
+    ref<Expr> q_r;
+    ASSERT_TRUE(r.readQuery(cs_r, q_r));
+    ASSERT_EQ(cs.size(), cs_r.size());
+    unsigned j = 0;
+    for (ConstraintManager::const_iterator it = cs.begin();
+         it != cs.end(); ++it, ++j)
+      EXPECT_EQ(*it, cs_r[j]);
+    EXPECT_EQ(q, q_r);
+  }
+
+  std::vector<ref<Expr> > cs_r;
+  ref<Expr> q_r;
+  EXPECT_FALSE(r.readQuery(cs_r, q_r));
+  EXPECT_FALSE(r.hasError());
+}
+
+static bool readsCorrupt(const std::string& body) {
+  std::stringstream ss(std::string(EXPR_BIN_MAGIC) + body);
+  ExprBinReader r(ss);
+  std::vector<ref<Expr> > cs;
+  ref<Expr> q;
+  return !r.readQuery(cs, q) && r.hasError();
+}
+
+TEST(ExprTest, BinaryCorrupt) {
+  // huge name length; huge and unbacked array sizes
+  EXPECT_TRUE(readsCorrupt(std::string("A\xff\xff\xff\xff\x0f", 6)));
+  EXPECT_TRUE(readsCorrupt(std::string("A\x01" "a" "\xff\xff\xff\xff\x7f\x00", 9)));
+  EXPECT_TRUE(readsCorrupt(std::string("A\x01" "a" "\x80\x80\x80\x80\x04\x01", 9)));
+  EXPECT_TRUE(readsCorrupt(std::string("A\x01" "1" "\x04\x00", 5)));
+
+  // zero and absurd constant widths
+  EXPECT_TRUE(readsCorrupt(std::string("E\x00\x00", 3)));
+  EXPECT_TRUE(readsCorrupt(std::string("E\x00\xff\xff\xff\xff\x0f", 7)));
+
+  // Add over mismatched widths; Extract past its kid
+  EXPECT_TRUE(readsCorrupt(std::string(
+    "E\x00\x08\x01" "E\x00\x10\x02" "E", 9) +
+    std::string(1, (char)Expr::Add) + std::string("\x08\x00\x01", 3)));
+  EXPECT_TRUE(readsCorrupt(std::string("E\x00\x08\x01" "E", 5) +
+    std::string(1, (char)Expr::Extract) + std::string("\x08\x04\x00", 3)));
+
+  // every truncation of a good stream fails cleanly
+  ref<Array> arr = Array::create("arrc", MallocKey(8));
+  ref<Expr> rd = ReadExpr::create(UpdateList(arr, NULL), getConstant(1, 32));
+  std::vector<ref<Expr> > cs_v;
+  cs_v.push_back(UltExpr::create(rd, getConstant(9, 8)));
+  std::stringstream good;
+  ExprBinWriter w(good);
+  w.writeQuery(cs_v, EqExpr::create(ZExtExpr::create(rd, 32), getConstant(3, 32)));
+
+  std::string s(good.str());
+  for (unsigned n = 0; n < s.size(); n++) {
+    std::stringstream ss(s.substr(0, n));
+    ExprBinReader r(ss);
+    std::vector<ref<Expr> > cs;
+    ref<Expr> q;
+    EXPECT_FALSE(r.readQuery(cs, q));
+  }
+}
+
+static ref<Expr> readAt(const ref<Array>& arr, ref<Expr> idx) {
+  return ReadExpr::create(UpdateList(arr, NULL), idx);
+}
+
+TEST(ExprTest, MinorGC) {
+  ExprAllocFastUnique *ea;
+  ea = dynamic_cast<ExprAllocFastUnique*>(Expr::getAllocator());
+  ASSERT_TRUE(ea != NULL);
+
+  ref<Array> arr = Array::create("gc0", MallocKey(8));
+  ref<Expr> r0 = readAt(arr, getConstant(0, 32));
+  ref<Expr> live;
+  Expr *live_p;
+
+  /* full sweep first so the young list starts out empty;
+   * assumes the default of a major collection every 8th GC */
+  while ((ea->getNumGCs() + 1) % 8 != 0)
+    ea->garbageCollect();
+  ea->garbageCollect();
+  ea->armGC();
+
+  live = AddExpr::alloc(r0, getConstant(1, 8));
+  live_p = live.get();
+  {
+    ref<Expr> x1 = AddExpr::alloc(r0, getConstant(2, 8));
+    ref<Expr> x2 = MulExpr::alloc(x1, getConstant(3, 8));
+    ref<Expr> x3 = XorExpr::alloc(x2, getConstant(5, 8));
+  }
+
+  /* dead chain goes in one pass; the newest link frees the rest */
+  EXPECT_GE(ea->garbageCollect(), 3u);
+  EXPECT_EQ(live_p, AddExpr::alloc(r0, getConstant(1, 8)).get());
+
+  /* promoted, so minor collections no longer see it */
+  live = ref<Expr>();
+  EXPECT_EQ(0u, ea->garbageCollect());
+
+  while ((ea->getNumGCs() + 1) % 8 != 0)
+    ea->garbageCollect();
+  EXPECT_GE(ea->garbageCollect(), 1u);
+}
+
+TEST(ExprTest, IndependentPartition) {
+  ref<Array> a = Array::create("arr5", MallocKey(16));
+  ref<Array> b = Array::create("arr6", MallocKey(16));
+  ref<Array> c = Array::create("arr7", MallocKey(16));
+  ref<Expr> a0 = readAt(a, getConstant(0, 32));
+  ref<Expr> a1 = readAt(a, getConstant(1, 32));
+  ref<Expr> b1 = readAt(b, getConstant(1, 32));
+  ref<Expr> b2 = readAt(b, getConstant(2, 32));
+
+  std::vector<ref<Expr> > cs_v;
+  cs_v.push_back(UltExpr::create(a0, getConstant(5, 8)));
+  cs_v.push_back(UltExpr::create(b1, b2));
+  cs_v.push_back(UltExpr::create(a1, getConstant(7, 8)));
+  cs_v.push_back(UltExpr::create(
+    readAt(c, ZExtExpr::create(b2, 32)), getConstant(9, 8)));
+  ConstraintManager cs(cs_v);
+
+  ref<Expr> queries[4] = {
+    UltExpr::create(a0, getConstant(3, 8)),
+    UltExpr::create(a1, getConstant(3, 8)),
+    UltExpr::create(readAt(a, ZExtExpr::create(b1, 32)), getConstant(3, 8)),
+    UltExpr::create(readAt(c, getConstant(0, 32)), getConstant(3, 8)) };
+  unsigned expected[4] = { 1, 1, 4, 2 };
+
+  for (unsigned i = 0; i < 4; i++) {
+    ConstraintManager dep, dep_old;
+    cs.getDependent(queries[i], dep);
+    IndependentElementSet::getIndependentConstraints(
+      Query(cs, queries[i]), dep_old);
+
+    EXPECT_EQ(expected[i], dep.size());
+    std::set<ref<Expr> > s(dep.begin(), dep.end());
+    std::set<ref<Expr> > s_old(dep_old.begin(), dep_old.end());
+    EXPECT_EQ(s_old, s);
+  }
+
+  /* a fork shares groups; extending one must not leak into the other */
+  ConstraintManager fork(cs);
+  fork.addConstraint(UltExpr::create(a0, b1));
+  ConstraintManager dep;
+  fork.getDependent(queries[3], dep);
+  EXPECT_EQ(4U, dep.size());
+  cs.getDependent(queries[3], dep);
+  EXPECT_EQ(2U, dep.size());
+}
+
+/* every fork layers over its parent's groups; deep chains of forks
+ * must agree with a partition built from scratch */
+TEST(ExprTest, IndependentPartitionForks) {
+  ref<Array> a = Array::create("arr8", MallocKey(64));
+  ref<Array> b = Array::create("arr9", MallocKey(64));
+  std::vector<ConstraintManager> forks(1);
+
+  for (unsigned i = 0; i < 40; i++) {
+    ConstraintManager &cur = forks.back();
+    ref<Expr> ai = readAt(a, getConstant(i, 32));
+    ref<Expr> bi = readAt(b, getConstant(i % 7, 32));
+    ref<Expr> q = UltExpr::create(ai, getConstant(3, 8));
+
+    /* link a[i] to a[i-1] on even steps, to b on odd ones */
+    if (i % 2)
+      cur.addConstraint(UltExpr::create(ai, bi));
+    else if (i)
+      cur.addConstraint(UltExpr::create(
+        ai, readAt(a, getConstant(i - 1, 32))));
+    else
+      cur.addConstraint(UltExpr::create(ai, getConstant(9, 8)));
+
+    ConstraintManager dep, dep_fresh;
+    ConstraintManager fresh(std::vector<ref<Expr> >(cur.begin(), cur.end()));
+    cur.getDependent(q, dep);
+    fresh.getDependent(q, dep_fresh);
+    EXPECT_EQ(dep_fresh.size(), dep.size());
+
+    forks.push_back(ConstraintManager(cur));
+  }
+
+  /* the first fork never saw the later constraints */
+  ConstraintManager dep;
+  forks[1].getDependent(
+    UltExpr::create(readAt(a, getConstant(0, 32)), getConstant(3, 8)), dep);
+  EXPECT_EQ(1U, dep.size());
+}
+
+
+TEST(ExprTest, RefMove) {
+  ref<Expr> a = getConstant(7, 32);
+  unsigned rc = a.getRefCount();
+
+  ref<Expr> b(std::move(a));
+  EXPECT_TRUE(a.isNull());
+  EXPECT_EQ(rc, b.getRefCount());
+
+  ref<Expr> c = getConstant(9, 32);
+  c = std::move(b);
+  EXPECT_TRUE(b.isNull());
+  EXPECT_EQ(rc, c.getRefCount());
+}
+
+TEST(ExprTest, ExprStoreEval) {
+  ref<Array> a = Array::create("arr8", MallocKey(4));
+  ref<Array> b = Array::create("arr9", MallocKey(4));
+  ref<Expr> a0 = readAt(a, getConstant(0, 32));
+  ref<Expr> a1 = readAt(a, getConstant(1, 32));
+  ref<Expr> b0 = readAt(b, getConstant(0, 32));
+  ref<Expr> w16 = ConcatExpr::create(a1, a0);
+  UpdateList ul(b, NULL);
+  ul.extend(getConstant(2, 32), a0);
+
+  ref<Expr> roots[] = {
+    SDivExpr::create(SExtExpr::create(a0, 32), getConstant(-3, 32)),
+    SelectExpr::create(
+      SltExpr::create(a1, b0), ZExtExpr::create(b0, 16), w16),
+    ExtractExpr::create(MulExpr::create(w16, w16), 4, 8),
+    AShrExpr::create(SExtExpr::create(a1, 32), getConstant(40, 32)),
+    ReadExpr::create(ul, ZExtExpr::create(
+      AndExpr::create(a1, getConstant(3, 8)), 32)) };
+
+  std::vector<const Array*> objs = { a.get(), b.get() };
+  std::vector<std::vector<unsigned char> > vals = {
+    { 0xf7, 0x82, 0, 0 }, { 0x10, 0, 0, 0 } };
+  Assignment asgn(objs, vals);
+
+  ExprStore st;
+  ExprStore::id_ty ids[5];
+  for (unsigned i = 0; i < 5; i++)
+    ids[i] = st.add(roots[i]);
+
+  /* structurally equal terms share ids */
+  unsigned n = st.size();
+  EXPECT_EQ(ids[1], st.add(SelectExpr::create(
+    SltExpr::create(a1, b0), ZExtExpr::create(b0, 16), w16)));
+  EXPECT_EQ(n, st.size());
+
+  std::vector<uint64_t> out;
+  ASSERT_TRUE(st.evaluate(asgn, out));
+  for (unsigned i = 0; i < 5; i++) {
+    ref<Expr> e = asgn.evaluate(roots[i]);
+    ASSERT_TRUE(isa<ConstantExpr>(e));
+    EXPECT_EQ(cast<ConstantExpr>(e)->getZExtValue(), out[ids[i]]);
+  }
+}
+
+TEST(ExprTest, BatchEvaluatorCheck) {
+  ref<Array> a = Array::create("arr10", MallocKey(2));
+  ref<Expr> a0 = readAt(a, getConstant(0, 32));
+  ref<Expr> a1 = readAt(a, getConstant(1, 32));
+
+  ref<Expr> cs[] = {
+    UltExpr::create(a0, getConstant(200, 8)),
+    SgeExpr::create(a1, getConstant(-4, 8)),
+    EqExpr::create(
+      UDivExpr::create(a0, a1),
+      AndExpr::create(a0, getConstant(7, 8))) };
+
+  /* 11 assignments spans a partial second batch; zero divisors included */
+  std::vector<const Array*> objs = { a.get() };
+  std::vector<Assignment*> owned;
+  std::vector<const Assignment*> as;
+  for (unsigned i = 0; i < 11; i++) {
+    std::vector<std::vector<unsigned char> > v = {
+      { (unsigned char)(i * 23), (unsigned char)(i % 3) } };
+    owned.push_back(new Assignment(objs, v));
+    as.push_back(owned.back());
+  }
+
+  BatchEvaluator be(cs, cs + 3);
+  std::vector<bool> sat;
+  be.check(as, sat);
+  ASSERT_EQ(as.size(), sat.size());
+
+  int first = -1;
+  for (unsigned i = 0; i < as.size(); i++) {
+    bool expect = as[i]->satisfies(cs, cs + 3);
+    EXPECT_EQ(expect, (bool)sat[i]);
+    if (expect && first < 0)
+      first = i;
+  }
+  EXPECT_EQ(first, be.findSatisfying(as));
+
+  for (auto asg : owned)
+    delete asg;
+}
+
+class TestRangeEvaluator : public ExprRangeEvaluator<ValueRange>
+{
+protected:
+  ValueRange getInitialReadRange(const Array &array, ValueRange index)
+  { return ValueRange(0, 255); }
+};
+
+TEST(ExprTest, RangeMixedConcat) {
+  ref<Array> a = Array::create("arr11", MallocKey(4));
+  ref<Expr> a0 = readAt(a, getConstant(0, 32));
+  ref<Expr> a1 = readAt(a, getConstant(1, 32));
+  TestRangeEvaluator re;
+  ValueRange vr;
+
+  /* 48-bit base over a 16-bit symbolic offset */
+  ref<Expr> off = ConcatExpr::alloc(a1, a0);
+  ref<Expr> ptr = ConcatExpr::alloc(
+    ConstantExpr::create(0x7f001234, 48), off);
+  vr = re.evaluate(ptr);
+  EXPECT_EQ(0x7f0012340000ULL, vr.min());
+  EXPECT_EQ(0x7f001234ffffULL, vr.max());
+
+  /* base+offset pointers keep their bound */
+  ref<Expr> base = ConstantExpr::create(0x600000, 64);
+  ref<Expr> off64 = ZExtExpr::create(off, 64);
+  vr = re.evaluate(AddExpr::alloc(base, off64));
+  EXPECT_EQ(0x600000ULL, vr.min());
+  EXPECT_EQ(0x60ffffULL, vr.max());
+
+  vr = re.evaluate(AddExpr::alloc(base,
+    MulExpr::alloc(ConstantExpr::create(8, 64), off64)));
+  EXPECT_EQ(0x600000ULL, vr.min());
+  EXPECT_EQ(0x600000ULL + 8*0xffffULL, vr.max());
+
+  vr = re.evaluate(SubExpr::alloc(base, off64));
+  EXPECT_EQ(0x600000ULL - 0xffff, vr.min());
+  EXPECT_EQ(0x600000ULL, vr.max());
+
+  /* wrapping gives up */
+  vr = re.evaluate(SubExpr::alloc(off64, base));
+  EXPECT_TRUE(vr.isFullRange(64));
+  vr = re.evaluate(AddExpr::alloc(
+    ConstantExpr::create(0xfff0, 16), off));
+  EXPECT_TRUE(vr.isFullRange(16));
+}
+
+/* hand-built rule image: root -> node 1 -> two leaf rules */
+struct RDBWords
+{
+  uint32_t rule_c, node_c, kid_c, leaf_c;
+  uint32_t nodes[2][4];
+  uint64_t kid_k; uint32_t kid_v;
+  uint64_t leaf_k[2]; uint32_t leaf_v[2];
+  uint64_t offs[3];
+};
+
+static RuleDBImage* mapRDB(const RDBWords& w)
+{
+  std::string img;
+  auto put32 = [&img](uint32_t v) { img.append((const char*)&v, 4); };
+  auto put64 = [&img](uint64_t v) { img.append((const char*)&v, 8); };
+  char path[] = "/tmp/ruledb.XXXXXX";
+  int fd = mkstemp(path);
+
+  put64(RDB_MAGIC); put32(RDB_VERSION);
+  put32(w.rule_c); put32(w.node_c); put32(w.kid_c); put32(w.leaf_c);
+  put32(0); put64(w.offs[2]);
+  for (unsigned i = 0; i < 2; i++)
+    for (unsigned j = 0; j < 4; j++)
+      put32(w.nodes[i][j]);
+  put64(w.kid_k); put32(w.kid_v); put32(0);
+  for (unsigned i = 0; i < 2; i++) {
+    put64(w.leaf_k[i]); put32(w.leaf_v[i]); put32(0);
+  }
+  for (unsigned i = 0; i < 3; i++)
+    put64(w.offs[i]);
+  img.append(w.offs[2], 'x');
+
+  EXPECT_EQ((ssize_t)img.size(), write(fd, img.data(), img.size()));
+  close(fd);
+
+  RuleDBImage *rdb = RuleDBImage::open(path);
+  unlink(path);
+  return rdb;
+}
+
+static bool openRDB(const RDBWords& w)
+{
+  RuleDBImage *rdb = mapRDB(w);
+  bool ok = (rdb != NULL);
+  delete rdb;
+  return ok;
+}
+
+TEST(ExprTest, RuleDBImageValidate) {
+  const RDBWords good = {
+    2, 2, 1, 2,
+    { { 0, 1, 0, 0 }, { 1, 0, 0, 2 } },
+    7, 1,
+    { 3, 4 }, { 0, 1 },
+    { 0, 5, 8 } };
+  RDBWords w;
+
+  EXPECT_TRUE(openRDB(good));
+
+  /* kid edge names a missing node */
+  w = good; w.kid_v = 2;
+  EXPECT_FALSE(openRDB(w));
+
+  /* leaf edge names a missing rule */
+  w = good; w.leaf_v[1] = 2;
+  EXPECT_FALSE(openRDB(w));
+
+  /* node's edges run past the edge arrays */
+  w = good; w.nodes[0][1] = 2;
+  EXPECT_FALSE(openRDB(w));
+  w = good; w.nodes[1][2] = 1;
+  EXPECT_FALSE(openRDB(w));
+
+  /* rule records must be back to back */
+  w = good; w.offs[1] = 9;
+  EXPECT_FALSE(openRDB(w));
+  w = good; w.offs[0] = 1;
+  EXPECT_FALSE(openRDB(w));
+
+  /* the records are junk; that shows up as no rule, not a crash */
+  RuleDBImage *rdb = mapRDB(good);
+  ASSERT_TRUE(rdb != NULL);
+  EXPECT_TRUE(rdb->getRule(0) == NULL);
+  EXPECT_TRUE(rdb->getRule(1) == NULL);
+  EXPECT_TRUE(rdb->getRule(2) == NULL);
+  EXPECT_EQ(0U, rdb->getNumLoaded());
+  delete rdb;
+}
 }
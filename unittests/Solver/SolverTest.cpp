@@ -8,11 +8,13 @@
 //===----------------------------------------------------------------------===//
 
 #include <iostream>
+#include <sys/wait.h>
 #include "gtest/gtest.h"
 
 #include "klee/Constraints.h"
 #include "klee/Expr.h"
 #include "klee/Solver.h"
+#include "klee/SolverShm.h"
 #include "llvm/ADT/StringExtras.h"
 
 using namespace klee;
@@ -163,4 +165,145 @@ TEST(SolverTest, Evaluation) {
   delete solver;
 }
 
+/* plays solverd for one request: answers 'V' after delay_us */
+static void serveOneShm(const char* name, unsigned delay_us)
+{
+  SolverShmRing *ring = solverShmOpen(name, false);
+  if (ring == NULL) _exit(1);
+
+  while (true) {
+    uint32_t bell = ring->doorbell;
+    for (unsigned i = 0; i < ring->nslots; i++) {
+      SolverShmSlot *slot = &ring->slots[i];
+      if (!__sync_bool_compare_and_swap(
+          &slot->state, SHM_SLOT_REQ, SHM_SLOT_BUSY))
+        continue;
+
+      STPReqHdr req;
+      memcpy(&req, slot->data, sizeof(req));
+      bool ok = (req.length == 3 &&
+        memcmp(slot->data + sizeof(req), "abc", 3) == 0);
+
+      usleep(delay_us);
+      STPResHdr res;
+      res.result = 'V';
+      res.rows = 0;
+      memcpy(slot->data, &res, sizeof(res));
+      slot->len = sizeof(res);
+      solverShmFinish(slot, ok);
+      _exit(0);
+    }
+    solverShmWait(&ring->doorbell, bell, 0);
+  }
+}
+
+/* posts one request; returns the final slot state */
+static uint32_t postOneShm(const char* name, unsigned delay_us)
+{
+  SolverShmRing *ring = solverShmOpen(name, true);
+  EXPECT_TRUE(ring != NULL);
+
+  pid_t pid = fork();
+  if (pid == 0)
+    serveOneShm(name, delay_us);
+
+  SolverShmSlot *slot = solverShmClaim(ring);
+  EXPECT_TRUE(slot != NULL);
+
+  STPReqHdr req;
+  req.timeout_sec = 0;
+  req.timeout_usec = 0;
+  req.length = 3;
+  memcpy(slot->data, &req, sizeof(req));
+  memcpy(slot->data + sizeof(req), "abc", 3);
+  slot->len = sizeof(req) + 3;
+  solverShmPost(ring, slot);
+
+  uint32_t st;
+  while ((st = slot->state) == SHM_SLOT_REQ || st == SHM_SLOT_BUSY)
+    EXPECT_TRUE(solverShmWait(&slot->state, st, 5000));
+
+  if (st == SHM_SLOT_RES) {
+    EXPECT_EQ('V', ((const STPResHdr*)slot->data)->result);
+  }
+
+  int status;
+  waitpid(pid, &status, 0);
+  EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+  slot->state = SHM_SLOT_FREE;
+  solverShmClose(ring);
+  shm_unlink(name);
+  return st;
+}
+
+TEST(SolverTest, ShmRingRoundTrip) {
+  std::string name = "/klee-shmtest-" + llvm::utostr(getpid());
+  EXPECT_EQ((uint32_t)SHM_SLOT_RES, postOneShm(name.c_str(), 0));
+}
+
+/* answer arrives long after the spins run out; waiter must sleep on
+ * the futex and still see the response */
+TEST(SolverTest, ShmRingFutexFallback) {
+  std::string name = "/klee-shmtest-" + llvm::utostr(getpid());
+  EXPECT_EQ((uint32_t)SHM_SLOT_RES, postOneShm(name.c_str(), 200000));
+}
+
+TEST(SolverTest, ShmRingFullAndTimeout) {
+  std::string name = "/klee-shmtest-" + llvm::utostr(getpid());
+  SolverShmRing *ring = solverShmOpen(name.c_str(), true);
+  ASSERT_TRUE(ring != NULL);
+
+  /* clients never create the segment */
+  SolverShmRing *bad = solverShmOpen("/klee-shmtest-nonexistent", false);
+  EXPECT_TRUE(bad == NULL);
+
+  for (unsigned i = 0; i < SOLVER_SHM_SLOTS; i++)
+    EXPECT_TRUE(solverShmClaim(ring) != NULL);
+  EXPECT_TRUE(solverShmClaim(ring) == NULL);
+
+  /* nobody serves the ring; futex wait must time out */
+  SolverShmSlot *slot = &ring->slots[0];
+  slot->state = SHM_SLOT_REQ;
+  EXPECT_FALSE(solverShmWait(&slot->state, SHM_SLOT_REQ, 20));
+
+  solverShmClose(ring);
+  shm_unlink(name.c_str());
+}
+
+/* a client that times out must not leak its slot */
+TEST(SolverTest, ShmRingAbandon) {
+  std::string name = "/klee-shmtest-" + llvm::utostr(getpid());
+  SolverShmRing *ring = solverShmOpen(name.c_str(), true);
+  ASSERT_TRUE(ring != NULL);
+
+  /* never picked up: back to free at once */
+  SolverShmSlot *slot = solverShmClaim(ring);
+  ASSERT_TRUE(slot != NULL);
+  slot->state = SHM_SLOT_REQ;
+  solverShmAbandon(slot);
+  EXPECT_EQ((uint32_t)SHM_SLOT_FREE, slot->state);
+
+  /* in progress: solverd frees it instead of answering */
+  slot = solverShmClaim(ring);
+  ASSERT_TRUE(slot != NULL);
+  slot->state = SHM_SLOT_BUSY;
+  solverShmAbandon(slot);
+  EXPECT_EQ((uint32_t)SHM_SLOT_ABANDONED, slot->state);
+  solverShmFinish(slot, true);
+  EXPECT_EQ((uint32_t)SHM_SLOT_FREE, slot->state);
+
+  /* answered just as the client gave up */
+  slot = solverShmClaim(ring);
+  ASSERT_TRUE(slot != NULL);
+  slot->state = SHM_SLOT_BUSY;
+  solverShmFinish(slot, true);
+  EXPECT_EQ((uint32_t)SHM_SLOT_RES, slot->state);
+  solverShmAbandon(slot);
+  EXPECT_EQ((uint32_t)SHM_SLOT_FREE, slot->state);
+
+  solverShmClose(ring);
+  shm_unlink(name.c_str());
+}
+
 }